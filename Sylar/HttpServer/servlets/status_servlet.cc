@@ -72,6 +72,12 @@ int32_t StatusServlet::handle(Sylar::http::HttpRequest::ptr request
     ss << "===================================================" << std::endl;
     ss << "<Woker>" << std::endl;
     Sylar::WorkerMgr::GetInstance()->dump(ss) << std::endl;
+    Sylar::IOManager::ptr main_iom = Sylar::Application::GetInstance()->getMainIOManager();
+    if(main_iom) {
+        ss << "===================================================" << std::endl;
+        ss << "<MainIOManager>" << std::endl;
+        main_iom->dump(ss) << std::endl;
+    }
 
     std::map<std::string, std::vector<TcpServer::ptr> > servers;
     Sylar::Application::GetInstance()->listAllServer(servers);
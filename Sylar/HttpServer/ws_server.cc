@@ -1,5 +1,6 @@
 #include "ws_server.h"
 #include "Sylar/log.h"
+#include "Sylar/util.h"
 
 namespace Sylar {
 namespace http {
@@ -13,6 +14,19 @@ WSServer::WSServer(Sylar::IOManager* worker, Sylar::IOManager* io_worker, Sylar:
 }
 
 void WSServer::handleClient(Socket::ptr client) {
+    if(!m_sharedStack) {
+        handleSession(client);
+        return;
+    }
+    //会话放到共享栈协程中执行,当前的独立栈协程立即返回复用
+    //共享栈属于线程,协程首次运行前尚未绑定线程,显式绑定到当前线程
+    Fiber::ptr fiber(new Fiber(std::bind(&WSServer::handleSession
+                    ,std::static_pointer_cast<WSServer>(shared_from_this()), client)
+                ,0, false, true));
+    IOManager::GetThis()->schedule(fiber, Sylar::GetThreadId());
+}
+
+void WSServer::handleSession(Socket::ptr client) {
     SYLAR_LOG_DEBUG(g_logger) << "handleClient " << *client;
     WSSession::ptr session(new WSSession(client));
     do {
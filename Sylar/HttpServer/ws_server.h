@@ -18,10 +18,24 @@ public:
 
     WSServletDispatch::ptr getWSServletDispatch() const { return m_dispatch;}
     void setWSServletDispatch(WSServletDispatch::ptr v) { m_dispatch = v;}
+
+    /**
+     * @brief 设置会话是否运行在共享栈协程上
+     * @details WebSocket会话大多长期挂起,共享栈模式下挂起的会话只占用实际使用的栈空间
+     */
+    void setSharedStack(bool v) { m_sharedStack = v;}
+    bool isSharedStack() const { return m_sharedStack;}
 protected:
     virtual void handleClient(Socket::ptr client) override;
+
+    /**
+     * @brief 处理一个WebSocket会话
+     */
+    void handleSession(Socket::ptr client);
 protected:
     WSServletDispatch::ptr m_dispatch;
+    /// 会话是否运行在共享栈协程上
+    bool m_sharedStack = false;
 };
 
 }
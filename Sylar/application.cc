@@ -212,7 +212,7 @@ int Application::run_fiber() {
         IOManager* io_worker = Sylar::IOManager::GetThis();
         IOManager* process_worker = Sylar::IOManager::GetThis();
         if(!i.accept_worker.empty()) {
-            accept_worker = Sylar::WorkerMgr::GetInstance()->getAsIOManager(i.accept_worker).get();
+            accept_worker = Sylar::WorkerMgr::GetInstance()->getAsIOManager(i.accept_worker, i.numa_node).get();
             if(!accept_worker) {
                 SYLAR_LOG_ERROR(g_logger) << "accept_worker: " << i.accept_worker
                     << " not exists";
@@ -220,7 +220,7 @@ int Application::run_fiber() {
             }
         }
         if(!i.io_worker.empty()) {
-            io_worker = Sylar::WorkerMgr::GetInstance()->getAsIOManager(i.io_worker).get();
+            io_worker = Sylar::WorkerMgr::GetInstance()->getAsIOManager(i.io_worker, i.numa_node).get();
             if(!io_worker) {
                 SYLAR_LOG_ERROR(g_logger) << "io_worker: " << i.io_worker
                     << " not exists";
@@ -228,7 +228,7 @@ int Application::run_fiber() {
             }
         }
         if(!i.process_worker.empty()) {
-            process_worker = Sylar::WorkerMgr::GetInstance()->getAsIOManager(i.process_worker).get();
+            process_worker = Sylar::WorkerMgr::GetInstance()->getAsIOManager(i.process_worker, i.numa_node).get();
             if(!process_worker) {
                 SYLAR_LOG_ERROR(g_logger) << "process_worker: " << i.process_worker
                     << " not exists";
@@ -241,8 +241,10 @@ int Application::run_fiber() {
             server.reset(new Sylar::http::HttpServer(i.keepalive,
                             process_worker, io_worker, accept_worker));
         } else if(i.type == "ws") {
-            server.reset(new Sylar::http::WSServer(
+            Sylar::http::WSServer::ptr ws_server(new Sylar::http::WSServer(
                             process_worker, io_worker, accept_worker));
+            ws_server->setSharedStack(Sylar::GetParamValue(i.args, "shared_stack", 0));
+            server = ws_server;
         } else if(i.type == "rock") {
             server.reset(new Sylar::RockServer("rock",
                             process_worker, io_worker, accept_worker));
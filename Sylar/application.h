@@ -20,6 +20,7 @@ public:
 
     ZKServiceDiscovery::ptr getServiceDiscovery() const { return m_serviceDiscovery;}
     RockSDLoadBalance::ptr getRockSDLoadBalance() const { return m_rockSDLoadBalance;}
+    IOManager::ptr getMainIOManager() const { return m_mainIOManager;}
 private:
     int main(int argc, char** argv);
     int run_fiber();
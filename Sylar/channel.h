@@ -0,0 +1,251 @@
+/**
+ * @file channel.h
+ * @brief 协程间传递数据的有界通道
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_CHANNEL_H__
+#define __SYLAR_CHANNEL_H__
+
+#include <memory>
+#include <vector>
+#include <iterator>
+#include "mutex.h"
+#include "ring_queue.h"
+
+namespace Sylar {
+
+/**
+ * @brief 有界多生产者多消费者通道
+ * @details 通道满时send挂起发送协程,通道空时recv挂起接收协程,不阻塞线程
+ *          (不在协程调度器中时阻塞线程)。批量接口一次加锁搬运多个元素,
+ *          并一次唤醒相应数量的对端等待者。
+ *          关闭后send失败,recv取完剩余元素后失败
+ */
+template<class T>
+class Channel : Noncopyable {
+public:
+    typedef std::shared_ptr<Channel> ptr;
+    typedef Spinlock MutexType;
+
+    /**
+     * @brief 构造函数
+     * @param[in] capacity 容量,至少为1
+     */
+    Channel(size_t capacity)
+        :m_capacity(capacity ? capacity : 1) {
+    }
+
+    /**
+     * @brief 发送,通道满时挂起直到有空位
+     * @return 通道已关闭返回false
+     */
+    bool send(T v) {
+        MutexType::Lock lock(m_mutex);
+        if(!waitNotFull(lock)) {
+            return false;
+        }
+        m_queue.push_back(std::move(v));
+        afterPush(1);
+        return true;
+    }
+
+    /**
+     * @brief 非阻塞发送
+     * @return 通道已满或已关闭返回false,此时v不会被移走
+     */
+    bool trySend(T& v) {
+        MutexType::Lock lock(m_mutex);
+        if(m_closed || m_queue.size() >= m_capacity) {
+            return false;
+        }
+        m_queue.push_back(std::move(v));
+        afterPush(1);
+        return true;
+    }
+
+    /**
+     * @brief 非阻塞发送临时对象
+     */
+    bool trySend(T&& v) {
+        return trySend(v);
+    }
+
+    /**
+     * @brief 批量发送[begin, end)中的元素(被移走)
+     * @details 每次获得空位时尽可能多地放入,全部发送完或通道关闭时返回
+     * @return 成功发送的数量
+     */
+    template<class Iter>
+    size_t sendBatch(Iter begin, Iter end) {
+        size_t sent = 0;
+        MutexType::Lock lock(m_mutex);
+        while(begin != end) {
+            if(!waitNotFull(lock)) {
+                break;
+            }
+            size_t n = 0;
+            while(begin != end && m_queue.size() < m_capacity) {
+                m_queue.push_back(std::move(*begin));
+                ++begin;
+                ++n;
+            }
+            afterPush(n);
+            sent += n;
+        }
+        return sent;
+    }
+
+    /**
+     * @brief 接收,通道空时挂起直到有数据
+     * @return 通道已关闭且没有剩余元素返回false
+     */
+    bool recv(T& v) {
+        MutexType::Lock lock(m_mutex);
+        if(!waitNotEmpty(lock)) {
+            return false;
+        }
+        v = std::move(m_queue.front());
+        m_queue.pop_front();
+        afterPop(1);
+        return true;
+    }
+
+    /**
+     * @brief 非阻塞接收
+     * @return 通道为空返回false
+     */
+    bool tryRecv(T& v) {
+        MutexType::Lock lock(m_mutex);
+        if(m_queue.empty()) {
+            return false;
+        }
+        v = std::move(m_queue.front());
+        m_queue.pop_front();
+        afterPop(1);
+        return true;
+    }
+
+    /**
+     * @brief 批量接收,通道空时挂起,之后一次取走最多max个元素追加到out
+     * @return 接收的数量,通道已关闭且没有剩余元素返回0
+     */
+    size_t recvBatch(std::vector<T>& out, size_t max) {
+        MutexType::Lock lock(m_mutex);
+        if(!max || !waitNotEmpty(lock)) {
+            return 0;
+        }
+        size_t n = 0;
+        while(n < max && !m_queue.empty()) {
+            out.push_back(std::move(m_queue.front()));
+            m_queue.pop_front();
+            ++n;
+        }
+        afterPop(n);
+        return n;
+    }
+
+    /**
+     * @brief 关闭通道,唤醒所有等待者
+     */
+    void close() {
+        MutexType::Lock lock(m_mutex);
+        m_closed = true;
+        m_sendWaiters.notifyAll();
+        m_recvWaiters.notifyAll();
+    }
+
+    /**
+     * @brief 重新打开已关闭的通道(如连接重连后)
+     */
+    void reopen() {
+        MutexType::Lock lock(m_mutex);
+        m_closed = false;
+    }
+
+    /**
+     * @brief 丢弃所有剩余元素
+     */
+    void clear() {
+        MutexType::Lock lock(m_mutex);
+        size_t n = m_queue.size();
+        m_queue.clear();
+        afterPop(n);
+    }
+
+    bool isClosed() {
+        MutexType::Lock lock(m_mutex);
+        return m_closed;
+    }
+
+    size_t size() {
+        MutexType::Lock lock(m_mutex);
+        return m_queue.size();
+    }
+
+    size_t getCapacity() const { return m_capacity;}
+private:
+    /**
+     * @brief 等待通道有空位,返回时持有锁
+     * @return 通道已关闭返回false
+     */
+    bool waitNotFull(MutexType::Lock& lock) {
+        while(!m_closed && m_queue.size() >= m_capacity) {
+            m_sendWaiters.wait(lock);
+            lock.lock();
+        }
+        return !m_closed;
+    }
+
+    /**
+     * @brief 等待通道有数据,返回时持有锁
+     * @return 通道已关闭且为空返回false
+     */
+    bool waitNotEmpty(MutexType::Lock& lock) {
+        while(!m_closed && m_queue.empty()) {
+            m_recvWaiters.wait(lock);
+            lock.lock();
+        }
+        return !m_queue.empty();
+    }
+
+    /**
+     * @brief 放入n个元素后唤醒接收者,仍有空位时把机会传给下一个发送者
+     */
+    void afterPush(size_t n) {
+        for(size_t i = 0; i < n && m_recvWaiters.notifyOne(); ++i) {
+        }
+        if(m_queue.size() < m_capacity) {
+            m_sendWaiters.notifyOne();
+        }
+    }
+
+    /**
+     * @brief 取出n个元素后唤醒发送者,仍有数据时把机会传给下一个接收者
+     */
+    void afterPop(size_t n) {
+        for(size_t i = 0; i < n && m_sendWaiters.notifyOne(); ++i) {
+        }
+        if(!m_queue.empty()) {
+            m_recvWaiters.notifyOne();
+        }
+    }
+private:
+    MutexType m_mutex;
+    /// 容量
+    size_t m_capacity;
+    /// 是否已关闭
+    bool m_closed = false;
+    /// 缓冲的元素
+    RingQueue<T> m_queue;
+    /// 等待空位的发送者
+    FiberWaitList m_sendWaiters;
+    /// 等待数据的接收者
+    FiberWaitList m_recvWaiters;
+};
+
+}
+
+#endif
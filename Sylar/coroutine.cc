@@ -0,0 +1,216 @@
+#include "coroutine.h"
+
+#ifdef SYLAR_HAS_COROUTINE
+
+#include "fd_manager.h"
+#include "hook.h"
+#include "log.h"
+#include <errno.h>
+#include <string.h>
+
+namespace Sylar {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+namespace detail {
+
+void OnDetachedException(std::exception_ptr ex) {
+    try {
+        std::rethrow_exception(ex);
+    } catch (std::exception& e) {
+        SYLAR_LOG_ERROR(g_logger) << "Task Except: " << e.what();
+    } catch (...) {
+        SYLAR_LOG_ERROR(g_logger) << "Task Except";
+    }
+}
+
+}
+
+IoAwaiter::IoAwaiter(int fd, IOManager::Event event, uint64_t timeout_ms, Operation op)
+    :m_fd(fd)
+    ,m_event(event)
+    ,m_timeout(timeout_ms)
+    ,m_op(std::move(op)) {
+}
+
+bool IoAwaiter::attempt() {
+    m_result = m_op();
+    if(m_result >= 0) {
+        return true;
+    }
+    if(errno == EAGAIN || errno == EWOULDBLOCK) {
+        return false;
+    }
+    m_error = errno;
+    return true;
+}
+
+bool IoAwaiter::await_ready() {
+    return attempt();
+}
+
+void IoAwaiter::await_suspend(std::coroutine_handle<> h) {
+    m_handle = h;
+    m_iom = IOManager::GetThis();
+    SYLAR_ASSERT2(m_iom, "socket awaiter must run on an IOManager");
+    if(m_timeout != (uint64_t)-1) {
+        m_timeoutFlag = std::make_shared<std::atomic<int> >(0);
+        std::weak_ptr<std::atomic<int> > wflag(m_timeoutFlag);
+        int fd = m_fd;
+        IOManager* iom = m_iom;
+        IOManager::Event event = m_event;
+        m_timer = m_iom->addConditionTimer(m_timeout, InlineTask([wflag, fd, iom, event]() {
+            auto flag = wflag.lock();
+            int expect = 0;
+            if(!flag || !flag->compare_exchange_strong(expect, ETIMEDOUT)) {
+                return;
+            }
+            iom->cancelEvent(fd, event);
+        }), wflag);
+    }
+    wait();
+}
+
+void IoAwaiter::wait() {
+    //addEvent成功后事件可能立即在其他线程触发并恢复协程,之后不能再访问成员
+    int rt = m_iom->addEvent(m_fd, m_event, InlineTask(std::bind(&IoAwaiter::onEvent, this)));
+    if(SYLAR_UNLIKELY(rt)) {
+        SYLAR_LOG_ERROR(g_logger) << "IoAwaiter addEvent(" << m_fd << ", "
+            << m_event << ") error";
+        m_result = -1;
+        m_error = EBADF;
+        finish();
+    }
+}
+
+void IoAwaiter::onEvent() {
+    int timed_out = m_timeoutFlag ? m_timeoutFlag->load() : 0;
+    if(timed_out) {
+        m_result = -1;
+        m_error = timed_out;
+        finish();
+        return;
+    }
+    if(attempt()) {
+        finish();
+        return;
+    }
+    wait();
+}
+
+void IoAwaiter::finish() {
+    if(m_timer) {
+        m_timer->cancel();
+        m_timer = nullptr;
+    }
+    std::coroutine_handle<> h = m_handle;
+    h.resume();
+}
+
+ssize_t IoAwaiter::await_resume() {
+    if(m_result < 0) {
+        errno = m_error;
+    }
+    return m_result;
+}
+
+AcceptAwaiter::AcceptAwaiter(Socket::ptr sock)
+    :IoAwaiter(sock->getSocket(), IOManager::READ, -1, [sock]() -> ssize_t {
+        return accept_f(sock->getSocket(), nullptr, nullptr);
+    })
+    ,m_sock(sock) {
+}
+
+Socket::ptr AcceptAwaiter::await_resume() {
+    if(m_result < 0) {
+        errno = m_error;
+        return nullptr;
+    }
+    Socket::ptr sock(new Socket(m_sock->getFamily(), m_sock->getType(), m_sock->getProtocol()));
+    if(sock->attach(m_result)) {
+        return sock;
+    }
+    close_f(m_result);
+    return nullptr;
+}
+
+ConnectAwaiter::ConnectAwaiter(Socket::ptr sock, Address::ptr addr, uint64_t timeout_ms)
+    :IoAwaiter(sock->getSocket(), IOManager::WRITE, timeout_ms, nullptr)
+    ,m_sock(sock)
+    ,m_addr(addr) {
+    m_op = [this]() -> ssize_t {
+        if(!m_started) {
+            m_started = true;
+            int rt = connect_f(m_fd, m_addr->getAddr(), m_addr->getAddrLen());
+            if(rt == -1 && errno == EINPROGRESS) {
+                errno = EAGAIN;
+            }
+            return rt;
+        }
+        int error = 0;
+        socklen_t len = sizeof(int);
+        if(-1 == getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &len)) {
+            return -1;
+        }
+        if(error) {
+            errno = error;
+            return -1;
+        }
+        return 0;
+    };
+}
+
+bool ConnectAwaiter::await_ready() {
+    if(m_fd == -1) {
+        //尚未创建socket句柄时创建一个非阻塞句柄
+        m_fd = socket_f(m_sock->getFamily(), m_sock->getType(), m_sock->getProtocol());
+        if(m_fd == -1) {
+            m_error = errno;
+            return true;
+        }
+        FdMgr::GetInstance()->get(m_fd, true);
+    }
+    return attempt();
+}
+
+bool ConnectAwaiter::await_resume() {
+    if(m_result < 0) {
+        SYLAR_LOG_DEBUG(g_logger) << "AsyncConnect(" << m_addr->toString()
+            << ") errno=" << m_error << " errstr=" << strerror(m_error);
+        if(m_fd != -1 && m_fd != m_sock->getSocket()) {
+            close_f(m_fd);
+        }
+        errno = m_error;
+        return false;
+    }
+    return m_sock->attach(m_fd);
+}
+
+IoAwaiter AsyncRecv(Socket::ptr sock, void* buffer, size_t length, int flags) {
+    int fd = sock->getSocket();
+    FdMgr::GetInstance()->get(fd, true);
+    return IoAwaiter(fd, IOManager::READ, sock->getRecvTimeout(), [fd, buffer, length, flags]() {
+        return recv_f(fd, buffer, length, flags);
+    });
+}
+
+IoAwaiter AsyncSend(Socket::ptr sock, const void* buffer, size_t length, int flags) {
+    int fd = sock->getSocket();
+    FdMgr::GetInstance()->get(fd, true);
+    return IoAwaiter(fd, IOManager::WRITE, sock->getSendTimeout(), [fd, buffer, length, flags]() {
+        return send_f(fd, buffer, length, flags | MSG_NOSIGNAL);
+    });
+}
+
+AcceptAwaiter AsyncAccept(Socket::ptr sock) {
+    FdMgr::GetInstance()->get(sock->getSocket(), true);
+    return AcceptAwaiter(sock);
+}
+
+ConnectAwaiter AsyncConnect(Socket::ptr sock, Address::ptr addr, uint64_t timeout_ms) {
+    return ConnectAwaiter(sock, addr, timeout_ms);
+}
+
+}
+
+#endif
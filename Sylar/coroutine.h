@@ -0,0 +1,403 @@
+/**
+ * @file coroutine.h
+ * @brief C++20无栈协程接口
+ * @details 协程帧只在堆上占用几百字节,挂起时不占用独立栈。
+ *          协程由Scheduler以InlineTask的方式直接在调度协程上恢复,
+ *          IO和定时器等待复用IOManager::addEvent/TimerManager::addTimer。
+ *          协程中不能调用会挂起Fiber的hook函数(如阻塞的read/sleep),
+ *          只能co_await本文件提供的等待体。需要 -std=c++20。
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_COROUTINE_H__
+#define __SYLAR_COROUTINE_H__
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define SYLAR_HAS_COROUTINE 1
+#endif
+#endif
+
+#ifdef SYLAR_HAS_COROUTINE
+
+#include <coroutine>
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <chrono>
+#include <type_traits>
+#include <functional>
+#include "scheduler.h"
+#include "iomanager.h"
+#include "socket.h"
+#include "macro.h"
+
+namespace Sylar {
+
+template<class T = void>
+class Task;
+
+namespace detail {
+
+/**
+ * @brief 记录脱离等待者的协程抛出的异常
+ */
+void OnDetachedException(std::exception_ptr ex);
+
+struct PromiseBase {
+    /// 等待本协程结束的协程
+    std::coroutine_handle<> continuation;
+    /// 协程抛出的异常
+    std::exception_ptr exception;
+    /// 是否已脱离(Spawn),结束时自行销毁
+    bool detached = false;
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false;}
+
+        template<class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            PromiseBase& p = h.promise();
+            if(p.continuation) {
+                return p.continuation;
+            }
+            if(p.detached) {
+                if(p.exception) {
+                    OnDetachedException(p.exception);
+                }
+                h.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {};}
+    FinalAwaiter final_suspend() noexcept { return {};}
+    void unhandled_exception() { exception = std::current_exception();}
+};
+
+template<class T>
+struct TaskPromise : PromiseBase {
+    std::optional<T> value;
+
+    template<class U>
+    void return_value(U&& v) {
+        value.emplace(std::forward<U>(v));
+    }
+
+    T result() {
+        if(exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template<>
+struct TaskPromise<void> : PromiseBase {
+    void return_void() {}
+
+    void result() {
+        if(exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+}
+
+/**
+ * @brief 协程任务
+ * @details 惰性启动:被co_await或通过Spawn投递到调度器后才开始执行
+ */
+template<class T>
+class Task {
+public:
+    struct promise_type : detail::TaskPromise<T> {
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+
+    explicit Task(handle_type h)
+        :m_handle(h) {
+    }
+
+    Task(Task&& oth) noexcept
+        :m_handle(oth.m_handle) {
+        oth.m_handle = nullptr;
+    }
+
+    Task& operator=(Task&& oth) noexcept {
+        if(this != &oth) {
+            if(m_handle) {
+                m_handle.destroy();
+            }
+            m_handle = oth.m_handle;
+            oth.m_handle = nullptr;
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if(m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            handle_type handle;
+
+            bool await_ready() noexcept { return !handle || handle.done();}
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+                handle.promise().continuation = h;
+                return handle;
+            }
+
+            T await_resume() { return handle.promise().result();}
+        };
+        return Awaiter{m_handle};
+    }
+
+    /**
+     * @brief 放弃对协程帧的所有权
+     */
+    handle_type release() {
+        handle_type h = m_handle;
+        m_handle = nullptr;
+        return h;
+    }
+
+    bool valid() const { return (bool)m_handle;}
+private:
+    handle_type m_handle;
+};
+
+/**
+ * @brief 将协程投递到调度器上执行,结束后自行销毁
+ * @param[in] task 协程任务
+ * @param[in] sc 调度器,为空时使用当前调度器
+ * @param[in] thread 执行的线程id,-1标识任意线程
+ */
+template<class T>
+void Spawn(Task<T> task, Scheduler* sc = nullptr, int thread = -1) {
+    auto h = task.release();
+    SYLAR_ASSERT(h);
+    h.promise().detached = true;
+    if(!sc) {
+        sc = Scheduler::GetThis();
+    }
+    SYLAR_ASSERT(sc);
+    sc->schedule(InlineTask([h](){ h.resume();}), thread);
+}
+
+/**
+ * @brief 切换到指定调度器(线程)上继续执行
+ */
+class ScheduleAwaiter {
+public:
+    ScheduleAwaiter(Scheduler* sc, int thread = -1)
+        :m_scheduler(sc)
+        ,m_thread(thread) {
+    }
+
+    bool await_ready() const noexcept { return false;}
+
+    void await_suspend(std::coroutine_handle<> h) {
+        m_scheduler->schedule(InlineTask([h](){ h.resume();}), m_thread);
+    }
+
+    void await_resume() const noexcept {}
+private:
+    Scheduler* m_scheduler;
+    int m_thread;
+};
+
+inline ScheduleAwaiter ScheduleOn(Scheduler* sc, int thread = -1) {
+    return ScheduleAwaiter(sc, thread);
+}
+
+/**
+ * @brief 定时器等待体
+ */
+class SleepAwaiter {
+public:
+    SleepAwaiter(uint64_t ms)
+        :m_ms(ms) {
+    }
+
+    bool await_ready() const noexcept { return false;}
+
+    void await_suspend(std::coroutine_handle<> h) {
+        IOManager* iom = IOManager::GetThis();
+        SYLAR_ASSERT2(iom, "SleepFor must run on an IOManager");
+        iom->addTimer(m_ms, InlineTask([h](){ h.resume();}));
+    }
+
+    void await_resume() const noexcept {}
+private:
+    uint64_t m_ms;
+};
+
+inline SleepAwaiter SleepFor(uint64_t ms) {
+    return SleepAwaiter(ms);
+}
+
+template<class Rep, class Period>
+SleepAwaiter SleepFor(std::chrono::duration<Rep, Period> d) {
+    return SleepAwaiter(std::chrono::duration_cast<std::chrono::milliseconds>(d).count());
+}
+
+/**
+ * @brief socket IO等待体
+ * @details 先直接尝试一次非阻塞操作,返回EAGAIN时通过IOManager::addEvent登记事件,
+ *          事件到达后在调度协程上重试,成功、出错或超时后恢复协程。
+ *          co_await的结果与对应系统调用一致,失败时返回-1并设置errno
+ */
+class IoAwaiter {
+public:
+    /// 非阻塞操作,返回-1且errno为EAGAIN表示需要等待
+    using Operation = std::function<ssize_t()>;
+
+    IoAwaiter(int fd, IOManager::Event event, uint64_t timeout_ms, Operation op);
+    IoAwaiter(const IoAwaiter&) = delete;
+    IoAwaiter& operator=(const IoAwaiter&) = delete;
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> h);
+    ssize_t await_resume();
+protected:
+    /**
+     * @brief 尝试一次操作
+     * @return 是否已得到结果(成功或出错)
+     */
+    bool attempt();
+
+    /**
+     * @brief 登记事件等待
+     */
+    void wait();
+
+    /**
+     * @brief 事件到达(或被超时取消)
+     */
+    void onEvent();
+
+    /**
+     * @brief 结束等待并恢复协程,之后不能再访问成员
+     */
+    void finish();
+protected:
+    int m_fd;
+    IOManager::Event m_event;
+    uint64_t m_timeout;
+    Operation m_op;
+    ssize_t m_result = -1;
+    int m_error = 0;
+    IOManager* m_iom = nullptr;
+    std::coroutine_handle<> m_handle;
+    /// 超时标记,定时器持有弱引用,在定时器线程写入、在事件线程读取
+    std::shared_ptr<std::atomic<int> > m_timeoutFlag;
+    Timer::ptr m_timer;
+};
+
+/**
+ * @brief accept等待体,结果为新连接的Socket,失败返回nullptr
+ */
+class AcceptAwaiter : public IoAwaiter {
+public:
+    AcceptAwaiter(Socket::ptr sock);
+    Socket::ptr await_resume();
+private:
+    Socket::ptr m_sock;
+};
+
+/**
+ * @brief connect等待体,结果为是否连接成功
+ */
+class ConnectAwaiter : public IoAwaiter {
+public:
+    ConnectAwaiter(Socket::ptr sock, Address::ptr addr, uint64_t timeout_ms);
+    bool await_ready();
+    bool await_resume();
+private:
+    Socket::ptr m_sock;
+    Address::ptr m_addr;
+    bool m_started = false;
+};
+
+/**
+ * @brief 接收数据,超时时间取socket的接收超时
+ */
+IoAwaiter AsyncRecv(Socket::ptr sock, void* buffer, size_t length, int flags = 0);
+
+/**
+ * @brief 发送数据,超时时间取socket的发送超时
+ */
+IoAwaiter AsyncSend(Socket::ptr sock, const void* buffer, size_t length, int flags = 0);
+
+/**
+ * @brief 接收新连接
+ */
+AcceptAwaiter AsyncAccept(Socket::ptr sock);
+
+/**
+ * @brief 连接远端地址
+ */
+ConnectAwaiter AsyncConnect(Socket::ptr sock, Address::ptr addr, uint64_t timeout_ms = -1);
+
+/**
+ * @brief 在Fiber中等待协程结束并取得结果
+ * @details 挂起的是当前Fiber而不是线程,用于有栈代码调用协程代码。
+ *          结果放在堆上,等待的Fiber使用共享栈时栈内容会被换出,协程不能写入它的栈
+ */
+template<class T>
+T SyncWait(Task<T> task) {
+    Fiber::ptr fiber = Fiber::GetThis();
+    Scheduler* sc = Scheduler::GetThis();
+    SYLAR_ASSERT(sc);
+    struct State {
+        typename std::conditional<std::is_void<T>::value, int, std::optional<T> >::type out;
+        std::exception_ptr ex;
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+    auto runner = [](Task<T> t, std::shared_ptr<State> st
+                    ,Fiber::ptr f, Scheduler* s) -> Task<void> {
+        try {
+            if constexpr (std::is_void<T>::value) {
+                co_await std::move(t);
+            } else {
+                st->out.emplace(co_await std::move(t));
+            }
+        } catch (...) {
+            st->ex = std::current_exception();
+        }
+        s->schedule(f);
+    };
+    Spawn(runner(std::move(task), state, fiber, sc), sc);
+    Fiber::YieldToHold();
+    if(state->ex) {
+        std::rethrow_exception(state->ex);
+    }
+    if constexpr (!std::is_void<T>::value) {
+        return std::move(*state->out);
+    }
+}
+
+}
+
+#endif
+
+#endif
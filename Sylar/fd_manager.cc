@@ -3,9 +3,15 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <atomic>
 
 namespace Sylar {
 
+static std::atomic<uint64_t> s_fd_generation = {0};
+
+/// 正在初始化的代数标记
+static const uint64_t s_initializing = ~0ull;
+
 FdCtx::FdCtx(int fd)
     :m_isInit(false)
     ,m_isSocket(false)
@@ -14,17 +20,14 @@ FdCtx::FdCtx(int fd)
     ,m_isClosed(false)
     ,m_fd(fd)
     ,m_recvTimeout(-1)
-    ,m_sendTimeout(-1) {
-    init();
+    ,m_sendTimeout(-1)
+    ,m_generation(0) {
 }
 
 FdCtx::~FdCtx() {
 }
 
 bool FdCtx::init() {
-    if(m_isInit) {
-        return true;
-    }
     m_recvTimeout = -1;
     m_sendTimeout = -1;
 
@@ -69,40 +72,52 @@ uint64_t FdCtx::getTimeout(int type) {
 }
 
 FdManager::FdManager() {
-    m_datas.resize(64);
 }
 
-FdCtx::ptr FdManager::get(int fd, bool auto_create) {
-    if(fd == -1) {
+FdCtx* FdManager::get(int fd, bool auto_create) {
+    if(fd < 0) {
+        return nullptr;
+    }
+    FdCtx* ctx = auto_create ? m_datas.get(fd, [](FdCtx& ctx, size_t index){
+                                    ctx.m_fd = index;
+                                })
+                             : m_datas.find(fd);
+    if(!ctx) {
+        return nullptr;
+    }
+    uint64_t generation = ctx->m_generation.load(std::memory_order_acquire);
+    if(generation != 0 && generation != s_initializing) {
+        return ctx;
+    }
+    if(!auto_create) {
         return nullptr;
     }
-    RWMutexType::ReadLock lock(m_mutex);
-    if((int)m_datas.size() <= fd) {
-        if(auto_create == false) {
-            return nullptr;
+    //并发创建同一句柄时只有一个线程初始化,其余等待它发布
+    while(true) {
+        if(generation == 0) {
+            if(ctx->m_generation.compare_exchange_weak(generation, s_initializing
+                        ,std::memory_order_acquire)) {
+                ctx->init();
+                ctx->m_generation.store(++s_fd_generation, std::memory_order_release);
+                return ctx;
+            }
+            continue;
         }
-    } else {
-        if(m_datas[fd] || !auto_create) {
-            return m_datas[fd];
+        if(generation != s_initializing) {
+            return ctx;
         }
+        generation = ctx->m_generation.load(std::memory_order_acquire);
     }
-    lock.unlock();
-
-    RWMutexType::WriteLock lock2(m_mutex);
-    FdCtx::ptr ctx(new FdCtx(fd));
-    if(fd >= (int)m_datas.size()) {
-        m_datas.resize(fd * 1.5);
-    }
-    m_datas[fd] = ctx;
-    return ctx;
 }
 
 void FdManager::del(int fd) {
-    RWMutexType::WriteLock lock(m_mutex);
-    if((int)m_datas.size() <= fd) {
+    if(fd < 0) {
         return;
     }
-    m_datas[fd].reset();
+    FdCtx* ctx = m_datas.find(fd);
+    if(ctx) {
+        ctx->m_generation.store(0, std::memory_order_release);
+    }
 }
 
 }
@@ -11,23 +11,26 @@
 
 #include <memory>
 #include <vector>
+#include <atomic>
 #include "thread.h"
 #include "singleton.h"
+#include "radix_table.h"
 
 namespace Sylar {
 
 /**
  * @brief 文件句柄上下文类
  * @details 管理文件句柄类型(是否socket)
- *          是否阻塞,是否关闭,读/写超时时间
+ *          是否阻塞,是否关闭,读/写超时时间。
+ *          对象常驻在FdManager的表中,句柄关闭后原地复用,指针始终有效
  */
-class FdCtx : public std::enable_shared_from_this<FdCtx> {
+class FdCtx {
+friend class FdManager;
 public:
-    typedef std::shared_ptr<FdCtx> ptr;
     /**
      * @brief 通过文件句柄构造FdCtx
      */
-    FdCtx(int fd);
+    FdCtx(int fd = -1);
     /**
      * @brief 析构函数
      */
@@ -83,6 +86,12 @@ public:
      * @return 超时时间毫秒
      */
     uint64_t getTimeout(int type);
+
+    /**
+     * @brief 代数,每次创建(打开)时递增,已删除时为0
+     * @details 句柄关闭后编号被复用时代数不同,用于识别按编号缓存的过时状态
+     */
+    uint64_t getGeneration() const { return m_generation.load(std::memory_order_acquire);}
 private:
     /**
      * @brief 初始化
@@ -105,6 +114,8 @@ private:
     uint64_t m_recvTimeout;
     /// 写超时时间毫秒
     uint64_t m_sendTimeout;
+    /// 代数,0表示未打开,INITIALIZING表示正在初始化
+    std::atomic<uint64_t> m_generation;
 };
 
 /**
@@ -112,7 +123,6 @@ private:
  */
 class FdManager {
 public:
-    typedef RWMutex RWMutexType;
     /**
      * @brief 无参构造函数
      */
@@ -122,9 +132,10 @@ public:
      * @brief 获取/创建文件句柄类FdCtx
      * @param[in] fd 文件句柄
      * @param[in] auto_create 是否自动创建
-     * @return 返回对应文件句柄类FdCtx::ptr
+     * @return 返回对应文件句柄类FdCtx,未创建或已删除时返回nullptr
+     * @details 只有一次原子读,不加锁
      */
-    FdCtx::ptr get(int fd, bool auto_create = false);
+    FdCtx* get(int fd, bool auto_create = false);
 
     /**
      * @brief 删除文件句柄类
@@ -132,10 +143,8 @@ public:
      */
     void del(int fd);
 private:
-    /// 读写锁
-    RWMutexType m_mutex;
-    /// 文件句柄集合
-    std::vector<FdCtx::ptr> m_datas;
+    /// 文件句柄集合,以fd为下标,分段创建且不移动;FdCtx原地复用,以代数区分是否打开
+    RadixTable<FdCtx> m_datas;
 };
 
 /// 文件句柄单例
@@ -3,7 +3,13 @@
 #include "macro.h"
 #include "log.h"
 #include "scheduler.h"
+#include "stack_allocator.h"
+#include "mutex.h"
 #include <atomic>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
 
 namespace Sylar {
 
@@ -14,22 +20,93 @@ static std::atomic<uint64_t> s_fiber_count {0};
 
 static thread_local Fiber* t_fiber = nullptr;
 static thread_local Fiber::ptr t_threadFiber = nullptr;
+/// 当前线程是否允许让出,执行InlineTask期间为false
+static thread_local bool t_yieldable = true;
+/// 当前时间片的结束时间(微秒,粗粒度单调时钟),0表示未在时间片中
+static thread_local uint64_t t_slice_end_us = 0;
 
 static ConfigVar<uint32_t>::ptr g_fiber_stack_size =
     Config::Lookup<uint32_t>("fiber.stack_size", 128 * 1024, "fiber stack size");
 
-class MallocStackAllocator {
-public:
-    static void* Alloc(size_t size) {
-        return malloc(size);
+static ConfigVar<uint32_t>::ptr g_fiber_shared_stack_size =
+    Config::Lookup<uint32_t>("fiber.shared_stack.size", 1024 * 1024, "shared fiber run stack size");
+
+static ConfigVar<uint32_t>::ptr g_fiber_shared_stack_count =
+    Config::Lookup<uint32_t>("fiber.shared_stack.count", 4, "shared fiber run stacks per thread");
+
+static ConfigVar<uint32_t>::ptr g_fiber_time_slice =
+    Config::Lookup<uint32_t>("fiber.time_slice_ms", 10, "time slice in ms after which Fiber::MaybeYield yields");
+
+static std::atomic<uint64_t> s_time_slice_us {10 * 1000};
+
+namespace {
+
+struct FiberTimeSliceIniter {
+    FiberTimeSliceIniter() {
+        s_time_slice_us = g_fiber_time_slice->getValue() * 1000ull;
+        g_fiber_time_slice->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_time_slice_us = new_value * 1000ull;
+        });
     }
+};
+
+static FiberTimeSliceIniter s_time_slice_init;
 
-    static void Dealloc(void* vp, size_t size) {
-        return free(vp);
+}
+
+/**
+ * @brief 粗粒度单调时钟(微秒),精度为一个内核tick,但读取开销远小于gettimeofday
+ */
+static inline uint64_t CoarseNowUS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000 * 1000ul + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief 共享运行栈
+ */
+struct SharedStack {
+    /// 栈起始地址(低地址)
+    void* stack = nullptr;
+    /// 栈大小
+    size_t size = 0;
+    /// 分配器
+    StackAllocator* allocator = nullptr;
+    /// 当前驻留在栈上的协程
+    std::weak_ptr<Fiber> owner;
+};
+
+/**
+ * @brief 每个线程的共享运行栈,协程依次轮流绑定,线程退出时释放
+ */
+struct SharedStackList {
+    std::vector<SharedStack*> stacks;
+    size_t next = 0;
+
+    SharedStack* get() {
+        if(stacks.empty()) {
+            size_t count = std::max(g_fiber_shared_stack_count->getValue(), (uint32_t)1);
+            for(size_t i = 0; i < count; ++i) {
+                SharedStack* s = new SharedStack;
+                s->size = g_fiber_shared_stack_size->getValue();
+                s->allocator = StackAllocator::GetDefault();
+                s->stack = s->allocator->alloc(s->size);
+                stacks.push_back(s);
+            }
+        }
+        return stacks[next++ % stacks.size()];
+    }
+
+    ~SharedStackList() {
+        for(auto i : stacks) {
+            i->allocator->dealloc(i->stack, i->size);
+            delete i;
+        }
     }
 };
 
-using StackAllocator = MallocStackAllocator;
+static thread_local SharedStackList t_shared_stacks;
 
 uint64_t Fiber::GetFiberId() {
     if(t_fiber) {
@@ -42,35 +119,30 @@ Fiber::Fiber() {
     m_state = EXEC;
     SetThis(this);
 
-    if(getcontext(&m_ctx)) {
-        SYLAR_ASSERT2(false, "getcontext");
-    }
-
     ++s_fiber_count;
 
     SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber main";
 }
 
-Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller)
+Fiber::Fiber(TaskFunction cb, size_t stacksize, bool use_caller, bool shared_stack)
     :m_id(++s_fiber_id)
-    ,m_cb(cb) {
+    ,m_cb(std::move(cb)) {
     ++s_fiber_count;
-    m_stacksize = stacksize ? stacksize : g_fiber_stack_size->getValue();
-
-    m_stack = StackAllocator::Alloc(m_stacksize);
-    if(getcontext(&m_ctx)) {
-        SYLAR_ASSERT2(false, "getcontext");
+#ifdef SYLAR_FIBER_USE_ASM
+    if(shared_stack && !use_caller) {
+        //共享运行栈在第一次切入时才绑定
+        m_useSharedStack = true;
+        SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id << " shared_stack";
+        return;
     }
+#endif
+    m_stacksize = stacksize ? stacksize : g_fiber_stack_size->getValue();
 
-    // 设置协程上下文的链接指针为空
-    m_ctx.uc_link = nullptr;
-    m_ctx.uc_stack.ss_sp = m_stack;
-    m_ctx.uc_stack.ss_size = m_stacksize;
-
-    if(!use_caller) {
-        makecontext(&m_ctx, &Fiber::MainFunc, 0);
-    } else {
-        makecontext(&m_ctx, &Fiber::CallerMainFunc, 0);
+    m_allocator = StackAllocator::GetDefault();
+    m_stack = m_allocator->alloc(m_stacksize);
+    if(!MakeFiberContext(m_ctx, m_stack, m_stacksize
+                , use_caller ? &Fiber::CallerMainFunc : &Fiber::MainFunc)) {
+        SYLAR_ASSERT2(false, "MakeFiberContext");
     }
 
     SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id;
@@ -78,12 +150,18 @@ Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller)
 
 Fiber::~Fiber() {
     --s_fiber_count;
-    if(m_stack) {
+    if(m_useSharedStack) {
+        SYLAR_ASSERT(m_state == TERM
+                || m_state == EXCEPT
+                || m_state == INIT);
+        //驻留在共享运行栈上的协程只会是TERM/EXCEPT,弱引用失效即可,不需要回写共享栈
+        free(m_saveBuffer);
+    } else if(m_stack) {
         SYLAR_ASSERT(m_state == TERM
                 || m_state == EXCEPT
                 || m_state == INIT);
 
-        StackAllocator::Dealloc(m_stack, m_stacksize);
+        m_allocator->dealloc(m_stack, m_stacksize);
     } else {
         SYLAR_ASSERT(!m_cb);
         SYLAR_ASSERT(m_state == EXEC);
@@ -99,36 +177,89 @@ Fiber::~Fiber() {
 
 //重置协程函数，并重置状态
 //INIT，TERM, EXCEPT
-void Fiber::reset(std::function<void()> cb) {
-    SYLAR_ASSERT(m_stack);
+void Fiber::reset(TaskFunction cb) {
+    SYLAR_ASSERT(m_stack || m_useSharedStack);
     SYLAR_ASSERT(m_state == TERM
             || m_state == EXCEPT
             || m_state == INIT);
-    m_cb = cb;
-    if(getcontext(&m_ctx)) {
-        SYLAR_ASSERT2(false, "getcontext");
+    m_cb = std::move(cb);
+    if(m_useSharedStack) {
+        releaseSharedStack();
+        m_state = INIT;
+        return;
     }
+    if(!MakeFiberContext(m_ctx, m_stack, m_stacksize, &Fiber::MainFunc)) {
+        SYLAR_ASSERT2(false, "MakeFiberContext");
+    }
+    m_state = INIT;
+}
 
-    m_ctx.uc_link = nullptr;
-    m_ctx.uc_stack.ss_sp = m_stack;
-    m_ctx.uc_stack.ss_size = m_stacksize;
+void Fiber::acquireSharedStack() {
+    if(!m_sharedStack) {
+        m_sharedStack = t_shared_stacks.get();
+        m_stackThread = Sylar::GetThreadId();
+        EvictSharedStack(m_sharedStack);
+        if(!MakeFiberContext(m_ctx, m_sharedStack->stack, m_sharedStack->size, &Fiber::MainFunc)) {
+            SYLAR_ASSERT2(false, "MakeFiberContext");
+        }
+        m_sharedStack->owner = shared_from_this();
+        return;
+    }
+    SYLAR_ASSERT2(m_stackThread == Sylar::GetThreadId(), "shared stack fiber resumed on another thread");
+    if(m_sharedStack->owner.lock().get() == this) {
+        return;
+    }
+    EvictSharedStack(m_sharedStack);
+    char* top = (char*)m_sharedStack->stack + m_sharedStack->size;
+    memcpy(top - m_saveSize, m_saveBuffer, m_saveSize);
+    m_sharedStack->owner = shared_from_this();
+}
 
-    makecontext(&m_ctx, &Fiber::MainFunc, 0);
-    m_state = INIT;
+void Fiber::releaseSharedStack() {
+    if(m_sharedStack && m_sharedStack->owner.lock().get() == this) {
+        m_sharedStack->owner.reset();
+    }
+    m_sharedStack = nullptr;
+    m_stackThread = -1;
+    m_saveSize = 0;
+}
+
+void Fiber::EvictSharedStack(SharedStack* stack) {
+    Fiber::ptr owner = stack->owner.lock();
+    stack->owner.reset();
+    if(!owner || owner->m_state == TERM
+            || owner->m_state == EXCEPT) {
+        return;
+    }
+    //切出时m_ctx保存的就是栈指针,栈顶到栈指针之间即为实际使用的部分
+    char* top = (char*)stack->stack + stack->size;
+    size_t used = top - (char*)owner->m_ctx;
+    SYLAR_ASSERT(used <= stack->size);
+    if(owner->m_saveCapacity < used || owner->m_saveCapacity > used * 2) {
+        free(owner->m_saveBuffer);
+        owner->m_saveBuffer = (char*)malloc(used);
+        SYLAR_ASSERT(owner->m_saveBuffer);
+        owner->m_saveCapacity = used;
+    }
+    memcpy(owner->m_saveBuffer, owner->m_ctx, used);
+    owner->m_saveSize = used;
 }
 
 void Fiber::call() {
+    if(m_useSharedStack) {
+        acquireSharedStack();
+    }
     SetThis(this);
     m_state = EXEC;
-    if(swapcontext(&t_threadFiber->m_ctx, &m_ctx)) {
-        SYLAR_ASSERT2(false, "swapcontext");
+    if(!SwapFiberContext(t_threadFiber->m_ctx, m_ctx)) {
+        SYLAR_ASSERT2(false, "SwapFiberContext");
     }
 }
 
 void Fiber::back() {
     SetThis(t_threadFiber.get());
-    if(swapcontext(&m_ctx, &t_threadFiber->m_ctx)) {
-        SYLAR_ASSERT2(false, "swapcontext");
+    if(!SwapFiberContext(m_ctx, t_threadFiber->m_ctx)) {
+        SYLAR_ASSERT2(false, "SwapFiberContext");
     }
 }
 
@@ -137,29 +268,35 @@ void Fiber::back() {
  * @brief 将调度器的主协程切换到当前协程执行。
  * @details 该方法会将当前线程的当前协程设置为调用此方法的协程，
  *          并确保当前协程不处于执行状态，然后将其状态设置为执行状态。
- *          最后使用 `swapcontext` 函数将执行权从调度器的主协程切换到当前协程。
- *          如果 `swapcontext` 函数调用失败，会触发断言。
+ *          最后使用 `SwapFiberContext` 函数将执行权从调度器的主协程切换到当前协程。
+ *          如果 `SwapFiberContext` 函数调用失败，会触发断言。
  */
 void Fiber::swapIn() {
-    SetThis(this);
     SYLAR_ASSERT(m_state != EXEC);
+    if(m_useSharedStack) {
+        acquireSharedStack();
+    }
+    SetThis(this);
     m_state = EXEC;
-    if(swapcontext(&Scheduler::GetMainFiber()->m_ctx, &m_ctx)) {
-        SYLAR_ASSERT2(false, "swapcontext");
+    if(!SwapFiberContext(Scheduler::GetMainFiber()->m_ctx, m_ctx)) {
+        SYLAR_ASSERT2(false, "SwapFiberContext");
     }
 }
 
 /**
  * @brief 将当前协程切换回调度器的主协程。
  * @details 该方法会将当前线程的当前协程设置为调度器的主协程，
- *          然后使用 `swapcontext` 函数将执行权从当前协程切换到调度器的主协程。
- *          如果 `swapcontext` 函数调用失败，会触发断言。
+ *          然后使用 `SwapFiberContext` 函数将执行权从当前协程切换到调度器的主协程。
+ *          如果 `SwapFiberContext` 函数调用失败，会触发断言。
  */
 void Fiber::swapOut() {
+#ifndef NDEBUG
+    SYLAR_ASSERT2(t_yieldable, "yield inside InlineTask");
+#endif
     // 将当前线程的当前协程设置为调度器的主协程
     SetThis(Scheduler::GetMainFiber());
-    if(swapcontext(&m_ctx, &Scheduler::GetMainFiber()->m_ctx)) {
-        SYLAR_ASSERT2(false, "swapcontext");
+    if(!SwapFiberContext(m_ctx, Scheduler::GetMainFiber()->m_ctx)) {
+        SYLAR_ASSERT2(false, "SwapFiberContext");
     }
 }
 
@@ -181,6 +318,9 @@ Fiber::ptr Fiber::GetThis() {
 
 //协程切换到后台，并且设置为Ready状态
 void Fiber::YieldToReady() {
+#ifndef NDEBUG
+    SYLAR_ASSERT2(t_yieldable, "yield inside InlineTask");
+#endif
     Fiber::ptr cur = GetThis();
     SYLAR_ASSERT(cur->m_state == EXEC);
     cur->m_state = READY;
@@ -189,12 +329,87 @@ void Fiber::YieldToReady() {
 
 //协程切换到后台，并且设置为Hold状态
 void Fiber::YieldToHold() {
+#ifndef NDEBUG
+    SYLAR_ASSERT2(t_yieldable, "yield inside InlineTask");
+#endif
     Fiber::ptr cur = GetThis();
     SYLAR_ASSERT(cur->m_state == EXEC);
     //cur->m_state = HOLD;
     cur->swapOut();
 }
 
+void Fiber::SetYieldable(bool v) {
+    t_yieldable = v;
+}
+
+bool Fiber::IsYieldable() {
+    return t_yieldable;
+}
+
+void Fiber::BeginTimeSlice() {
+    t_slice_end_us = CoarseNowUS() + s_time_slice_us;
+}
+
+void Fiber::EndTimeSlice() {
+    t_slice_end_us = 0;
+}
+
+bool Fiber::MaybeYield() {
+    if(!t_slice_end_us || !t_yieldable
+            || CoarseNowUS() < t_slice_end_us) {
+        return false;
+    }
+    YieldToReady();
+    return true;
+}
+
+void Fiber::lockJoiners() {
+    while(m_joinLock.exchange(true, std::memory_order_acquire)) {
+    }
+}
+
+void Fiber::join() {
+    SYLAR_ASSERT2(t_fiber != this, "fiber join itself");
+    Scheduler* scheduler = Scheduler::GetThis();
+    if(scheduler) {
+        Fiber::ptr cur = GetThis();
+        lockJoiners();
+        if(m_state == TERM || m_state == EXCEPT) {
+            unlockJoiners();
+            return;
+        }
+        m_joiners.push_back(TaskFunction([scheduler, cur](){
+            scheduler->schedule(cur);
+        }));
+        unlockJoiners();
+        //唤醒可能早于切出,调度器会等本协程切出后再恢复它
+        YieldToHold();
+    } else {
+        Semaphore sem;
+        lockJoiners();
+        if(m_state == TERM || m_state == EXCEPT) {
+            unlockJoiners();
+            return;
+        }
+        m_joiners.push_back(TaskFunction([&sem](){
+            sem.notify();
+        }));
+        unlockJoiners();
+        sem.wait();
+    }
+}
+
+void Fiber::notifyJoiners(State state) {
+    std::vector<TaskFunction> joiners;
+    lockJoiners();
+    m_state = state;
+    joiners.swap(m_joiners);
+    unlockJoiners();
+    for(auto& i : joiners) {
+        i();
+    }
+}
+
 //总协程数
 uint64_t Fiber::TotalFibers() {
     return s_fiber_count;
@@ -203,24 +418,25 @@ uint64_t Fiber::TotalFibers() {
 void Fiber::MainFunc() {
     Fiber::ptr cur = GetThis();
     SYLAR_ASSERT(cur);
+    State state = TERM;
     try {
         cur->m_cb();
         cur->m_cb = nullptr;
-        cur->m_state = TERM;
     } catch (std::exception& ex) {
-        cur->m_state = EXCEPT;
+        state = EXCEPT;
         SYLAR_LOG_ERROR(g_logger) << "Fiber Except: " << ex.what()
             << " fiber_id=" << cur->getId()
             << std::endl
             << Sylar::BacktraceToString();
     } catch (...) {
-        cur->m_state = EXCEPT;
+        state = EXCEPT;
         SYLAR_LOG_ERROR(g_logger) << "Fiber Except"
             << " fiber_id=" << cur->getId()
             << std::endl
             << Sylar::BacktraceToString();
     }
 
+    cur->notifyJoiners(state);
     auto raw_ptr = cur.get();
     cur.reset();
     raw_ptr->swapOut();
@@ -231,24 +447,25 @@ void Fiber::MainFunc() {
 void Fiber::CallerMainFunc() {
     Fiber::ptr cur = GetThis();
     SYLAR_ASSERT(cur);
+    State state = TERM;
     try {
         cur->m_cb();
         cur->m_cb = nullptr;
-        cur->m_state = TERM;
     } catch (std::exception& ex) {
-        cur->m_state = EXCEPT;
+        state = EXCEPT;
         SYLAR_LOG_ERROR(g_logger) << "Fiber Except: " << ex.what()
             << " fiber_id=" << cur->getId()
             << std::endl
             << Sylar::BacktraceToString();
     } catch (...) {
-        cur->m_state = EXCEPT;
+        state = EXCEPT;
         SYLAR_LOG_ERROR(g_logger) << "Fiber Except"
             << " fiber_id=" << cur->getId()
             << std::endl
             << Sylar::BacktraceToString();
     }
 
+    cur->notifyJoiners(state);
     auto raw_ptr = cur.get();
     cur.reset();
     raw_ptr->back();
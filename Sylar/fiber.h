@@ -11,11 +11,16 @@
 
 #include <memory>
 #include <functional>
-#include <ucontext.h>
+#include <atomic>
+#include <vector>
+#include "fiber_context.h"
+#include "task_function.h"
 
 namespace Sylar {
 
 class Scheduler;
+class StackAllocator;
+struct SharedStack;
 
 /**
  * @brief 协程类
@@ -48,8 +53,15 @@ public:
      * @param[in] cb 协程执行的函数
      * @param[in] stacksize 协程栈大小
      * @param[in] use_caller 是否在MainFiber上调度
+     * @param[in] shared_stack 是否使用共享栈
+     * @details 共享栈模式下协程运行在所在线程的共享运行栈上,切出后只把实际用到的
+     *          部分拷贝到按需分配的保存缓冲区;协程第一次运行时绑定到当前线程,
+     *          之后只能在该线程上恢复(Scheduler会自动投递到该线程)。
+     *          仅汇编上下文切换支持共享栈,否则退化为独立栈。
+     * @attention 共享栈协程挂起期间其栈上的变量地址无效,不要把栈上变量的指针交给其他协程
      */
-    Fiber(std::function<void()> cb, size_t stacksize = 0, bool use_caller = false);
+    Fiber(TaskFunction cb, size_t stacksize = 0, bool use_caller = false
+          ,bool shared_stack = false);
 
     /**
      * @brief 析构函数
@@ -61,7 +73,7 @@ public:
      * @pre getState() 为 INIT, TERM, EXCEPT
      * @post getState() = INIT
      */
-    void reset(std::function<void()> cb);
+    void reset(TaskFunction cb);
 
     /**
      * @brief 将当前协程切换到运行状态
@@ -97,6 +109,35 @@ public:
      * @brief 返回协程状态
      */
     State getState() const { return m_state;}
+
+    /**
+     * @brief 是否使用共享栈
+     */
+    bool isSharedStack() const { return m_useSharedStack;}
+
+    /**
+     * @brief 返回共享栈协程绑定的线程id,未绑定返回-1
+     */
+    int getStackThread() const { return m_stackThread;}
+
+    /**
+     * @brief 返回调度优先级(Scheduler::Priority),-1表示未设置
+     */
+    int getPriority() const { return m_priority;}
+
+    /**
+     * @brief 设置调度优先级,之后再次被调度(如IO就绪)时沿用
+     */
+    void setPriority(int v) { m_priority = v;}
+
+    /**
+     * @brief 等待协程执行结束
+     * @details 在协程调度器中调用时挂起当前协程,由结束的协程唤醒,不阻塞线程;
+     *          否则阻塞当前线程
+     * @pre 不能等待自己
+     * @post getState() 为 TERM 或 EXCEPT
+     */
+    void join();
 public:
 
     /**
@@ -143,6 +184,63 @@ public:
      * @brief 获取当前协程的id
      */
     static uint64_t GetFiberId();
+
+    /**
+     * @brief 设置当前线程是否允许让出
+     * @details 调度器执行InlineTask期间设置为false
+     */
+    static void SetYieldable(bool v);
+
+    /**
+     * @brief 当前线程是否允许让出
+     */
+    static bool IsYieldable();
+
+    /**
+     * @brief 协作式调度检查点
+     * @details 当前协程本次连续运行超过时间片(fiber.time_slice_ms)时YieldToReady让出,
+     *          否则立即返回。只读取一次粗粒度时钟,可以放在长循环中;
+     *          不在调度器调度的协程中或不允许让出时不做任何事
+     * @return 是否让出过
+     */
+    static bool MaybeYield();
+private:
+    /**
+     * @brief 调度器切入协程前开始新的时间片
+     */
+    static void BeginTimeSlice();
+
+    /**
+     * @brief 协程切回调度器后结束时间片
+     */
+    static void EndTimeSlice();
+
+    /**
+     * @brief 切入共享栈协程前,把共享运行栈让给该协程
+     * @details 未绑定时绑定到当前线程的共享运行栈,占用者的栈内容拷出,本协程的栈内容拷回
+     */
+    void acquireSharedStack();
+
+    /**
+     * @brief 解除与共享运行栈的绑定
+     */
+    void releaseSharedStack();
+
+    /**
+     * @brief 将驻留在共享运行栈上的协程的栈内容拷贝到它的保存缓冲区
+     */
+    static void EvictSharedStack(SharedStack* stack);
+
+    /**
+     * @brief 协程结束后设置结束状态并唤醒所有join的等待者
+     * @details 结束状态在join锁内设置,join在锁内检查,不会错过唤醒也不会读到中间状态
+     * @param[in] state TERM 或 EXCEPT
+     */
+    void notifyJoiners(State state);
+
+    void lockJoiners();
+
+    void unlockJoiners() { m_joinLock.store(false, std::memory_order_release);}
 private:
     /// 协程id
     uint64_t m_id = 0;
@@ -151,11 +249,31 @@ private:
     /// 协程状态
     State m_state = INIT;
     /// 协程上下文
-    ucontext_t m_ctx;
+    FiberContext m_ctx;
     /// 协程运行栈指针
     void* m_stack = nullptr;
+    /// 协程运行栈的分配器
+    StackAllocator* m_allocator = nullptr;
+    /// 是否使用共享栈
+    bool m_useSharedStack = false;
+    /// 共享栈模式下绑定的线程id
+    int m_stackThread = -1;
+    /// 共享栈模式下绑定的共享运行栈
+    SharedStack* m_sharedStack = nullptr;
+    /// 共享栈模式下切出时保存的栈内容
+    char* m_saveBuffer = nullptr;
+    /// 保存的栈内容大小
+    size_t m_saveSize = 0;
+    /// 保存缓冲区的容量
+    size_t m_saveCapacity = 0;
+    /// 调度优先级
+    int m_priority = -1;
     /// 协程运行函数
-    std::function<void()> m_cb;
+    TaskFunction m_cb;
+    /// 保护m_joiners的自旋锁
+    std::atomic<bool> m_joinLock = {false};
+    /// join等待者的唤醒函数
+    std::vector<TaskFunction> m_joiners;
 };
 
 }
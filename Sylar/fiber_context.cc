@@ -0,0 +1,171 @@
+#include "fiber_context.h"
+#include <stdint.h>
+#include <string.h>
+
+#ifdef SYLAR_FIBER_USE_ASM
+
+#if defined(__x86_64__)
+/**
+ * 栈帧布局(低地址 -> 高地址):
+ *   mxcsr/x87控制字, r15, r14, r13, r12, rbx, rbp, 返回地址
+ */
+__asm__(
+    ".text\n"
+    ".globl sylar_swap_context\n"
+    ".type sylar_swap_context,@function\n"
+    ".align 16\n"
+    "sylar_swap_context:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size sylar_swap_context,.-sylar_swap_context\n"
+
+    ".globl sylar_context_entry\n"
+    ".type sylar_context_entry,@function\n"
+    ".align 16\n"
+    "sylar_context_entry:\n"
+    "    .cfi_startproc\n"
+    "    .cfi_undefined rip\n"
+    "    callq *%r12\n"
+    "    ud2\n"
+    "    .cfi_endproc\n"
+    ".size sylar_context_entry,.-sylar_context_entry\n"
+);
+
+extern "C" void sylar_context_entry();
+
+extern "C" void* sylar_make_context(void* stack, size_t size, void (*fn)()) {
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+    //返回地址之上保持16字节对齐,进入fn时满足 rsp % 16 == 8
+    top -= 16;
+    uint64_t* sp = (uint64_t*)top;
+    *--sp = (uint64_t)&sylar_context_entry;  //ret
+    *--sp = 0;                               //rbp
+    *--sp = 0;                               //rbx
+    *--sp = (uint64_t)fn;                    //r12
+    *--sp = 0;                               //r13
+    *--sp = 0;                               //r14
+    *--sp = 0;                               //r15
+    --sp;
+    uint32_t mxcsr = 0x1F80;
+    uint16_t fpucw = 0x037F;
+    memcpy(sp, &mxcsr, sizeof(mxcsr));
+    memcpy((char*)sp + 4, &fpucw, sizeof(fpucw));
+    return sp;
+}
+
+#elif defined(__aarch64__)
+/**
+ * 栈帧布局(低地址 -> 高地址):
+ *   d8-d15, x19-x28, x29, x30
+ */
+__asm__(
+    ".text\n"
+    ".globl sylar_swap_context\n"
+    ".type sylar_swap_context,%function\n"
+    ".align 4\n"
+    "sylar_swap_context:\n"
+    "    sub sp, sp, #0xa0\n"
+    "    stp d8, d9, [sp, #0x00]\n"
+    "    stp d10, d11, [sp, #0x10]\n"
+    "    stp d12, d13, [sp, #0x20]\n"
+    "    stp d14, d15, [sp, #0x30]\n"
+    "    stp x19, x20, [sp, #0x40]\n"
+    "    stp x21, x22, [sp, #0x50]\n"
+    "    stp x23, x24, [sp, #0x60]\n"
+    "    stp x25, x26, [sp, #0x70]\n"
+    "    stp x27, x28, [sp, #0x80]\n"
+    "    stp x29, x30, [sp, #0x90]\n"
+    "    mov x9, sp\n"
+    "    str x9, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp d8, d9, [sp, #0x00]\n"
+    "    ldp d10, d11, [sp, #0x10]\n"
+    "    ldp d12, d13, [sp, #0x20]\n"
+    "    ldp d14, d15, [sp, #0x30]\n"
+    "    ldp x19, x20, [sp, #0x40]\n"
+    "    ldp x21, x22, [sp, #0x50]\n"
+    "    ldp x23, x24, [sp, #0x60]\n"
+    "    ldp x25, x26, [sp, #0x70]\n"
+    "    ldp x27, x28, [sp, #0x80]\n"
+    "    ldp x29, x30, [sp, #0x90]\n"
+    "    add sp, sp, #0xa0\n"
+    "    ret\n"
+    ".size sylar_swap_context,.-sylar_swap_context\n"
+
+    ".globl sylar_context_entry\n"
+    ".type sylar_context_entry,%function\n"
+    ".align 4\n"
+    "sylar_context_entry:\n"
+    "    .cfi_startproc\n"
+    "    .cfi_undefined x30\n"
+    "    blr x19\n"
+    "    brk #0\n"
+    "    .cfi_endproc\n"
+    ".size sylar_context_entry,.-sylar_context_entry\n"
+);
+
+extern "C" void sylar_context_entry();
+
+extern "C" void* sylar_make_context(void* stack, size_t size, void (*fn)()) {
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+    uint64_t* sp = (uint64_t*)(top - 0xa0);
+    memset(sp, 0, 0xa0);
+    sp[8] = (uint64_t)fn;                        //x19
+    sp[19] = (uint64_t)&sylar_context_entry;     //x30
+    return sp;
+}
+
+#endif
+
+#endif
+
+namespace Sylar {
+
+const char* GetFiberContextName() {
+#ifdef SYLAR_FIBER_USE_ASM
+#if defined(__x86_64__)
+    return "asm-x86_64";
+#else
+    return "asm-aarch64";
+#endif
+#else
+    return "ucontext";
+#endif
+}
+
+bool MakeFiberContext(FiberContext& ctx, void* stack, size_t size, void (*fn)()) {
+#ifdef SYLAR_FIBER_USE_ASM
+    ctx = sylar_make_context(stack, size, fn);
+    return true;
+#else
+    if(getcontext(&ctx)) {
+        return false;
+    }
+    ctx.uc_link = nullptr;
+    ctx.uc_stack.ss_sp = stack;
+    ctx.uc_stack.ss_size = size;
+    makecontext(&ctx, fn, 0);
+    return true;
+#endif
+}
+
+}
@@ -0,0 +1,80 @@
+/**
+ * @file fiber_context.h
+ * @brief 协程上下文切换
+ * @details x86-64 和 aarch64 上默认使用手写汇编,只保存/恢复被调用者保存的寄存器,
+ *          不像 swapcontext 那样每次切换都调用 rt_sigprocmask。
+ *          编译时定义 SYLAR_FIBER_UCONTEXT 可强制使用 ucontext 实现,
+ *          其它平台自动回退到 ucontext。
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_FIBER_CONTEXT_H__
+#define __SYLAR_FIBER_CONTEXT_H__
+
+#include <stddef.h>
+
+#if !defined(SYLAR_FIBER_UCONTEXT) && (defined(__x86_64__) || defined(__aarch64__))
+#define SYLAR_FIBER_USE_ASM 1
+#endif
+
+#ifndef SYLAR_FIBER_USE_ASM
+#include <ucontext.h>
+#endif
+
+#ifdef SYLAR_FIBER_USE_ASM
+extern "C" {
+/**
+ * @brief 保存当前寄存器到当前栈上,把栈指针写入 *from_sp,再切换到 to_sp
+ */
+void sylar_swap_context(void** from_sp, void* to_sp);
+
+/**
+ * @brief 在 stack 上构造初始栈帧,首次切换进来时执行 fn
+ * @return 初始栈指针
+ */
+void* sylar_make_context(void* stack, size_t size, void (*fn)());
+}
+#endif
+
+namespace Sylar {
+
+#ifdef SYLAR_FIBER_USE_ASM
+/// 协程上下文,保存的是切出时的栈指针
+typedef void* FiberContext;
+#else
+typedef ucontext_t FiberContext;
+#endif
+
+/**
+ * @brief 返回上下文切换的实现名称
+ */
+const char* GetFiberContextName();
+
+/**
+ * @brief 初始化协程上下文,切换进来后在 stack 上执行 fn
+ * @param[out] ctx 协程上下文
+ * @param[in] stack 栈起始地址(低地址)
+ * @param[in] size 栈大小
+ * @param[in] fn 执行函数,不允许返回
+ * @return 是否成功
+ */
+bool MakeFiberContext(FiberContext& ctx, void* stack, size_t size, void (*fn)());
+
+/**
+ * @brief 保存当前上下文到 from,切换到 to
+ * @return 是否成功
+ */
+inline bool SwapFiberContext(FiberContext& from, FiberContext& to) {
+#ifdef SYLAR_FIBER_USE_ASM
+    sylar_swap_context(&from, to);
+    return true;
+#else
+    return swapcontext(&from, &to) == 0;
+#endif
+}
+
+}
+
+#endif
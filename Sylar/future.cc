@@ -0,0 +1,38 @@
+#include "future.h"
+#include "macro.h"
+
+namespace Sylar {
+
+WaitGroup::WaitGroup(int count)
+    :m_count(count) {
+}
+
+WaitGroup::~WaitGroup() {
+    SYLAR_ASSERT(m_waiters.empty());
+}
+
+void WaitGroup::add(int n) {
+    m_count += n;
+}
+
+void WaitGroup::done() {
+    int count = --m_count;
+    SYLAR_ASSERT2(count >= 0, "WaitGroup count < 0");
+    if(count == 0) {
+        MutexType::Lock lock(m_mutex);
+        m_waiters.notifyAll();
+    }
+}
+
+void WaitGroup::wait() {
+    if(m_count == 0) {
+        return;
+    }
+    MutexType::Lock lock(m_mutex);
+    if(m_count == 0) {
+        return;
+    }
+    m_waiters.wait(lock);
+}
+
+}
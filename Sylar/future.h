@@ -0,0 +1,429 @@
+/**
+ * @file future.h
+ * @brief 协程级的 Future/Promise、WaitGroup 及 WhenAll/WhenAny 组合
+ * @details 在协程调度器中等待时挂起当前协程,由完成方通过调度器唤醒,不阻塞线程;
+ *          不在协程调度器中(如主线程)等待时阻塞线程
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_FUTURE_H__
+#define __SYLAR_FUTURE_H__
+
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "mutex.h"
+#include "scheduler.h"
+
+namespace Sylar {
+
+/**
+ * @brief 等待一组任务完成
+ * @details 用法与Go的sync.WaitGroup相同:启动任务前add,任务结束时done,wait等待计数归零
+ */
+class WaitGroup : Noncopyable {
+public:
+    typedef Spinlock MutexType;
+
+    /**
+     * @brief 构造函数
+     * @param[in] count 初始计数
+     */
+    WaitGroup(int count = 0);
+
+    ~WaitGroup();
+
+    /**
+     * @brief 增加计数
+     */
+    void add(int n = 1);
+
+    /**
+     * @brief 计数减一,归零时唤醒所有等待者
+     */
+    void done();
+
+    /**
+     * @brief 等待计数归零
+     */
+    void wait();
+
+    /**
+     * @brief 返回当前计数
+     */
+    int getCount() const { return m_count;}
+private:
+    MutexType m_mutex;
+    std::atomic<int> m_count;
+    FiberWaitList m_waiters;
+};
+
+/**
+ * @brief Future保存的结果
+ */
+template<class T>
+class FutureValue {
+public:
+    typedef T& Ref;
+
+    ~FutureValue() {
+        if(m_has) {
+            get().~T();
+        }
+    }
+
+    template<class V>
+    void set(V&& v) {
+        new (&m_storage) T(std::forward<V>(v));
+        m_has = true;
+    }
+
+    T& get() { return *reinterpret_cast<T*>(&m_storage);}
+private:
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+    bool m_has = false;
+};
+
+template<>
+class FutureValue<void> {
+public:
+    typedef void Ref;
+
+    void set() {}
+
+    void get() {}
+};
+
+/**
+ * @brief Future/Promise的共享状态
+ */
+template<class T>
+class FutureState : Noncopyable {
+public:
+    typedef std::shared_ptr<FutureState> ptr;
+    typedef Spinlock MutexType;
+    typedef typename FutureValue<T>::Ref Ref;
+
+    /**
+     * @brief 结果是否已就绪
+     */
+    bool isReady() const { return m_ready;}
+
+    /**
+     * @brief 等待结果就绪
+     */
+    void wait() {
+        if(m_ready) {
+            return;
+        }
+        MutexType::Lock lock(m_mutex);
+        if(m_ready) {
+            return;
+        }
+        m_waiters.wait(lock);
+    }
+
+    /**
+     * @brief 等待并返回结果,异常结果会被重新抛出
+     */
+    Ref get() {
+        wait();
+        if(m_error) {
+            std::rethrow_exception(m_error);
+        }
+        return m_value.get();
+    }
+
+    /**
+     * @brief 设置结果
+     * @exception std::logic_error 结果已经设置过
+     */
+    template<class... V>
+    void setValue(V&&... v) {
+        MutexType::Lock lock(m_mutex);
+        checkNotReady();
+        m_value.set(std::forward<V>(v)...);
+        complete(lock);
+    }
+
+    /**
+     * @brief 设置异常结果
+     * @exception std::logic_error 结果已经设置过
+     */
+    void setException(std::exception_ptr e) {
+        MutexType::Lock lock(m_mutex);
+        checkNotReady();
+        m_error = e;
+        complete(lock);
+    }
+
+    /**
+     * @brief 结果就绪后执行cb
+     * @details 已就绪时立即在当前线程执行,否则在设置结果的线程上执行,cb中不能阻塞
+     */
+    void onReady(TaskFunction cb) {
+        {
+            MutexType::Lock lock(m_mutex);
+            if(!m_ready) {
+                m_callbacks.push_back(std::move(cb));
+                return;
+            }
+        }
+        cb();
+    }
+private:
+    void checkNotReady() {
+        if(m_ready) {
+            throw std::logic_error("future value already set");
+        }
+    }
+
+    void complete(MutexType::Lock& lock) {
+        m_ready = true;
+        m_waiters.notifyAll();
+        std::vector<TaskFunction> callbacks;
+        callbacks.swap(m_callbacks);
+        lock.unlock();
+        for(auto& i : callbacks) {
+            i();
+        }
+    }
+private:
+    MutexType m_mutex;
+    std::atomic<bool> m_ready = {false};
+    FutureValue<T> m_value;
+    std::exception_ptr m_error;
+    FiberWaitList m_waiters;
+    std::vector<TaskFunction> m_callbacks;
+};
+
+/**
+ * @brief 异步结果的读取端
+ * @details 可以复制,多个协程可以同时等待同一个结果
+ */
+template<class T>
+class Future {
+public:
+    typedef typename FutureState<T>::Ref Ref;
+
+    /**
+     * @brief 构造无效的Future
+     */
+    Future() {}
+
+    explicit Future(typename FutureState<T>::ptr state)
+        :m_state(std::move(state)) {
+    }
+
+    /**
+     * @brief 是否关联了共享状态
+     */
+    bool valid() const { return !!m_state;}
+
+    /**
+     * @brief 结果是否已就绪
+     */
+    bool isReady() const { return m_state->isReady();}
+
+    /**
+     * @brief 等待结果就绪
+     */
+    void wait() const { m_state->wait();}
+
+    /**
+     * @brief 等待并返回结果,异常结果会被重新抛出
+     */
+    Ref get() const { return m_state->get();}
+
+    /**
+     * @brief 结果就绪后执行cb,cb中不能阻塞
+     */
+    void onReady(TaskFunction cb) const { m_state->onReady(std::move(cb));}
+private:
+    typename FutureState<T>::ptr m_state;
+};
+
+/**
+ * @brief 异步结果的写入端
+ * @details 可以复制以便被lambda捕获,结果只能设置一次
+ */
+template<class T>
+class Promise {
+public:
+    Promise()
+        :m_state(std::make_shared<FutureState<T> >()) {
+    }
+
+    /**
+     * @brief 返回关联的Future
+     */
+    Future<T> getFuture() const { return Future<T>(m_state);}
+
+    /**
+     * @brief 设置结果并唤醒所有等待者
+     */
+    template<class... V>
+    void setValue(V&&... v) const { m_state->setValue(std::forward<V>(v)...);}
+
+    /**
+     * @brief 设置异常结果并唤醒所有等待者
+     */
+    void setException(std::exception_ptr e) const { m_state->setException(e);}
+private:
+    typename FutureState<T>::ptr m_state;
+};
+
+/**
+ * @brief 执行函数并把返回值或异常写入Promise
+ */
+template<class R>
+struct FutureInvoker {
+    template<class F>
+    static void Call(const Promise<R>& p, F& f) {
+        p.setValue(f());
+    }
+};
+
+template<>
+struct FutureInvoker<void> {
+    template<class F>
+    static void Call(const Promise<void>& p, F& f) {
+        f();
+        p.setValue();
+    }
+};
+
+/**
+ * @brief Async投递到调度器的任务
+ */
+template<class F, class R>
+struct AsyncTask {
+    F func;
+    Promise<R> promise;
+
+    void operator()() {
+        try {
+            FutureInvoker<R>::Call(promise, func);
+        } catch (...) {
+            promise.setException(std::current_exception());
+        }
+    }
+};
+
+/**
+ * @brief 在调度器中异步执行函数
+ * @param[in] f 无参函数
+ * @param[in] scheduler 执行的调度器,默认当前调度器
+ * @return 函数返回值的Future,函数抛出的异常在get时重新抛出
+ */
+template<class F>
+Future<typename std::decay<decltype(std::declval<typename std::decay<F>::type&>()())>::type>
+Async(F&& f, Scheduler* scheduler = Scheduler::GetThis()) {
+    typedef typename std::decay<F>::type Func;
+    typedef typename std::decay<decltype(std::declval<Func&>()())>::type R;
+    AsyncTask<Func, R> task{Func(std::forward<F>(f)), Promise<R>()};
+    Future<R> future = task.promise.getFuture();
+    scheduler->schedule(std::move(task));
+    return future;
+}
+
+/**
+ * @brief WhenAll的计数
+ */
+struct WhenAllState {
+    std::atomic<size_t> left;
+    Promise<void> promise;
+
+    void done() {
+        if(--left == 0) {
+            promise.setValue();
+        }
+    }
+};
+
+/**
+ * @brief WhenAny的状态
+ */
+struct WhenAnyState {
+    std::atomic<bool> done = {false};
+    Promise<size_t> promise;
+
+    void set(size_t index) {
+        if(!done.exchange(true)) {
+            promise.setValue(index);
+        }
+    }
+};
+
+/**
+ * @brief 所有Future就绪(包括异常结果)后就绪
+ * @details 结果和异常仍从各个Future中读取
+ */
+template<class T>
+Future<void> WhenAll(const std::vector<Future<T> >& futures) {
+    std::shared_ptr<WhenAllState> state = std::make_shared<WhenAllState>();
+    state->left = futures.size() + 1;
+    for(auto& i : futures) {
+        i.onReady([state](){ state->done();});
+    }
+    Future<void> future = state->promise.getFuture();
+    state->done();
+    return future;
+}
+
+/**
+ * @brief 所有Future就绪后就绪,Future的结果类型可以不同
+ */
+template<class... T>
+Future<void> WhenAll(const Future<T>&... futures) {
+    std::shared_ptr<WhenAllState> state = std::make_shared<WhenAllState>();
+    state->left = sizeof...(T) + 1;
+    int expand[] = {0, (futures.onReady([state](){ state->done();}), 0)...};
+    (void)expand;
+    Future<void> future = state->promise.getFuture();
+    state->done();
+    return future;
+}
+
+/**
+ * @brief 任意一个Future就绪后就绪
+ * @return 最先就绪的Future的下标
+ * @exception std::invalid_argument futures为空
+ */
+template<class T>
+Future<size_t> WhenAny(const std::vector<Future<T> >& futures) {
+    if(futures.empty()) {
+        throw std::invalid_argument("WhenAny of empty futures");
+    }
+    std::shared_ptr<WhenAnyState> state = std::make_shared<WhenAnyState>();
+    Future<size_t> future = state->promise.getFuture();
+    for(size_t i = 0; i < futures.size() && !state->done; ++i) {
+        futures[i].onReady([state, i](){ state->set(i);});
+    }
+    return future;
+}
+
+/**
+ * @brief 任意一个Future就绪后就绪,Future的结果类型可以不同
+ * @return 最先就绪的Future在参数中的下标
+ */
+template<class... T>
+Future<size_t> WhenAny(const Future<T>&... futures) {
+    static_assert(sizeof...(T) > 0, "WhenAny of empty futures");
+    std::shared_ptr<WhenAnyState> state = std::make_shared<WhenAnyState>();
+    Future<size_t> future = state->promise.getFuture();
+    size_t index = 0;
+    int expand[] = {0, (futures.onReady([state, index](){ state->set(index);}), ++index, 0)...};
+    (void)expand;
+    return future;
+}
+
+}
+
+#endif
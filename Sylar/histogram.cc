@@ -0,0 +1,52 @@
+#include "histogram.h"
+
+namespace Sylar {
+
+void Histogram::merge(const Histogram& o) {
+    for(size_t i = 0; i < BUCKETS; ++i) {
+        m_buckets[i].add(o.m_buckets[i].get());
+    }
+    m_count.add(o.m_count.get());
+    m_sum.add(o.m_sum.get());
+    m_max.updateMax(o.m_max.get());
+}
+
+uint64_t Histogram::percentile(double p) const {
+    uint64_t count = 0;
+    uint64_t buckets[BUCKETS];
+    //各桶分别读取,先求和保证与桶计数一致
+    for(size_t i = 0; i < BUCKETS; ++i) {
+        buckets[i] = m_buckets[i].get();
+        count += buckets[i];
+    }
+    if(!count) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(p * count + 0.5);
+    if(target == 0) {
+        target = 1;
+    }
+    uint64_t max = m_max.get();
+    uint64_t acc = 0;
+    for(size_t i = 0; i < BUCKETS; ++i) {
+        acc += buckets[i];
+        if(acc >= target) {
+            uint64_t upper = i ? ((1ull << i) - 1) : 0;
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+std::ostream& Histogram::dump(std::ostream& os) const {
+    uint64_t count = getCount();
+    os << "count=" << count
+       << " avg=" << (count ? getSum() / count : 0)
+       << " p50=" << percentile(0.5)
+       << " p90=" << percentile(0.9)
+       << " p99=" << percentile(0.99)
+       << " max=" << getMax();
+    return os;
+}
+
+}
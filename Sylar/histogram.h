@@ -0,0 +1,117 @@
+/**
+ * @file histogram.h
+ * @brief 低开销的统计计数器和直方图
+ * @details 每个实例只允许一个线程写入,写入时不使用原子读改写指令;
+ *          其他线程可以随时读取用于汇总,读到的值可能略有滞后
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_HISTOGRAM_H__
+#define __SYLAR_HISTOGRAM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <ostream>
+
+namespace Sylar {
+
+/**
+ * @brief 单写者计数器
+ */
+class StatCounter {
+public:
+    /**
+     * @brief 增加计数,只能由所属线程调用
+     */
+    void add(uint64_t v = 1) {
+        m_value.store(m_value.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 更新为较大值,只能由所属线程调用
+     */
+    void updateMax(uint64_t v) {
+        if(v > m_value.load(std::memory_order_relaxed)) {
+            m_value.store(v, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief 返回当前值
+     */
+    uint64_t get() const { return m_value.load(std::memory_order_relaxed);}
+private:
+    std::atomic<uint64_t> m_value = {0};
+};
+
+/**
+ * @brief 按2的幂分桶的直方图
+ * @details 第0个桶统计值0,第i个桶统计[2^(i-1), 2^i)范围内的值,
+ *          分位数按所在桶的上界估算
+ */
+class Histogram {
+public:
+    /// 桶数量
+    static const size_t BUCKETS = 32;
+
+    /**
+     * @brief 记录一个值,只能由所属线程调用
+     */
+    void add(uint64_t v) {
+        size_t idx = v ? 64 - __builtin_clzll(v) : 0;
+        if(idx >= BUCKETS) {
+            idx = BUCKETS - 1;
+        }
+        m_buckets[idx].add();
+        m_count.add();
+        m_sum.add(v);
+        m_max.updateMax(v);
+    }
+
+    /**
+     * @brief 把o的数据累加到当前直方图(用于读取方汇总)
+     */
+    void merge(const Histogram& o);
+
+    /**
+     * @brief 返回记录的值数量
+     */
+    uint64_t getCount() const { return m_count.get();}
+
+    /**
+     * @brief 返回记录的值总和
+     */
+    uint64_t getSum() const { return m_sum.get();}
+
+    /**
+     * @brief 返回记录的最大值
+     */
+    uint64_t getMax() const { return m_max.get();}
+
+    /**
+     * @brief 返回分位数的估算值
+     * @param[in] p 分位,取值(0, 1]
+     */
+    uint64_t percentile(double p) const;
+
+    /**
+     * @brief 输出 count/avg/p50/p90/p99/max
+     */
+    std::ostream& dump(std::ostream& os) const;
+private:
+    /// 各桶计数
+    StatCounter m_buckets[BUCKETS];
+    /// 值数量
+    StatCounter m_count;
+    /// 值总和
+    StatCounter m_sum;
+    /// 最大值
+    StatCounter m_max;
+};
+
+}
+
+#endif
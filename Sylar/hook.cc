@@ -1,11 +1,14 @@
 #include "hook.h"
 #include <dlfcn.h>
+#include <poll.h>
+#include <string.h>
 
 #include "config.h"
 #include "log.h"
 #include "fiber.h"
 #include "iomanager.h"
 #include "fd_manager.h"
+#include "io_uring.h"
 #include "macro.h"
 
 Sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
@@ -97,7 +100,142 @@ struct timer_info {
     int cancelled = 0;
 };
 
-template<typename OriginFun, typename... Args>
+/**
+ * @brief recvfrom/sendto转为RECVMSG/SENDMSG时构造的msghdr
+ * @details 位于发起协程的栈上,submitIo提交前把msghdr和iovec复制到堆上的操作状态中,
+ *          完成后回写msg_namelen,再由这里写回调用方的addrlen
+ */
+struct io_msg {
+    struct msghdr msg;
+    struct iovec iov;
+    socklen_t* namelen = nullptr;
+};
+
+/**
+ * @brief 把hook的调用参数填为等价的io_uring操作,没有对应操作的调用传nullptr
+ */
+static void prep_accept(io_uring_sqe* sqe, int fd, struct sockaddr* addr, socklen_t* addrlen) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->addr2 = (uint64_t)(uintptr_t)addrlen;
+}
+
+static void prep_read(io_uring_sqe* sqe, int fd, void* buf, size_t count) {
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = count;
+    //使用并推进文件当前偏移,与read一致
+    sqe->off = (uint64_t)-1;
+}
+
+static void prep_readv(io_uring_sqe* sqe, int fd, const struct iovec* iov, int iovcnt) {
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = iovcnt;
+    sqe->off = (uint64_t)-1;
+}
+
+static void prep_recv(io_uring_sqe* sqe, int fd, void* buf, size_t len, int flags) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->msg_flags = flags;
+}
+
+static void prep_recvmsg(io_uring_sqe* sqe, int fd, struct msghdr* msg, int flags) {
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+}
+
+static void prep_recvfrom(io_uring_sqe* sqe, io_msg* m, int fd, void* buf, size_t len, int flags,
+        struct sockaddr* src_addr, socklen_t* addrlen) {
+    memset(&m->msg, 0, sizeof(m->msg));
+    m->iov.iov_base = buf;
+    m->iov.iov_len = len;
+    m->msg.msg_iov = &m->iov;
+    m->msg.msg_iovlen = 1;
+    if(src_addr && addrlen) {
+        m->msg.msg_name = src_addr;
+        m->msg.msg_namelen = *addrlen;
+        m->namelen = addrlen;
+    }
+    prep_recvmsg(sqe, fd, &m->msg, flags);
+}
+
+static void prep_write(io_uring_sqe* sqe, int fd, const void* buf, size_t count) {
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = count;
+    sqe->off = (uint64_t)-1;
+}
+
+static void prep_writev(io_uring_sqe* sqe, int fd, const struct iovec* iov, int iovcnt) {
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = iovcnt;
+    sqe->off = (uint64_t)-1;
+}
+
+static void prep_send(io_uring_sqe* sqe, int fd, const void* msg, size_t len, int flags) {
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = len;
+    sqe->msg_flags = flags;
+}
+
+static void prep_sendmsg(io_uring_sqe* sqe, int fd, const struct msghdr* msg, int flags) {
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+}
+
+static void prep_sendto(io_uring_sqe* sqe, io_msg* m, int fd, const void* buf, size_t len, int flags,
+        const struct sockaddr* to, socklen_t tolen) {
+    memset(&m->msg, 0, sizeof(m->msg));
+    m->iov.iov_base = const_cast<void*>(buf);
+    m->iov.iov_len = len;
+    m->msg.msg_iov = &m->iov;
+    m->msg.msg_iovlen = 1;
+    m->msg.msg_name = const_cast<struct sockaddr*>(to);
+    m->msg.msg_namelen = to ? tolen : 0;
+    prep_sendmsg(sqe, fd, &m->msg, flags);
+}
+
+template<typename... Args>
+static bool prep_io(std::nullptr_t, io_uring_sqe* /*sqe*/, io_msg* /*m*/, int /*fd*/, Args&&... /*args*/) {
+    return false;
+}
+
+template<typename Prep, typename... Args>
+static bool prep_io(Prep prep, io_uring_sqe* sqe, io_msg* /*m*/, int fd, Args&&... args) {
+    memset(sqe, 0, sizeof(*sqe));
+    prep(sqe, fd, std::forward<Args>(args)...);
+    return true;
+}
+
+/**
+ * @brief 需要构造msghdr的操作(recvfrom/sendto),msghdr放在m中
+ */
+template<typename... PrepArgs, typename... Args>
+static bool prep_io(void (*prep)(io_uring_sqe*, io_msg*, PrepArgs...), io_uring_sqe* sqe, io_msg* m,
+        int fd, Args&&... args) {
+    memset(sqe, 0, sizeof(*sqe));
+    prep(sqe, m, fd, std::forward<Args>(args)...);
+    return true;
+}
+
 /**
  * @brief 处理带有钩子功能的 I/O 操作
  * 
@@ -112,16 +250,18 @@ template<typename OriginFun, typename... Args>
  * @param hook_fun_name 钩子函数的名称，用于日志输出
  * @param event 要监听的 I/O 事件，如 Sylar::IOManager::READ 或 Sylar::IOManager::WRITE
  * @param timeout_so 超时选项，如 SO_RCVTIMEO 或 SO_SNDTIMEO
+ * @param prep 填写等价io_uring操作的函数，使用io_uring后端时代替等待就绪再重试，nullptr 表示始终等待就绪
  * @param args 传递给原始系统调用函数的参数
  * @return ssize_t I/O 操作的返回值，-1 表示出错
  */
+template<typename OriginFun, typename PrepFun, typename... Args>
 static ssize_t do_io(int fd, OriginFun fun, const char* hook_fun_name,
-        uint32_t event, int timeout_so, Args&&... args) {
+        uint32_t event, int timeout_so, PrepFun prep, Args&&... args) {
     if(!Sylar::t_hook_enable) {
         return fun(fd, std::forward<Args>(args)...);
     }
 
-    Sylar::FdCtx::ptr ctx = Sylar::FdMgr::GetInstance()->get(fd);
+    Sylar::FdCtx* ctx = Sylar::FdMgr::GetInstance()->get(fd);
     if(!ctx) {
         return fun(fd, std::forward<Args>(args)...);
     }
@@ -149,18 +289,41 @@ retry:
     // 如果 I/O 操作返回 -1 且错误码为 EAGAIN，说明资源暂时不可用
     if(n == -1 && errno == EAGAIN) {
         Sylar::IOManager* iom = Sylar::IOManager::GetThis();
+        io_uring_sqe sqe;
+        io_msg msg;
+        // io_uring 后端直接提交操作本身，完成时结果已就绪，无需再注册事件和重试
+        // 共享栈协程让出后栈被换出，内核不能写入其栈上的缓冲区，仍走等待就绪
+        if(iom->isIoUring() && !Sylar::Fiber::GetThis()->isSharedStack()
+                && prep_io(prep, &sqe, &msg, fd, args...)) {
+            int rt = iom->submitIo(sqe, to);
+            if(rt >= 0) {
+                if(msg.namelen) {
+                    *msg.namelen = msg.msg.msg_namelen;
+                }
+                return rt;
+            }
+            // 被cancelAll取消（句柄关闭），重试得到与epoll后端一致的错误
+            if(rt == -ECANCELED) {
+                goto retry;
+            }
+            // 提交队列已满等情况退回等待就绪
+            if(rt != -EAGAIN) {
+                errno = -rt;
+                return -1;
+            }
+        }
         Sylar::Timer::ptr timer;
         std::weak_ptr<timer_info> winfo(tinfo);
 
         if(to != (uint64_t)-1) {
-            timer = iom->addConditionTimer(to, [winfo, fd, iom, event]() {
+            timer = iom->addConditionTimer(to, Sylar::InlineTask([winfo, fd, iom, event]() {
                 auto t = winfo.lock();
                 if(!t || t->cancelled) {
                     return;
                 }
                 t->cancelled = ETIMEDOUT;
                 iom->cancelEvent(fd, (Sylar::IOManager::Event)(event));
-            }, winfo);
+            }), winfo);
         }
 
         int rt = iom->addEvent(fd, (Sylar::IOManager::Event)(event));
@@ -203,9 +366,9 @@ unsigned int sleep(unsigned int seconds) {
 
     Sylar::Fiber::ptr fiber = Sylar::Fiber::GetThis();
     Sylar::IOManager* iom = Sylar::IOManager::GetThis();
-    iom->addTimer(seconds * 1000, std::bind((void(Sylar::Scheduler::*)
-            (Sylar::Fiber::ptr, int thread))&Sylar::IOManager::schedule
-            ,iom, fiber, -1));
+    iom->addTimer(seconds * 1000, Sylar::InlineTask(std::bind((void(Sylar::Scheduler::*)
+            (Sylar::Fiber::ptr, int thread, Sylar::Scheduler::Priority))&Sylar::IOManager::schedule
+            ,iom, fiber, -1, Sylar::Scheduler::PRIORITY_DEFAULT)));
     Sylar::Fiber::YieldToHold();
     return 0;
 }
@@ -216,9 +379,9 @@ int usleep(useconds_t usec) {
     }
     Sylar::Fiber::ptr fiber = Sylar::Fiber::GetThis();
     Sylar::IOManager* iom = Sylar::IOManager::GetThis();
-    iom->addTimer(usec / 1000, std::bind((void(Sylar::Scheduler::*)
-            (Sylar::Fiber::ptr, int thread))&Sylar::IOManager::schedule
-            ,iom, fiber, -1));
+    iom->addTimer(usec / 1000, Sylar::InlineTask(std::bind((void(Sylar::Scheduler::*)
+            (Sylar::Fiber::ptr, int thread, Sylar::Scheduler::Priority))&Sylar::IOManager::schedule
+            ,iom, fiber, -1, Sylar::Scheduler::PRIORITY_DEFAULT)));
     Sylar::Fiber::YieldToHold();
     return 0;
 }
@@ -231,9 +394,9 @@ int nanosleep(const struct timespec *req, struct timespec *rem) {
     int timeout_ms = req->tv_sec * 1000 + req->tv_nsec / 1000 /1000;
     Sylar::Fiber::ptr fiber = Sylar::Fiber::GetThis();
     Sylar::IOManager* iom = Sylar::IOManager::GetThis();
-    iom->addTimer(timeout_ms, std::bind((void(Sylar::Scheduler::*)
-            (Sylar::Fiber::ptr, int thread))&Sylar::IOManager::schedule
-            ,iom, fiber, -1));
+    iom->addTimer(timeout_ms, Sylar::InlineTask(std::bind((void(Sylar::Scheduler::*)
+            (Sylar::Fiber::ptr, int thread, Sylar::Scheduler::Priority))&Sylar::IOManager::schedule
+            ,iom, fiber, -1, Sylar::Scheduler::PRIORITY_DEFAULT)));
     Sylar::Fiber::YieldToHold();
     return 0;
 }
@@ -250,11 +413,28 @@ int socket(int domain, int type, int protocol) {
     return fd;
 }
 
+/**
+ * @brief 非阻塞connect可写后取出连接结果
+ */
+static int connect_result(int fd) {
+    int error = 0;
+    socklen_t len = sizeof(int);
+    if(-1 == getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len)) {
+        return -1;
+    }
+    if(!error) {
+        return 0;
+    } else {
+        errno = error;
+        return -1;
+    }
+}
+
 int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen, uint64_t timeout_ms) {
     if(!Sylar::t_hook_enable) {
         return connect_f(fd, addr, addrlen);
     }
-    Sylar::FdCtx::ptr ctx = Sylar::FdMgr::GetInstance()->get(fd);
+    Sylar::FdCtx* ctx = Sylar::FdMgr::GetInstance()->get(fd);
     if(!ctx || ctx->isClose()) {
         errno = EBADF;
         return -1;
@@ -276,19 +456,34 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
     }
 
     Sylar::IOManager* iom = Sylar::IOManager::GetThis();
+    if(iom->isIoUring() && !Sylar::Fiber::GetThis()->isSharedStack()) {
+        io_uring_sqe sqe;
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_POLL_ADD;
+        sqe.fd = fd;
+        sqe.poll32_events = POLLOUT;
+        int rt = iom->submitIo(sqe, timeout_ms);
+        if(rt < 0 && rt != -EAGAIN) {
+            errno = -rt;
+            return -1;
+        }
+        if(rt >= 0) {
+            return connect_result(fd);
+        }
+    }
     Sylar::Timer::ptr timer;
     std::shared_ptr<timer_info> tinfo(new timer_info);
     std::weak_ptr<timer_info> winfo(tinfo);
 
     if(timeout_ms != (uint64_t)-1) {
-        timer = iom->addConditionTimer(timeout_ms, [winfo, fd, iom]() {
+        timer = iom->addConditionTimer(timeout_ms, Sylar::InlineTask([winfo, fd, iom]() {
                 auto t = winfo.lock();
                 if(!t || t->cancelled) {
                     return;
                 }
                 t->cancelled = ETIMEDOUT;
                 iom->cancelEvent(fd, Sylar::IOManager::WRITE);
-        }, winfo);
+        }), winfo);
     }
 
     int rt = iom->addEvent(fd, Sylar::IOManager::WRITE);
@@ -307,18 +502,7 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
         }
         SYLAR_LOG_ERROR(g_logger) << "connect addEvent(" << fd << ", WRITE) error";
     }
-
-    int error = 0;
-    socklen_t len = sizeof(int);
-    if(-1 == getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len)) {
-        return -1;
-    }
-    if(!error) {
-        return 0;
-    } else {
-        errno = error;
-        return -1;
-    }
+    return connect_result(fd);
 }
 
 int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
@@ -326,7 +510,7 @@ int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
 }
 
 int accept(int s, struct sockaddr *addr, socklen_t *addrlen) {
-    int fd = do_io(s, accept_f, "accept", Sylar::IOManager::READ, SO_RCVTIMEO, addr, addrlen);
+    int fd = do_io(s, accept_f, "accept", Sylar::IOManager::READ, SO_RCVTIMEO, prep_accept, addr, addrlen);
     if(fd >= 0) {
         Sylar::FdMgr::GetInstance()->get(fd, true);
     }
@@ -334,56 +518,53 @@ int accept(int s, struct sockaddr *addr, socklen_t *addrlen) {
 }
 
 ssize_t read(int fd, void *buf, size_t count) {
-    return do_io(fd, read_f, "read", Sylar::IOManager::READ, SO_RCVTIMEO, buf, count);
+    return do_io(fd, read_f, "read", Sylar::IOManager::READ, SO_RCVTIMEO, prep_read, buf, count);
 }
 
 ssize_t readv(int fd, const struct iovec *iov, int iovcnt) {
-    return do_io(fd, readv_f, "readv", Sylar::IOManager::READ, SO_RCVTIMEO, iov, iovcnt);
+    return do_io(fd, readv_f, "readv", Sylar::IOManager::READ, SO_RCVTIMEO, prep_readv, iov, iovcnt);
 }
 
 ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
-    return do_io(sockfd, recv_f, "recv", Sylar::IOManager::READ, SO_RCVTIMEO, buf, len, flags);
+    return do_io(sockfd, recv_f, "recv", Sylar::IOManager::READ, SO_RCVTIMEO, prep_recv, buf, len, flags);
 }
 
 ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen) {
-    return do_io(sockfd, recvfrom_f, "recvfrom", Sylar::IOManager::READ, SO_RCVTIMEO, buf, len, flags, src_addr, addrlen);
+    return do_io(sockfd, recvfrom_f, "recvfrom", Sylar::IOManager::READ, SO_RCVTIMEO, prep_recvfrom, buf, len, flags, src_addr, addrlen);
 }
 
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
-    return do_io(sockfd, recvmsg_f, "recvmsg", Sylar::IOManager::READ, SO_RCVTIMEO, msg, flags);
+    return do_io(sockfd, recvmsg_f, "recvmsg", Sylar::IOManager::READ, SO_RCVTIMEO, prep_recvmsg, msg, flags);
 }
 
 ssize_t write(int fd, const void *buf, size_t count) {
-    return do_io(fd, write_f, "write", Sylar::IOManager::WRITE, SO_SNDTIMEO, buf, count);
+    return do_io(fd, write_f, "write", Sylar::IOManager::WRITE, SO_SNDTIMEO, prep_write, buf, count);
 }
 
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
-    return do_io(fd, writev_f, "writev", Sylar::IOManager::WRITE, SO_SNDTIMEO, iov, iovcnt);
+    return do_io(fd, writev_f, "writev", Sylar::IOManager::WRITE, SO_SNDTIMEO, prep_writev, iov, iovcnt);
 }
 
 ssize_t send(int s, const void *msg, size_t len, int flags) {
-    return do_io(s, send_f, "send", Sylar::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags);
+    return do_io(s, send_f, "send", Sylar::IOManager::WRITE, SO_SNDTIMEO, prep_send, msg, len, flags);
 }
 
 ssize_t sendto(int s, const void *msg, size_t len, int flags, const struct sockaddr *to, socklen_t tolen) {
-    return do_io(s, sendto_f, "sendto", Sylar::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags, to, tolen);
+    return do_io(s, sendto_f, "sendto", Sylar::IOManager::WRITE, SO_SNDTIMEO, prep_sendto, msg, len, flags, to, tolen);
 }
 
 ssize_t sendmsg(int s, const struct msghdr *msg, int flags) {
-    return do_io(s, sendmsg_f, "sendmsg", Sylar::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
+    return do_io(s, sendmsg_f, "sendmsg", Sylar::IOManager::WRITE, SO_SNDTIMEO, prep_sendmsg, msg, flags);
 }
 
 int close(int fd) {
-    if(!Sylar::t_hook_enable) {
-        return close_f(fd);
-    }
-
-    Sylar::FdCtx::ptr ctx = Sylar::FdMgr::GetInstance()->get(fd);
+    Sylar::FdCtx* ctx = Sylar::FdMgr::GetInstance()->get(fd);
     if(ctx) {
-        auto iom = Sylar::IOManager::GetThis();
+        auto iom = Sylar::t_hook_enable ? Sylar::IOManager::GetThis() : nullptr;
         if(iom) {
             iom->cancelAll(fd);
         }
+        // 未开启hook时也删除，编号复用后新句柄的FdCtx代数不同，IOManager据此丢弃旧的注册状态
         Sylar::FdMgr::GetInstance()->del(fd);
     }
     return close_f(fd);
@@ -412,7 +593,7 @@ int fcntl(int fd, int cmd, ... /* arg */ ) {
             {
                 int arg = va_arg(va, int);
                 va_end(va);
-                Sylar::FdCtx::ptr ctx = Sylar::FdMgr::GetInstance()->get(fd);
+                Sylar::FdCtx* ctx = Sylar::FdMgr::GetInstance()->get(fd);
                 if(!ctx || ctx->isClose() || !ctx->isSocket()) {
                     return fcntl_f(fd, cmd, arg);
                 }
@@ -431,7 +612,7 @@ int fcntl(int fd, int cmd, ... /* arg */ ) {
             {
                 va_end(va);
                 int arg = fcntl_f(fd, cmd);
-                Sylar::FdCtx::ptr ctx = Sylar::FdMgr::GetInstance()->get(fd);
+                Sylar::FdCtx* ctx = Sylar::FdMgr::GetInstance()->get(fd);
                 if(!ctx || ctx->isClose() || !ctx->isSocket()) {
                     return arg;
                 }
@@ -501,7 +682,7 @@ int ioctl(int d, unsigned long int request, ...) {
 
     if(FIONBIO == request) {
         bool user_nonblock = !!*(int*)arg;
-        Sylar::FdCtx::ptr ctx = Sylar::FdMgr::GetInstance()->get(d);
+        Sylar::FdCtx* ctx = Sylar::FdMgr::GetInstance()->get(d);
         if(!ctx || ctx->isClose() || !ctx->isSocket()) {
             return ioctl_f(d, request, arg);
         }
@@ -520,7 +701,7 @@ int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t
     }
     if(level == SOL_SOCKET) {
         if(optname == SO_RCVTIMEO || optname == SO_SNDTIMEO) {
-            Sylar::FdCtx::ptr ctx = Sylar::FdMgr::GetInstance()->get(sockfd);
+            Sylar::FdCtx* ctx = Sylar::FdMgr::GetInstance()->get(sockfd);
             if(ctx) {
                 const timeval* v = (const timeval*)optval;
                 ctx->setTimeout(optname, v->tv_sec * 1000 + v->tv_usec / 1000);
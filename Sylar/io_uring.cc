@@ -0,0 +1,285 @@
+#include "io_uring.h"
+#include "log.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace Sylar {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static int SysSetup(uint32_t entries, io_uring_params* p) {
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int SysEnter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int SysRegister(int fd, uint32_t op, const void* arg, uint32_t nr_args) {
+    return syscall(__NR_io_uring_register, fd, op, arg, nr_args);
+}
+
+IoUring::IoUring() {
+}
+
+IoUring::~IoUring() {
+    if(m_sqes) {
+        munmap(m_sqes, m_sqesSize);
+    }
+    if(m_cqRing && m_cqRing != m_sqRing) {
+        munmap(m_cqRing, m_cqRingSize);
+    }
+    if(m_sqRing) {
+        munmap(m_sqRing, m_sqRingSize);
+    }
+    if(m_fd >= 0) {
+        close(m_fd);
+    }
+    free(m_buffers);
+}
+
+bool IoUring::init(uint32_t entries) {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    m_fd = SysSetup(entries, &p);
+    if(m_fd < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring_setup(" << entries << ") errno="
+            << errno << " " << strerror(errno);
+        return false;
+    }
+
+    m_sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if(single_mmap) {
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    }
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE
+                    ,MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+    if(m_sqRing == MAP_FAILED) {
+        m_sqRing = nullptr;
+        SYLAR_LOG_ERROR(g_logger) << "io_uring mmap sq ring errno=" << errno;
+        return false;
+    }
+    if(single_mmap) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE
+                        ,MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        if(m_cqRing == MAP_FAILED) {
+            m_cqRing = nullptr;
+            SYLAR_LOG_ERROR(g_logger) << "io_uring mmap cq ring errno=" << errno;
+            return false;
+        }
+    }
+    m_sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE
+                      ,MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring mmap sqes errno=" << errno;
+        return false;
+    }
+    m_sqes = (io_uring_sqe*)sqes;
+
+    char* sq = (char*)m_sqRing;
+    m_sqHead = (unsigned*)(sq + p.sq_off.head);
+    m_sqTail = (unsigned*)(sq + p.sq_off.tail);
+    m_sqMask = (unsigned*)(sq + p.sq_off.ring_mask);
+    m_sqEntries = (unsigned*)(sq + p.sq_off.ring_entries);
+    m_sqFlags = (unsigned*)(sq + p.sq_off.flags);
+    m_sqArray = (unsigned*)(sq + p.sq_off.array);
+
+    char* cq = (char*)m_cqRing;
+    m_cqHead = (unsigned*)(cq + p.cq_off.head);
+    m_cqTail = (unsigned*)(cq + p.cq_off.tail);
+    m_cqMask = (unsigned*)(cq + p.cq_off.ring_mask);
+    m_cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+    return probe();
+}
+
+bool IoUring::probe() {
+    static const uint8_t s_ops[] = {
+        IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READV, IORING_OP_WRITEV,
+        IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED, IORING_OP_RECV, IORING_OP_SEND,
+        IORING_OP_RECVMSG, IORING_OP_SENDMSG, IORING_OP_ACCEPT, IORING_OP_POLL_ADD,
+        IORING_OP_LINK_TIMEOUT, IORING_OP_ASYNC_CANCEL
+    };
+    size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<char> buf(size, 0);
+    io_uring_probe* probe = (io_uring_probe*)&buf[0];
+    if(SysRegister(m_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring register probe errno="
+            << errno << " " << strerror(errno);
+        return false;
+    }
+    for(auto op : s_ops) {
+        if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            SYLAR_LOG_ERROR(g_logger) << "io_uring opcode " << (int)op << " not supported";
+            return false;
+        }
+    }
+
+    //旧内核拒绝非零的cancel_flags,用一次空的按句柄取消确认
+    io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.fd = m_fd;
+    sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    if(!push(&sqe, 1)) {
+        return false;
+    }
+    int rt = 0;
+    do {
+        rt = SysEnter(m_fd, 1, 1, IORING_ENTER_GETEVENTS);
+    } while(rt < 0 && errno == EINTR);
+    if(rt < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring_enter probe errno=" << errno << " " << strerror(errno);
+        return false;
+    }
+    m_pending -= rt;
+    io_uring_cqe cqe;
+    if(reap(&cqe, 1) != 1 || cqe.res == -EINVAL) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring cancel by fd not supported";
+        return false;
+    }
+    return true;
+}
+
+bool IoUring::push(const io_uring_sqe* sqes, uint32_t count, uint32_t* pending) {
+    MutexType::Lock lock(m_sqMutex);
+    unsigned tail = *m_sqTail;
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if(*m_sqEntries - (tail - head) < count) {
+        //没有足够的空位时先提交,内核处理后释放空位
+        if(submitNoLock() < 0) {
+            return false;
+        }
+        head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        if(*m_sqEntries - (tail - head) < count) {
+            return false;
+        }
+    }
+    for(uint32_t i = 0; i < count; ++i) {
+        unsigned index = (tail + i) & *m_sqMask;
+        m_sqes[index] = sqes[i];
+        m_sqArray[index] = index;
+    }
+    __atomic_store_n(m_sqTail, tail + count, __ATOMIC_RELEASE);
+    m_pending += count;
+    if(pending) {
+        *pending = m_pending;
+    }
+    return true;
+}
+
+int IoUring::submitNoLock() {
+    uint32_t to_submit = m_pending;
+    if(!to_submit) {
+        return 0;
+    }
+    int rt = 0;
+    do {
+        rt = SysEnter(m_fd, to_submit, 0, 0);
+    } while(rt < 0 && errno == EINTR);
+    if(rt < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring_enter submit=" << to_submit
+            << " errno=" << errno << " " << strerror(errno);
+        return -errno;
+    }
+    m_pending -= rt;
+    return rt;
+}
+
+int IoUring::submit() {
+    MutexType::Lock lock(m_sqMutex);
+    return submitNoLock();
+}
+
+size_t IoUring::reap(io_uring_cqe* cqes, size_t max) {
+    MutexType::Lock lock(m_cqMutex);
+    //完成队列溢出的事件暂存在内核中,需要进入内核才会刷回完成队列
+    if(__atomic_load_n(m_sqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) {
+        SysEnter(m_fd, 0, 0, IORING_ENTER_GETEVENTS);
+    }
+    unsigned head = *m_cqHead;
+    unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    size_t n = 0;
+    while(head != tail && n < max) {
+        cqes[n++] = m_cqes[head & *m_cqMask];
+        ++head;
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+bool IoUring::registerFiles(uint32_t count) {
+    std::vector<int> fds(count, -1);
+    if(SysRegister(m_fd, IORING_REGISTER_FILES, &fds[0], count) < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring register files count=" << count
+            << " errno=" << errno << " " << strerror(errno);
+        return false;
+    }
+    m_fileCount = count;
+    return true;
+}
+
+bool IoUring::updateFile(int fd, bool add) {
+    if(fd < 0 || (uint32_t)fd >= m_fileCount) {
+        return false;
+    }
+    int value = add ? fd : -1;
+    io_uring_files_update up;
+    memset(&up, 0, sizeof(up));
+    up.offset = fd;
+    up.fds = (uint64_t)(uintptr_t)&value;
+    return SysRegister(m_fd, IORING_REGISTER_FILES_UPDATE, &up, 1) == 1;
+}
+
+bool IoUring::registerBuffers(uint32_t count, uint32_t size) {
+    if(posix_memalign((void**)&m_buffers, 4096, (size_t)count * size)) {
+        m_buffers = nullptr;
+        return false;
+    }
+    std::vector<iovec> iovs(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        iovs[i].iov_base = m_buffers + (size_t)i * size;
+        iovs[i].iov_len = size;
+    }
+    if(SysRegister(m_fd, IORING_REGISTER_BUFFERS, &iovs[0], count) < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring register buffers count=" << count
+            << " size=" << size << " errno=" << errno << " " << strerror(errno);
+        free(m_buffers);
+        m_buffers = nullptr;
+        return false;
+    }
+    m_bufferSize = size;
+    m_bufferCount = count;
+    m_freeBuffers.reserve(count);
+    for(uint32_t i = count; i > 0; --i) {
+        m_freeBuffers.push_back(i - 1);
+    }
+    return true;
+}
+
+int IoUring::getBuffer(char*& buf) {
+    MutexType::Lock lock(m_bufferMutex);
+    if(m_freeBuffers.empty()) {
+        return -1;
+    }
+    int index = m_freeBuffers.back();
+    m_freeBuffers.pop_back();
+    buf = m_buffers + (size_t)index * m_bufferSize;
+    return index;
+}
+
+void IoUring::putBuffer(int index) {
+    MutexType::Lock lock(m_bufferMutex);
+    m_freeBuffers.push_back(index);
+}
+
+}
@@ -0,0 +1,171 @@
+/**
+ * @file io_uring.h
+ * @brief io_uring 提交/完成队列封装
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_IO_URING_H__
+#define __SYLAR_IO_URING_H__
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "mutex.h"
+#include "noncopyable.h"
+
+namespace Sylar {
+
+/**
+ * @brief io_uring 实例
+ * @details 直接使用io_uring_setup/io_uring_enter/io_uring_register系统调用,不依赖liburing。
+ *          可被多个线程共享:放入和提交sqe由提交锁保护,取出cqe由完成锁保护。
+ *          可选注册稀疏的固定文件表(下标即fd)和一组固定大小的注册缓冲区
+ */
+class IoUring : Noncopyable {
+public:
+    typedef Spinlock MutexType;
+
+    IoUring();
+    ~IoUring();
+
+    /**
+     * @brief 创建io_uring实例并映射队列
+     * @param[in] entries 提交队列长度,内核向上取整为2的幂
+     * @return 内核不支持、缺少用到的操作码或按句柄批量取消(5.19)时返回false
+     */
+    bool init(uint32_t entries);
+
+    /**
+     * @brief 返回io_uring句柄,有完成事件时可读,可加入epoll
+     */
+    int getFd() const { return m_fd;}
+
+    /**
+     * @brief 把sqe放入提交队列,不进入内核
+     * @details 多个sqe(如带IOSQE_IO_LINK的链)整体放入;队列空间不足时先提交已有的sqe
+     * @param[in] sqes sqe数组
+     * @param[in] count 数量
+     * @param[out] pending 放入后尚未提交的数量
+     * @return 提交失败导致放不下时返回false
+     */
+    bool push(const io_uring_sqe* sqes, uint32_t count, uint32_t* pending = nullptr);
+
+    /**
+     * @brief 提交队列中所有尚未提交的sqe,一次系统调用
+     * @return 提交的数量,失败返回-errno
+     */
+    int submit();
+
+    /**
+     * @brief 尚未提交的sqe数量(无锁读取)
+     */
+    uint32_t getPending() const { return m_pending;}
+
+    /**
+     * @brief 取出完成事件
+     * @param[out] cqes 保存完成事件
+     * @param[in] max 最多取出的数量
+     * @return 取出的数量
+     */
+    size_t reap(io_uring_cqe* cqes, size_t max);
+
+    /**
+     * @brief 注册稀疏的固定文件表
+     * @param[in] count 表的大小,fd小于count的句柄可以注册
+     */
+    bool registerFiles(uint32_t count);
+
+    /**
+     * @brief 设置固定文件表中下标为fd的槽位
+     * @param[in] fd 句柄
+     * @param[in] add true注册,false清除(关闭句柄前必须清除,否则内核仍持有文件引用)
+     */
+    bool updateFile(int fd, bool add);
+
+    /**
+     * @brief 固定文件表的大小,0表示未注册
+     */
+    uint32_t getFileCount() const { return m_fileCount;}
+
+    /**
+     * @brief 分配并注册count个大小为size的缓冲区
+     */
+    bool registerBuffers(uint32_t count, uint32_t size);
+
+    /**
+     * @brief 借出一个注册缓冲区
+     * @param[out] buf 缓冲区地址
+     * @return 缓冲区下标(用于sqe的buf_index),没有空闲缓冲区返回-1
+     */
+    int getBuffer(char*& buf);
+
+    /**
+     * @brief 归还注册缓冲区
+     */
+    void putBuffer(int index);
+
+    /**
+     * @brief 注册缓冲区的大小,0表示未注册
+     */
+    uint32_t getBufferSize() const { return m_bufferSize;}
+private:
+    /**
+     * @brief 检查内核是否支持用到的全部操作码以及按句柄批量取消
+     */
+    bool probe();
+
+    /**
+     * @brief 提交(需持有m_sqMutex)
+     */
+    int submitNoLock();
+private:
+    /// io_uring句柄
+    int m_fd = -1;
+    /// 提交队列映射
+    void* m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    /// 完成队列映射(单次映射时与提交队列相同)
+    void* m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    /// sqe数组映射
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqMask = nullptr;
+    unsigned* m_sqEntries = nullptr;
+    unsigned* m_sqFlags = nullptr;
+    unsigned* m_sqArray = nullptr;
+
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned* m_cqMask = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+
+    /// 提交锁
+    MutexType m_sqMutex;
+    /// 完成锁
+    MutexType m_cqMutex;
+    /// 已放入尚未提交的数量
+    std::atomic<uint32_t> m_pending = {0};
+
+    /// 固定文件表大小
+    uint32_t m_fileCount = 0;
+
+    /// 注册缓冲区
+    char* m_buffers = nullptr;
+    uint32_t m_bufferSize = 0;
+    uint32_t m_bufferCount = 0;
+    /// 空闲缓冲区下标
+    std::vector<int> m_freeBuffers;
+    MutexType m_bufferMutex;
+};
+
+}
+
+#endif
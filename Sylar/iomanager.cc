@@ -1,15 +1,61 @@
 #include"iomanager.h"
 #include"macro.h"
 #include"log.h"
+#include"config.h"
+#include"io_uring.h"
+#include"fd_manager.h"
 
+#include<algorithm>
 #include<errno.h>
 #include<fcntl.h>
+#include<signal.h>
 #include<sys/epoll.h>
+#include<sys/eventfd.h>
+#include<sys/socket.h>
 #include<unistd.h>
 
 namespace Sylar{
     
     static Sylar::Logger::ptr g_logger=SYLAR_LOG_NAME("system");
+
+    static Sylar::ConfigVar<bool>::ptr g_iomanager_multi_reactor=
+        Sylar::Config::Lookup("iomanager.multi_reactor",false,"one epoll per worker thread with connection affinity");
+
+    static Sylar::ConfigVar<std::string>::ptr g_iomanager_reactor_assign=
+        Sylar::Config::Lookup<std::string>("iomanager.reactor_assign","round_robin","fd assignment in multi reactor mode, round_robin or least_loaded");
+
+    static Sylar::ConfigVar<bool>::ptr g_iomanager_persistent_events=
+        Sylar::Config::Lookup("iomanager.persistent_events",false,"keep fds registered for EPOLLIN|EPOLLOUT|EPOLLET and track readiness in user space");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_iomanager_busy_poll_us=
+        Sylar::Config::Lookup<uint32_t>("iomanager.busy_poll_us",0,"max busy polling time before an idle thread sleeps, 0 disables");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_iomanager_so_busy_poll_us=
+        Sylar::Config::Lookup<uint32_t>("iomanager.so_busy_poll_us",0,"SO_BUSY_POLL set on sockets when they are first waited on, 0 disables");
+
+    static Sylar::ConfigVar<bool>::ptr g_iomanager_thread_timers=
+        Sylar::Config::Lookup("iomanager.thread_timers",false,"one timer wheel per worker thread, timers from other threads go through its inbox");
+
+    static Sylar::ConfigVar<std::string>::ptr g_iomanager_backend=
+        Sylar::Config::Lookup<std::string>("iomanager.backend","epoll","io backend, epoll or io_uring");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_io_uring_entries=
+        Sylar::Config::Lookup<uint32_t>("iomanager.io_uring.entries",4096,"io_uring submission queue entries");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_io_uring_submit_batch=
+        Sylar::Config::Lookup<uint32_t>("iomanager.io_uring.submit_batch",32,"submit at once when this many sqes are pending");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_io_uring_fixed_files=
+        Sylar::Config::Lookup<uint32_t>("iomanager.io_uring.fixed_files",0,"registered file table size, 0 disables");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_io_uring_buffer_count=
+        Sylar::Config::Lookup<uint32_t>("iomanager.io_uring.buffer_count",0,"registered buffer count, 0 disables");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_io_uring_buffer_size=
+        Sylar::Config::Lookup<uint32_t>("iomanager.io_uring.buffer_size",16384,"registered buffer size");
+
+    //链接的超时sqe的user_data为操作地址最低位置1
+    static const uint64_t s_uring_timeout_tag=1;
     
     enum EpollCtlOp{
 
@@ -79,68 +125,218 @@ namespace Sylar{
         ctx.cb=nullptr;
     }
 
-    IOManager::IOManager(size_t threads,bool use_caller,const std::string&name)
-       :Scheduler(threads,use_caller,name){
-        m_epfd=epoll_create(5000);
-        SYLAR_ASSERT(m_epfd>0);
+    static void OnTickleSignal(int) {
+    }
 
-        int rt=pipe(m_tickleFds);
-        SYLAR_ASSERT(!rt);
+    /**
+     * @brief SIGURG的处理函数是否仍是IOManager安装的
+     * @details 程序在IOManager创建之后可能自己接管SIGURG(如处理带外数据),
+     *          此时不再发送信号,以免触发程序的处理函数或因信号被忽略而唤醒不了目标线程
+     */
+    static bool IsTickleSignalOwned() {
+        struct sigaction sa;
+        if(sigaction(SIGURG, nullptr, &sa)) {
+            return false;
+        }
+        return !(sa.sa_flags & SA_SIGINFO) && sa.sa_handler == OnTickleSignal;
+    }
 
+    struct TickleSignalIniter {
+        TickleSignalIniter() {
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = OnTickleSignal;
+            sigemptyset(&sa.sa_mask);
+            //不设置SA_RESTART,保证epoll_pwait被打断后返回EINTR
+            sigaction(SIGURG, &sa, nullptr);
+        }
+    };
+
+    IOManager::IOManager(size_t threads,bool use_caller,const std::string&name
+                         ,const CpuAffinity&affinity,const ElasticConfig&elastic)
+       :Scheduler(threads,use_caller,name,affinity,elastic){
+        m_multiReactor=g_iomanager_multi_reactor->getValue();
+        if(!m_multiReactor){
+            //第一个共享epoll模式的IOManager创建时才接管SIGURG,用于定向唤醒;
+            //不使用IOManager或只用多reactor模式的程序可以自行处理带外数据
+            static TickleSignalIniter s_tickle_signal_initer;
+        }
+        m_leastLoaded=g_iomanager_reactor_assign->getValue()=="least_loaded";
+        m_persistent=g_iomanager_persistent_events->getValue();
+        m_busyPollUs=g_iomanager_busy_poll_us->getValue();
+        m_soBusyPollUs=g_iomanager_so_busy_poll_us->getValue();
+        size_t reactors=m_multiReactor?getThreadContexts().size():1;
         epoll_event event;
         memset(&event,0,sizeof(epoll_event));
-        event.events=EPOLLIN|EPOLLET;
-        event.data.fd=m_tickleFds[0];
+        int rt=0;
+        for(size_t i=0;i<reactors;++i){
+            Reactor*reactor=new Reactor;
+            reactor->epfd=epoll_create(5000);
+            SYLAR_ASSERT(reactor->epfd>0);
 
-        rt=fcntl(m_tickleFds[0],F_SETFL,O_NONBLOCK);
-        SYLAR_ASSERT(!rt);
+            reactor->tickleFd=eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+            SYLAR_ASSERT(reactor->tickleFd>=0);
+
+            //边缘触发:每次写入只产生一次就绪通知,只有一个等待的线程被唤醒
+            event.events=EPOLLIN|EPOLLET;
+            event.data.fd=reactor->tickleFd;
+
+            rt=epoll_ctl(reactor->epfd,EPOLL_CTL_ADD,reactor->tickleFd,&event);
+            SYLAR_ASSERT(!rt);
+            m_reactors.push_back(reactor);
+        }
 
-        rt=epoll_ctl(m_epfd,EPOLL_CTL_ADD,m_tickleFds[0],&event);
-        SYLAR_ASSERT(!rt);
+        if(g_iomanager_backend->getValue()=="io_uring"){
+            m_uring=new IoUring;
+            if(!m_uring->init(g_io_uring_entries->getValue())){
+                SYLAR_LOG_WARN(g_logger)<<"name="<<name<<" io_uring unavailable, fallback to epoll";
+                delete m_uring;
+                m_uring=nullptr;
+            }
+        }
+        if(m_uring){
+            m_uringBatch=std::max(g_io_uring_submit_batch->getValue(),1u);
+            uint32_t files=g_io_uring_fixed_files->getValue();
+            if(files&&!m_uring->registerFiles(files)){
+                SYLAR_LOG_WARN(g_logger)<<"name="<<name<<" io_uring fixed files disabled";
+            }
+            uint32_t buffers=g_io_uring_buffer_count->getValue();
+            if(buffers&&!m_uring->registerBuffers(buffers,g_io_uring_buffer_size->getValue())){
+                SYLAR_LOG_WARN(g_logger)<<"name="<<name<<" io_uring registered buffers disabled";
+            }
+            //完成队列有事件时io_uring句柄可读,空闲线程在epoll中统一等待
+            //(多reactor模式下加入每个epoll,由先醒来的线程取出完成事件)
+            m_uringFd=m_uring->getFd();
+            for(auto i:m_reactors){
+                event.events=EPOLLIN|EPOLLET;
+                event.data.fd=m_uringFd;
+                rt=epoll_ctl(i->epfd,EPOLL_CTL_ADD,m_uringFd,&event);
+                SYLAR_ASSERT(!rt);
+            }
+        }
 
-        contextResize(32);
+        if(g_iomanager_thread_timers->getValue()){
+            //弹性线程随时可能退出,不分配时间轮(它们的上下文排在常驻线程之后);
+            //调用线程在stop()之前不进入调度循环,其他线程加入的定时器只投递给常驻的工作线程
+            const std::vector<ThreadContext*>&ctxs=getThreadContexts();
+            size_t wheels=0;
+            std::vector<size_t>targets;
+            for(auto ctx:ctxs){
+                if(ctx->elastic){
+                    continue;
+                }
+                ++wheels;
+                if(!(m_rootThread!=-1&&ctx->index==0)){
+                    targets.push_back(ctx->index);
+                }
+            }
+            if(targets.empty()){
+                targets.push_back(0);
+            }
+            initTimerWheels(wheels,targets);
+        }
 
         start();
     }
 
     IOManager::~IOManager(){
         stop();
-        close(m_epfd);
-        close(m_tickleFds[0]);
-        close(m_tickleFds[1]);
+        for(auto i:m_reactors){
+            close(i->epfd);
+            close(i->tickleFd);
+            delete i;
+        }
+        delete m_uring;
+    }
+
+    IOManager::Reactor*IOManager::getReactor(FdContext*fd_ctx){
+        return m_multiReactor?m_reactors[fd_ctx->reactor]:m_reactors[0];
+    }
 
-        for(size_t i=0;i<m_fdContexts.size();++i){
-            if(m_fdContexts[i]){
-                delete m_fdContexts[i];
+    void IOManager::assignReactor(FdContext*fd_ctx){
+        if(!m_multiReactor||fd_ctx->reactor>=0){
+            return;
+        }
+        //use_caller的调用线程只在stop时进入调度,弹性线程会退出,句柄只分配给常驻的工作线程
+        const std::vector<ThreadContext*>&ctxs=getThreadContexts();
+        size_t base=(m_rootThread!=-1&&m_threadCount>0)?1:0;
+        size_t count=std::max(m_threadCount,(size_t)1);
+        size_t index=base;
+        if(m_leastLoaded){
+            for(size_t i=base+1;i<base+count;++i){
+                if(m_reactors[i]->fdCount<m_reactors[index]->fdCount){
+                    index=i;
+                }
             }
+        }else{
+            index=base+m_nextReactor.fetch_add(1,std::memory_order_relaxed)%count;
         }
+        SYLAR_ASSERT(index<ctxs.size());
+        fd_ctx->reactor=index;
+        ++m_reactors[index]->fdCount;
     }
 
-    void IOManager::contextResize(size_t size){
-        m_fdContexts.resize(size);
+    void IOManager::releaseReactor(FdContext*fd_ctx){
+        //句柄关闭后编号会被复用,解除与线程的绑定
+        if(m_multiReactor&&fd_ctx->reactor>=0){
+            --m_reactors[fd_ctx->reactor]->fdCount;
+            fd_ctx->reactor=-1;
+        }
+    }
 
-        for(size_t i=0;i<m_fdContexts.size();++i){
-            if(!m_fdContexts[i]){
-                m_fdContexts[i]=new FdContext;
-                m_fdContexts[i]->fd=i;
-            }
+    int IOManager::getOwnerThread(FdContext*fd_ctx){
+        if(!m_multiReactor||fd_ctx->reactor<0){
+            return -1;
         }
+        return getThreadContexts()[fd_ctx->reactor]->threadId;
+    }
+
+    int IOManager::assignFd(int fd){
+        if(!m_multiReactor){
+            return -1;
+        }
+        FdContext*fd_ctx=getFdContext(fd,true);
+        if(!fd_ctx){
+            return -1;
+        }
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        assignReactor(fd_ctx);
+        return getOwnerThread(fd_ctx);
+    }
+
+    bool IOManager::wakeReactor(Reactor*reactor){
+        if(reactor->tickled.exchange(true)){
+            m_tickleCoalesced.fetch_add(1,std::memory_order_relaxed);
+            return false;
+        }
+        uint64_t one=1;
+        int rt=write(reactor->tickleFd,&one,sizeof(one));
+        SYLAR_ASSERT(rt==sizeof(one));
+        return true;
+    }
+
+    IOManager::FdContext*IOManager::getFdContext(int fd,bool auto_create){
+        if(fd<0){
+            return nullptr;
+        }
+        if(!auto_create){
+            return m_fdContexts.find(fd);
+        }
+        return m_fdContexts.get(fd,[](FdContext&ctx,size_t index){
+            ctx.fd=index;
+        });
     }
 
     int IOManager::addEvent(int fd,Event event,std::function<void()>cb){
-        FdContext*fd_ctx=nullptr;
-        RWMutexType::ReadLock lock(m_mutex);
-        if(static_cast<int>(m_fdContexts.size()>fd)){
-            fd_ctx=m_fdContexts[fd];
-            lock.unlock();
-        }else{
-            lock.unlock();
-            RWMutexType::WriteLock lock2(m_mutex);
-            contextResize(fd*1.5);
-            fd_ctx=m_fdContexts[fd];
+        FdContext*fd_ctx=getFdContext(fd,true);
+        if(SYLAR_UNLIKELY(!fd_ctx)){
+            SYLAR_LOG_ERROR(g_logger)<<"addEvent invalid fd="<<fd;
+            return -1;
         }
 
         FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+        assignReactor(fd_ctx);
+        int epfd=getReactor(fd_ctx)->epfd;
         if(SYLAR_UNLIKELY(fd_ctx->events&event)){
             SYLAR_LOG_ERROR(g_logger)<<"addEvent assert fd="<<fd
             <<" event="<<(EPOLL_EVENTS)event
@@ -148,20 +344,46 @@ namespace Sylar{
             SYLAR_ASSERT(!(fd_ctx->events&event));
         }
 
-        int op=fd_ctx->events?EPOLL_CTL_MOD:EPOLL_CTL_ADD;
-        epoll_event epevent;
-        epevent.events=EPOLLET|fd_ctx->events|event;
-        epevent.data.ptr=fd_ctx;
+        //持久注册模式下只在第一次等待时注册读写两种事件,之后不再修改
+        if(m_persistent){
+            refreshGeneration(fd_ctx);
+        }
+        if(!m_persistent||!fd_ctx->registered){
+            int op=fd_ctx->events?EPOLL_CTL_MOD:EPOLL_CTL_ADD;
+            epoll_event epevent;
+            epevent.events=EPOLLET|fd_ctx->events|event;
+            if(m_persistent){
+                op=EPOLL_CTL_ADD;
+                epevent.events=EPOLLET|EPOLLIN|EPOLLOUT;
+            }
+            epevent.data.ptr=fd_ctx;
 
-        int rt=epoll_ctl(m_epfd,op,fd,&epevent);
-        if(rt) {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
-            << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
-            << rt << " (" << errno << ") (" << strerror(errno) << ") fd_ctx->events="
-            << (EPOLL_EVENTS)fd_ctx->events;
-        return -1;
+            int rt=epoll_ctl(epfd,op,fd,&epevent);
+            m_epollCtlCount.fetch_add(1,std::memory_order_relaxed);
+            if(rt) {
+                SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd << ", "
+                    << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
+                    << rt << " (" << errno << ") (" << strerror(errno) << ") fd_ctx->events="
+                    << (EPOLL_EVENTS)fd_ctx->events;
+                return -1;
+            }
+            fd_ctx->registered=m_persistent;
+        }
+        //让内核在读这个socket时直接轮询网卡队列;非socket或权限不足时忽略
+        if(m_soBusyPollUs&&!fd_ctx->busyPoll){
+            fd_ctx->busyPoll=true;
+            int val=m_soBusyPollUs;
+            if(setsockopt(fd,SOL_SOCKET,SO_BUSY_POLL,&val,sizeof(val))&&errno==EPERM){
+                static bool s_warned=false;
+                if(!s_warned){
+                    s_warned=true;
+                    SYLAR_LOG_WARN(g_logger)<<"setsockopt SO_BUSY_POLL="<<val
+                        <<" needs CAP_NET_ADMIN above net.core.busy_read";
+                }
+            }
         }
         ++m_pendingEventCount;
+        ++m_eventSeq;
         fd_ctx->events=(Event)(fd_ctx->events|event);
         FdContext::EventContext&event_ctx=fd_ctx->getContext(event);
         SYLAR_ASSERT(!event_ctx.scheduler
@@ -175,35 +397,44 @@ namespace Sylar{
             SYLAR_ASSERT2(event_ctx.fiber->getState()==Fiber::EXEC
               ,"state="<<event_ctx.fiber->getState());
         }
+        //开始等待之前边沿已经到达(如读到EAGAIN之后数据才到),不会再有通知,直接触发。
+        //就绪位可能已经过时,协程重试得到EAGAIN后会再次等待
+        if(fd_ctx->ready&event){
+            fd_ctx->ready=(Event)(fd_ctx->ready&~event);
+            --m_pendingEventCount;
+            fd_ctx->triggerEvent(event,getOwnerThread(fd_ctx));
+        }
         return 0;
     }
 
     bool IOManager::delEvent(int fd,Event event){
-        RWMutexType::ReadLock lock(m_mutex);
-        if((int)m_fdContexts.size()<=fd){
+        FdContext*fd_ctx=getFdContext(fd,false);
+        if(!fd_ctx){
             return false;
         }
-        FdContext*fd_ctx=m_fdContexts[fd];
-        lock.unlock();
 
         FdContext::MutexType::Lock lock2(fd_ctx->mutex);
         if(SYLAR_UNLIKELY(!(fd_ctx->events&event))){
             return false;
         }
+        int epfd=getReactor(fd_ctx)->epfd;
 
         Event new_events=(Event)(fd_ctx->events&~event);
-        int op=new_events?EPOLL_CTL_MOD:EPOLL_CTL_DEL;
-        epoll_event epevent;
-        epevent.events=EPOLLET|new_events;
-        epevent.data.ptr=fd_ctx;
+        if(!m_persistent){
+            int op=new_events?EPOLL_CTL_MOD:EPOLL_CTL_DEL;
+            epoll_event epevent;
+            epevent.events=EPOLLET|new_events;
+            epevent.data.ptr=fd_ctx;
 
-        int rt=epoll_ctl(m_epfd,op,fd,&epevent);
-        if(rt) {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
-            << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
-            << rt << " (" << errno << ") (" << strerror(errno) << ")";
-        return false;
-    }
+            int rt=epoll_ctl(epfd,op,fd,&epevent);
+            m_epollCtlCount.fetch_add(1,std::memory_order_relaxed);
+            if(rt) {
+                SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd << ", "
+                    << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
+                    << rt << " (" << errno << ") (" << strerror(errno) << ")";
+                return false;
+            }
+        }
 
     --m_pendingEventCount;
     fd_ctx->events = new_events;
@@ -212,7 +443,7 @@ namespace Sylar{
     return true;
     }
 
-    void IOManager::FdContext::triggerEvent(IOManager::Event event) {
+    void IOManager::FdContext::triggerEvent(IOManager::Event event, int thread) {
     //SYLAR_LOG_INFO(g_logger) << "fd=" << fd
     //    << " triggerEvent event=" << event
     //    << " events=" << events;
@@ -223,74 +454,86 @@ namespace Sylar{
     events = (Event)(events & ~event);
     EventContext& ctx = getContext(event);
     if(ctx.cb) {
-        ctx.scheduler->schedule(&ctx.cb);
+        ctx.scheduler->schedule(&ctx.cb, thread);
     } else {
-        ctx.scheduler->schedule(&ctx.fiber);
+        ctx.scheduler->schedule(&ctx.fiber, thread);
     }
     ctx.scheduler = nullptr;
     return;
 }
 
 bool IOManager::cancelEvent(int fd,Event event){
-    RWMutexType::ReadLock lock(m_mutex);
-    if((int)m_fdContexts.size()<=fd){
+    FdContext*fd_ctx=getFdContext(fd,false);
+    if(!fd_ctx){
         return false;
     }
-    FdContext*fd_ctx=m_fdContexts[fd];
-    lock.unlock();
 
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
     if(SYLAR_UNLIKELY(!(fd_ctx->events&event))){
         return false;
     }
+    int epfd=getReactor(fd_ctx)->epfd;
     Event new_events=(Event)(fd_ctx->events&~event);
-    int op=new_events?EPOLL_CTL_MOD:EPOLL_CTL_DEL;
-    epoll_event epevent;
-    epevent.events=EPOLLET|new_events;
-    epevent.data.ptr=fd_ctx;
+    if(!m_persistent){
+        int op=new_events?EPOLL_CTL_MOD:EPOLL_CTL_DEL;
+        epoll_event epevent;
+        epevent.events=EPOLLET|new_events;
+        epevent.data.ptr=fd_ctx;
 
-    int rt=epoll_ctl(m_epfd,op,fd,&epevent);
-    if(rt) {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
-            << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):" 
-            << rt << " (" << errno << ") (" << strerror(errno) << ")";
-        return false;
+        int rt=epoll_ctl(epfd,op,fd,&epevent);
+        m_epollCtlCount.fetch_add(1,std::memory_order_relaxed);
+        if(rt) {
+            SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd << ", "
+                << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):" 
+                << rt << " (" << errno << ") (" << strerror(errno) << ")";
+            return false;
+        }
     }
     --m_pendingEventCount;
-    fd_ctx->triggerEvent(event);
+    fd_ctx->triggerEvent(event,getOwnerThread(fd_ctx));
     fd_ctx->events=new_events;
     return true;
 }
 
 
 bool IOManager::cancelAll(int fd){
-    RWMutexType::ReadLock lock(m_mutex);
-    if((int)m_fdContexts.size()<=fd){
+    FdContext*fd_ctx=getFdContext(fd,false);
+    if(!fd_ctx){
         return false;
     }
-    FdContext*fd_ctx=m_fdContexts[fd];
-    lock.unlock();
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
-    if(!fd_ctx->events){
+    if(m_uring){
+        cancelIo(fd_ctx);
+    }
+    fd_ctx->busyPoll=false;
+    if(!fd_ctx->events&&!fd_ctx->registered){
+        releaseReactor(fd_ctx);
         return false;
     }
+    int epfd=getReactor(fd_ctx)->epfd;
+    int thread=getOwnerThread(fd_ctx);
+    releaseReactor(fd_ctx);
+    //句柄即将关闭,编号复用后要重新注册
+    fd_ctx->registered=false;
+    fd_ctx->ready=NONE;
     int op=EPOLL_CTL_DEL;
     epoll_event epevent;
     epevent.events=0;
     epevent.data.ptr=fd_ctx;
-    int rt=epoll_ctl(m_epfd,op,fd,&epevent);
+    int rt=epoll_ctl(epfd,op,fd,&epevent);
+    m_epollCtlCount.fetch_add(1,std::memory_order_relaxed);
     if(rt) {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
+        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd << ", "
             << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
             << rt << " (" << errno << ") (" << strerror(errno) << ")";
         return false;
     }
     if(fd_ctx->events&READ){
-        fd_ctx->triggerEvent(READ);
+        fd_ctx->triggerEvent(READ,thread);
         --m_pendingEventCount;
     }
     if(fd_ctx->events&WRITE){
-        fd_ctx->triggerEvent(WRITE);
+        fd_ctx->triggerEvent(WRITE,thread);
         --m_pendingEventCount;
     }
     fd_ctx->events=NONE;
@@ -302,28 +545,286 @@ bool IOManager::cancelAll(int fd){
     }
 
     /**
-     * @brief 唤醒调度器中的空闲线程。
-     * 
-     * 该方法会检查是否存在空闲线程，如果存在则向管道的写端写入一个空字符，
-     * 以此来触发管道读端的事件，从而唤醒正在等待事件的线程。
+     * @brief 一次io_uring操作的状态
+     * @details 内核和完成线程会写入这里(结果、超时时间),因此放在堆上而不是发起协程的栈上,
+     *          共享栈协程让出后栈内容会被换出。left是尚未到达的完成事件数,
+     *          发起协程持有一份引用,直到所有完成事件(操作本身和链接的超时)到达才恢复并释放
+     */
+    struct IOManager::IoUringOp{
+        typedef std::shared_ptr<IoUringOp> ptr;
+        Fiber::ptr fiber;
+        FdContext*fdCtx=nullptr;
+        int res=0;
+        int timeoutRes=0;
+        //尚未到达的完成事件数
+        std::atomic<int>left={0};
+        __kernel_timespec ts;
+        //RECVMSG/SENDMSG的msghdr副本,内核执行时才读取,RECVMSG还会回写其中的长度和标志
+        msghdr msg;
+        iovec iov;
+        std::vector<iovec>iovs;
+    };
+
+    int IOManager::submitIo(const io_uring_sqe&sqe,uint64_t timeout_ms){
+        SYLAR_ASSERT(m_uring);
+        int fd=sqe.fd;
+        FdContext*fd_ctx=getFdContext(fd,true);
+        if(SYLAR_UNLIKELY(!fd_ctx)){
+            return -EAGAIN;
+        }
+        IoUringOp::ptr op(new IoUringOp);
+        op->fiber=Fiber::GetThis();
+        op->fdCtx=fd_ctx;
+
+        io_uring_sqe sqes[2];
+        sqes[0]=sqe;
+        sqes[0].user_data=(uint64_t)(uintptr_t)op.get();
+        msghdr*user_msg=nullptr;
+        if(sqe.opcode==IORING_OP_RECVMSG||sqe.opcode==IORING_OP_SENDMSG){
+            user_msg=(msghdr*)(uintptr_t)sqe.addr;
+            op->msg=*user_msg;
+            if(op->msg.msg_iovlen==1){
+                op->iov=op->msg.msg_iov[0];
+                op->msg.msg_iov=&op->iov;
+            }else if(op->msg.msg_iovlen>1){
+                op->iovs.assign(op->msg.msg_iov,op->msg.msg_iov+op->msg.msg_iovlen);
+                op->msg.msg_iov=&op->iovs[0];
+            }
+            sqes[0].addr=(uint64_t)(uintptr_t)&op->msg;
+        }
+        if((uint32_t)fd<m_uring->getFileCount()){
+            //固定文件省去每次操作的fget/fput
+            FdContext::MutexType::Lock lock(fd_ctx->mutex);
+            refreshGeneration(fd_ctx);
+            if(!fd_ctx->fixedFile){
+                fd_ctx->fixedFile=m_uring->updateFile(fd,true);
+            }
+            if(fd_ctx->fixedFile){
+                sqes[0].flags|=IOSQE_FIXED_FILE;
+            }
+        }
+
+        //不超过注册缓冲区大小的读写改用注册缓冲区,省去每次操作的页固定
+        char*buf=nullptr;
+        int buf_index=-1;
+        bool is_read=sqe.opcode==IORING_OP_READ
+                    ||(sqe.opcode==IORING_OP_RECV&&!sqe.msg_flags);
+        bool is_write=sqe.opcode==IORING_OP_WRITE
+                    ||(sqe.opcode==IORING_OP_SEND&&!sqe.msg_flags);
+        if((is_read||is_write)&&sqe.len<=m_uring->getBufferSize()
+                &&(buf_index=m_uring->getBuffer(buf))>=0){
+            if(is_write){
+                memcpy(buf,(const void*)(uintptr_t)sqe.addr,sqe.len);
+            }
+            sqes[0].opcode=is_read?IORING_OP_READ_FIXED:IORING_OP_WRITE_FIXED;
+            sqes[0].addr=(uint64_t)(uintptr_t)buf;
+            sqes[0].off=(uint64_t)-1;
+            sqes[0].rw_flags=0;
+            sqes[0].buf_index=buf_index;
+        }
+
+        uint32_t count=1;
+        if(timeout_ms!=~0ull){
+            op->ts.tv_sec=timeout_ms/1000;
+            op->ts.tv_nsec=(timeout_ms%1000)*1000000;
+            sqes[0].flags|=IOSQE_IO_LINK;
+            memset(&sqes[1],0,sizeof(sqes[1]));
+            sqes[1].opcode=IORING_OP_LINK_TIMEOUT;
+            sqes[1].fd=-1;
+            sqes[1].addr=(uint64_t)(uintptr_t)&op->ts;
+            sqes[1].len=1;
+            sqes[1].user_data=(uint64_t)(uintptr_t)op.get()|s_uring_timeout_tag;
+            count=2;
+        }
+        op->left=count;
+
+        ++m_pendingEventCount;
+        ++m_eventSeq;
+        ++fd_ctx->uringOps;
+        uint32_t pending=0;
+        if(SYLAR_UNLIKELY(!m_uring->push(sqes,count,&pending))){
+            --fd_ctx->uringOps;
+            --m_pendingEventCount;
+            if(buf_index>=0){
+                m_uring->putBuffer(buf_index);
+            }
+            return -EAGAIN;
+        }
+        //有线程阻塞在epoll中时立即提交;否则攒批,由下一个进入idle的线程统一提交
+        if(pending>=m_uringBatch||hasIdleThreads()){
+            m_uring->submit();
+        }
+        Fiber::YieldToHold();
+
+        if(buf_index>=0){
+            if(is_read&&op->res>0){
+                memcpy((void*)(uintptr_t)sqe.addr,buf,op->res);
+            }
+            m_uring->putBuffer(buf_index);
+        }
+        if(sqe.opcode==IORING_OP_RECVMSG&&op->res>=0){
+            user_msg->msg_namelen=op->msg.msg_namelen;
+            user_msg->msg_controllen=op->msg.msg_controllen;
+            user_msg->msg_flags=op->msg.msg_flags;
+        }
+        if(op->res==-ECANCELED&&op->timeoutRes==-ETIME){
+            return -ETIMEDOUT;
+        }
+        return op->res;
+    }
+
+    void IOManager::completeIo(const io_uring_cqe&cqe){
+        //取消请求的user_data为0,结果不需要处理
+        if(!cqe.user_data){
+            return;
+        }
+        IoUringOp*op=(IoUringOp*)(uintptr_t)(cqe.user_data&~s_uring_timeout_tag);
+        if(cqe.user_data&s_uring_timeout_tag){
+            op->timeoutRes=cqe.res;
+        }else{
+            op->res=cqe.res;
+        }
+        if(--op->left){
+            return;
+        }
+        --op->fdCtx->uringOps;
+        Fiber::ptr fiber;
+        fiber.swap(op->fiber);
+        schedule(fiber);
+        --m_pendingEventCount;
+    }
+
+    void IOManager::reapIoUring(){
+        static const size_t MAX_CQES=64;
+        io_uring_cqe cqes[MAX_CQES];
+        size_t n=0;
+        do{
+            n=m_uring->reap(cqes,MAX_CQES);
+            for(size_t i=0;i<n;++i){
+                completeIo(cqes[i]);
+            }
+        }while(n==MAX_CQES);
+    }
+
+    void IOManager::cancelIo(FdContext*fd_ctx){
+        if(fd_ctx->uringOps>0){
+            io_uring_sqe sqes[2];
+            memset(sqes,0,sizeof(sqes));
+            sqes[0].opcode=IORING_OP_ASYNC_CANCEL;
+            sqes[0].fd=fd_ctx->fd;
+            sqes[0].cancel_flags=IORING_ASYNC_CANCEL_FD|IORING_ASYNC_CANCEL_ALL;
+            uint32_t count=1;
+            if(fd_ctx->fixedFile){
+                sqes[1]=sqes[0];
+                sqes[1].cancel_flags|=IORING_ASYNC_CANCEL_FD_FIXED;
+                count=2;
+            }
+            if(m_uring->push(sqes,count)){
+                m_uring->submit();
+            }
+        }
+        //关闭句柄前移出固定文件表,否则内核一直持有文件引用
+        if(fd_ctx->fixedFile){
+            m_uring->updateFile(fd_ctx->fd,false);
+            fd_ctx->fixedFile=false;
+        }
+    }
+
+    void IOManager::refreshGeneration(FdContext*fd_ctx){
+        FdCtx* ctx=FdMgr::GetInstance()->get(fd_ctx->fd);
+        uint64_t generation=ctx?ctx->getGeneration():0;
+        if(generation==fd_ctx->generation){
+            return;
+        }
+        fd_ctx->generation=generation;
+        fd_ctx->registered=false;
+        fd_ctx->ready=NONE;
+        fd_ctx->busyPoll=false;
+        if(fd_ctx->fixedFile){
+            //覆盖槽位,同时释放内核持有的旧文件
+            fd_ctx->fixedFile=m_uring->updateFile(fd_ctx->fd,true);
+        }
+    }
+
+    /**
+     * @brief 唤醒调度器中的一个空闲线程。
+     * @details 向eventfd写入使其就绪,只有一个阻塞在epoll上的线程会收到通知。
+     *          已有未被取走的唤醒时直接返回,被唤醒的线程取到任务后发现还有剩余任务,
+     *          会再次tickle唤醒下一个线程,而不是一次唤醒所有空闲线程。
+     *          多reactor模式下每个线程等待自己的epoll,选一个尚未被唤醒的空闲线程唤醒
      */
     void IOManager::tickle() {
         // 检查是否存在空闲线程，如果没有空闲线程则直接返回，无需进行唤醒操作
         if(!hasIdleThreads()){
             return;
         }
-        // 向管道的写端 m_tickleFds[1] 写入一个空字符，长度为 1 字节
-        // 这会触发管道读端的事件，从而唤醒等待在 epoll 上的线程
-        int rt = write(m_tickleFds[1], "", 1);
-        // 断言写入操作成功，确保写入的字节数为 1
-        SYLAR_ASSERT(rt == 1);
+        if(!m_multiReactor){
+            if(wakeReactor(m_reactors[0])){
+                m_tickleCount.fetch_add(1,std::memory_order_relaxed);
+            }
+            return;
+        }
+        ThreadContext*self=getCurrentContext();
+        for(auto ctx:getThreadContexts()){
+            if(ctx==self||!ctx->idle||ctx->pthread==0){
+                continue;
+            }
+            Reactor*reactor=m_reactors[ctx->index];
+            if(!reactor->tickled.exchange(true)){
+                m_tickleCount.fetch_add(1,std::memory_order_relaxed);
+                uint64_t one=1;
+                int rt=write(reactor->tickleFd,&one,sizeof(one));
+                SYLAR_ASSERT(rt==sizeof(one));
+                return;
+            }
+        }
+        m_tickleCoalesced.fetch_add(1,std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 定向唤醒指定线程
+     * @details 共享的epoll句柄无法指定由哪个线程醒来,这里直接向目标线程
+     *          发送SIGURG信号,打断其epoll_pwait;多reactor模式下写入目标线程自己的eventfd。
+     *          目标线程不在idle中时,它会在下一轮调度中检查自己的信箱,无需唤醒。
+     *          SIGURG已被程序另行接管时退回普通的tickle,目标线程最迟在epoll等待超时后检查信箱
+     */
+    void IOManager::tickleThread(ThreadContext* ctx) {
+        if(!ctx->idle || ctx->pthread == 0) {
+            return;
+        }
+        //目标线程回到调度循环前只需要一个信号
+        if(ctx->woken.exchange(true)) {
+            m_tickleCoalesced.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_tickleTargeted.fetch_add(1, std::memory_order_relaxed);
+        if(m_multiReactor) {
+            wakeReactor(m_reactors[ctx->index]);
+            return;
+        }
+        if(SYLAR_UNLIKELY(!IsTickleSignalOwned())) {
+            wakeReactor(m_reactors[0]);
+            return;
+        }
+        //弹性线程退出时在同一把锁下清除pthread,持锁发送保证目标线程尚未被回收
+        ThreadContext::MutexType::Lock lock(ctx->mutex);
+        if(ctx->pthread) {
+            pthread_kill(ctx->pthread, SIGURG);
+        }
     }
 
     bool IOManager::stopping(uint64_t&timeout){
+        uint64_t seq=m_eventSeq;
         timeout=getNextTimer();
-        return timeout==~0ull
-        &&m_pendingEventCount==0
-        &&Scheduler::stopping();
+        //每线程时间轮中其他线程取消的定时器可能还未摘除,以未取消的定时器数量为准
+        if(hasTimer()||m_pendingEventCount!=0||!Scheduler::stopping()){
+            return false;
+        }
+        //上面几项不是同时读取的,期间其他线程可能运行协程注册了事件或定时器后让出,
+        //队列又变为空。多reactor模式下提前退出的线程上的句柄无人处理,这里再确认一次
+        return !hasTimer()
+            &&m_pendingEventCount==0
+            &&m_eventSeq==seq;
     }
 
     bool IOManager::stopping(){
@@ -333,22 +834,97 @@ bool IOManager::cancelAll(int fd){
 
     void IOManager::idle() {
     SYLAR_LOG_DEBUG(g_logger) << "idle";
+    //共享epoll模式下从检查信箱到epoll_pwait期间屏蔽SIGURG,避免两者之间丢失定向唤醒;
+    //切回调度循环前恢复原来的信号掩码,任务(包括use_caller线程上的)不受影响
+    bool mask_tickle = !m_multiReactor;
+    sigset_t block_mask;
+    sigset_t old_mask;
+    sigset_t wait_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGURG);
     const uint64_t MAX_EVNETS = 256;
     epoll_event* events = new epoll_event[MAX_EVNETS]();
     std::shared_ptr<epoll_event> shared_events(events, [](epoll_event* ptr){
         delete[] ptr;
     });
+    ThreadStats* stats = getThreadStats();
+    //多reactor模式下只等待本线程的epoll
+    ThreadContext* self = getCurrentContext();
+    Reactor* reactor = m_multiReactor && self ? m_reactors[self->index] : m_reactors[0];
+    if(m_multiReactor) {
+        //弹性线程复用的上下文可能留有退出时的标记
+        reactor->tickled = false;
+    }
+    //本线程的忙轮询预算:轮询等到了事件就恢复到最大值,空转一次减半,
+    //负载低时不会每次空闲都白白占满CPU
+    uint64_t spin_budget = m_busyPollUs;
 
     while(true) {
+        if(mask_tickle) {
+            pthread_sigmask(SIG_BLOCK, &block_mask, &old_mask);
+            wait_mask = old_mask;
+            sigdelset(&wait_mask, SIGURG);
+        }
+        //提交攒批未提交的io_uring操作
+        if(m_uring && m_uring->getPending()) {
+            m_uring->submit();
+        }
         uint64_t next_timeout = 0;
         if(SYLAR_UNLIKELY(stopping(next_timeout))) {
             SYLAR_LOG_INFO(g_logger) << "name=" << getName()
                                      << " idle stopping exit";
+            //tickle每次只唤醒一个线程,退出前接力唤醒下一个空闲线程。
+            //多reactor模式下把本线程标记为已唤醒,接力不会再选中正在退出的本线程
+            reactor->tickled = m_multiReactor;
+            tickle();
+            break;
+        }
+        //空闲过久的弹性线程退出
+        if(SYLAR_UNLIKELY(shouldRetire())) {
+            if(m_multiReactor) {
+                reactor->tickled = true;
+            }
             break;
         }
 
+        //本线程信箱或本地队列中还有任务时不阻塞
+        if(hasLocalTask()) {
+            next_timeout = 0;
+        }
+
         int rt = 0;
-        do {
+        bool polled = false;
+        if(spin_budget && next_timeout != 0) {
+            uint64_t limit = spin_budget;
+            if(next_timeout != ~0ull && next_timeout * 1000 < limit) {
+                limit = next_timeout * 1000;
+            }
+            uint64_t begin = GetCurrentUS();
+            do {
+                rt = epoll_wait(reactor->epfd, events, MAX_EVNETS, 0);
+                if(rt != 0 || hasPendingTask()) {
+                    polled = true;
+                    break;
+                }
+            } while(GetCurrentUS() - begin < limit);
+            uint64_t spent = GetCurrentUS() - begin;
+            if(polled) {
+                spin_budget = m_busyPollUs;
+            } else {
+                spin_budget = std::max<uint64_t>(spin_budget / 2, m_busyPollUs / 8);
+                if(next_timeout != ~0ull) {
+                    next_timeout = next_timeout > spent / 1000 ? next_timeout - spent / 1000 : 0;
+                }
+            }
+            if(rt < 0) {
+                rt = 0;
+            }
+            if(stats) {
+                stats->spinUs.add(spent);
+                (polled ? stats->spinHits : stats->spinMisses).add();
+            }
+        }
+        while(!polled) {
             static const int MAX_TIMEOUT = 3000;
             if(next_timeout != ~0ull) {
                 next_timeout = (int)next_timeout > MAX_TIMEOUT
@@ -356,12 +932,18 @@ bool IOManager::cancelAll(int fd){
             } else {
                 next_timeout = MAX_TIMEOUT;
             }
-            rt = epoll_wait(m_epfd, events, MAX_EVNETS, (int)next_timeout);
+            rt = epoll_pwait(reactor->epfd, events, MAX_EVNETS, (int)next_timeout
+                    , mask_tickle ? &wait_mask : nullptr);
             if(rt < 0 && errno == EINTR) {
-            } else {
-                break;
+                //被tickleThread定向唤醒
+                rt = 0;
             }
-        } while(true);
+            break;
+        }
+        if(stats) {
+            stats->wakeups.add();
+            stats->eventsPerWakeup.add(rt < 0 ? 0 : rt);
+        }
 
         std::vector<std::function<void()> > cbs;
         listExpiredCb(cbs);
@@ -377,16 +959,22 @@ bool IOManager::cancelAll(int fd){
 
         for(int i = 0; i < rt; ++i) {
             epoll_event& event = events[i];
-            if(event.data.fd == m_tickleFds[0]) {
-                uint8_t dummy[256];
-                while(read(m_tickleFds[0], dummy, sizeof(dummy)) > 0);
+            if(event.data.fd == reactor->tickleFd) {
+                //先取走计数再清除标记,之后的tickle会重新写入
+                uint64_t dummy;
+                while(read(reactor->tickleFd, &dummy, sizeof(dummy)) > 0);
+                reactor->tickled = false;
+                continue;
+            }
+            if(event.data.fd == m_uringFd) {
+                reapIoUring();
                 continue;
             }
 
             FdContext* fd_ctx = (FdContext*)event.data.ptr;
             FdContext::MutexType::Lock lock(fd_ctx->mutex);
             if(event.events & (EPOLLERR | EPOLLHUP)) {
-                event.events |= (EPOLLIN | EPOLLOUT) & fd_ctx->events;
+                event.events |= (EPOLLIN | EPOLLOUT) & (m_persistent ? ~0u : (uint32_t)fd_ctx->events);
             }
             int real_events = NONE;
             if(event.events & EPOLLIN) {
@@ -396,45 +984,110 @@ bool IOManager::cancelAll(int fd){
                 real_events |= WRITE;
             }
 
+            if(m_persistent) {
+                //没有协程等待的事件记为就绪,边沿触发不会再次通知,等到addEvent时直接触发
+                fd_ctx->ready = (Event)(fd_ctx->ready | (real_events & ~fd_ctx->events));
+                real_events &= fd_ctx->events;
+            }
             if((fd_ctx->events & real_events) == NONE) {
                 continue;
             }
 
-            int left_events = (fd_ctx->events & ~real_events);
-            int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-            event.events = EPOLLET | left_events;
+            if(!m_persistent) {
+                int left_events = (fd_ctx->events & ~real_events);
+                int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+                event.events = EPOLLET | left_events;
 
-            int rt2 = epoll_ctl(m_epfd, op, fd_ctx->fd, &event);
-            if(rt2) {
-                SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
-                    << (EpollCtlOp)op << ", " << fd_ctx->fd << ", " << (EPOLL_EVENTS)event.events << "):"
-                    << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
-                continue;
+                int rt2 = epoll_ctl(reactor->epfd, op, fd_ctx->fd, &event);
+                m_epollCtlCount.fetch_add(1, std::memory_order_relaxed);
+                if(rt2) {
+                    SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << reactor->epfd << ", "
+                        << (EpollCtlOp)op << ", " << fd_ctx->fd << ", " << (EPOLL_EVENTS)event.events << "):"
+                        << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
+                    continue;
+                }
             }
 
             //SYLAR_LOG_INFO(g_logger) << " fd=" << fd_ctx->fd << " events=" << fd_ctx->events
             //                         << " real_events=" << real_events;
+            //多reactor模式下等待的协程在本线程恢复,连接不在线程间迁移
+            int thread = getOwnerThread(fd_ctx);
             if(real_events & READ) {
-                fd_ctx->triggerEvent(READ);
+                fd_ctx->triggerEvent(READ, thread);
                 --m_pendingEventCount;
             }
             if(real_events & WRITE) {
-                fd_ctx->triggerEvent(WRITE);
+                fd_ctx->triggerEvent(WRITE, thread);
                 --m_pendingEventCount;
             }
         }
 
+        if(mask_tickle) {
+            pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+        }
         Fiber::ptr cur = Fiber::GetThis();
         auto raw_ptr = cur.get();
         cur.reset();
 
         raw_ptr->swapOut();
     }
+    if(mask_tickle) {
+        pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+    }
 }
 
 void IOManager::onTimerInsertedAtFront() {
     tickle();
 }
 
+int IOManager::getTimerWheelIndex() {
+    ThreadContext* ctx = getCurrentContext();
+    //use_caller的调用线程在stop()之前不运行调度循环,它加入的定时器交给工作线程;
+    //弹性线程没有时间轮,它加入的定时器同样交给常驻的工作线程
+    if(!ctx || ctx->elastic || (m_rootThread != -1 && ctx->index == 0 && !m_stopping)) {
+        return -1;
+    }
+    return ctx->index;
+}
+
+void IOManager::onTaskLoop() {
+    //线程持续忙碌时不进入idle,在任务之间处理本线程时间轮中到期的定时器
+    if(!isThreadTimerWheels() || !hasExpiredThreadTimer()) {
+        return;
+    }
+    std::vector<std::function<void()> > cbs;
+    listExpiredCb(cbs);
+    if(!cbs.empty()) {
+        schedule(cbs.begin(), cbs.end());
+    }
+}
+
+void IOManager::onTimerInboxPushed(size_t index) {
+    tickleThread(getThreadContexts()[index]);
+}
+
+std::ostream& IOManager::dump(std::ostream& os) {
+    Scheduler::dump(os);
+    os << std::endl << "    io: backend=" << (m_uring ? "io_uring" : "epoll")
+       << " multi_reactor=" << m_multiReactor
+       << " persistent_events=" << m_persistent
+       << " pending_events=" << m_pendingEventCount
+       << " epoll_ctl=" << m_epollCtlCount
+       << " busy_poll_us=" << m_busyPollUs
+       << " so_busy_poll_us=" << m_soBusyPollUs
+       << " thread_timers=" << isThreadTimerWheels()
+       << " timer_inbox_ops=" << getTimerInboxOps();
+    if(m_multiReactor) {
+        os << " reactor_assign=" << (m_leastLoaded ? "least_loaded" : "round_robin")
+           << " fds=(";
+        const std::vector<ThreadContext*>& ctxs = getThreadContexts();
+        for(size_t i = 0; i < m_reactors.size(); ++i) {
+            os << (i ? ", " : "") << ctxs[i]->threadId << ":" << m_reactors[i]->fdCount;
+        }
+        os << ")";
+    }
+    return os;
+}
+
 
 }
\ No newline at end of file
@@ -10,11 +10,28 @@
 
 #include"scheduler.h"
 #include"timer.h"
+#include"radix_table.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
 
 namespace Sylar{
 
+    class IoUring;
+
     /**
      * @brief 基于epoll的IO协程调度器
+     * @details iomanager.backend配置为io_uring时,hook的读写、accept、connect直接提交为
+     *          io_uring操作,由完成事件唤醒协程;io_uring句柄加入epoll,空闲线程统一等待。
+     *          iomanager.multi_reactor开启时每个工作线程有自己的epoll,句柄在首次使用或
+     *          accept时分配给一个线程,之后它的事件只在该线程上触发,等待的协程也在该线程上恢复。
+     *          iomanager.persistent_events开启时句柄第一次等待时以EPOLLIN|EPOLLOUT|EPOLLET
+     *          注册,直到cancelAll(关闭)才移出epoll,稳定状态下等待和触发事件都不调用epoll_ctl。
+     *          iomanager.busy_poll_us大于0时空闲线程在阻塞前先忙轮询epoll和任务队列,
+     *          用CPU换取更低的唤醒延迟。
+     *          共享epoll模式下第一个IOManager创建时安装进程级的SIGURG处理函数,用于唤醒指定的
+     *          空闲线程,SIGURG只在空闲线程检查信箱到epoll_pwait返回期间屏蔽。程序之后自行安装
+     *          SIGURG处理函数的,定向唤醒退回普通唤醒,绑定线程的任务可能延迟到epoll等待超时才执行
      */
     class IOManager:public Scheduler,public TimerManager{
         public:
@@ -64,8 +81,9 @@ namespace Sylar{
             /**
              * @brief 触发事件
              * @param[in] event 事件类型
+             * @param[in] thread 协程/回调投递到的线程,-1表示不绑定
              */
-            void triggerEvent(Event event);
+            void triggerEvent(Event event,int thread=-1);
 
             //读事件上下文
             EventContext read;
@@ -77,16 +95,51 @@ namespace Sylar{
             Event events=NONE;
             //事件的Mutex
             MutexType mutex;
+            //是否已注册到io_uring的固定文件表
+            bool fixedFile=false;
+            //进行中的io_uring操作数
+            std::atomic<int>uringOps={0};
+            //所属reactor(线程上下文下标),多reactor模式下未分配时为-1
+            int reactor=-1;
+            //持久注册模式下是否已加入epoll
+            bool registered=false;
+            //持久注册模式下已经就绪、但当时没有协程等待的事件
+            Event ready=NONE;
+            //注册(epoll持久注册、固定文件表)时句柄FdCtx的代数
+            uint64_t generation=0;
+            //是否已设置SO_BUSY_POLL
+            bool busyPoll=false;
+        };
+
+        /**
+         * @brief 一个epoll及其唤醒用的eventfd
+         * @details 共享模式下所有线程共用一个,多reactor模式下每个线程上下文一个
+         */
+        struct Reactor{
+            //epoll文件句柄
+            int epfd=-1;
+            //唤醒等待线程的eventfd
+            int tickleFd=-1;
+            //是否有已写入但尚未被取走的唤醒,用于合并重复的唤醒
+            std::atomic<bool>tickled={false};
+            //分配到该reactor的句柄数
+            std::atomic<size_t>fdCount={0};
         };
 
+        struct IoUringOp;
+
         public:
         /**
          * @brief 构造函数
          * @param[in] threads 线程数量
          * @param[in] use_caller 是否将调用线程包含进去
          * @param[in] name 调度器的名称
+         * @param[in] affinity 工作线程的CPU/NUMA绑定
+         * @param[in] elastic 弹性线程数配置
          */
-        IOManager(size_t threads=1,bool use_caller=true,const std::string&name="");
+        IOManager(size_t threads=1,bool use_caller=true,const std::string&name=""
+                  ,const CpuAffinity&affinity=CpuAffinity()
+                  ,const ElasticConfig&elastic=ElasticConfig());
 
         ~IOManager();
 
@@ -122,21 +175,65 @@ namespace Sylar{
          */
         bool cancelAll(int fd);
 
+        /**
+         * @brief 把句柄分配给一个工作线程(多reactor模式)
+         * @details 已分配的句柄保持不变,未分配的按iomanager.reactor_assign策略
+         *          (round_robin或least_loaded)选择。accept得到的连接可先分配,
+         *          再把处理协程调度到返回的线程上
+         * @return 所属线程id,共享模式或线程尚未启动时返回-1
+         */
+        int assignFd(int fd);
+
+        /**
+         * @brief 是否为每个线程一个epoll的多reactor模式
+         */
+        bool isMultiReactor()const{return m_multiReactor;}
+
+        /**
+         * @brief 是否为持久注册模式
+         * @details 句柄未经cancelAll关闭(其他IOManager、普通线程中关闭)时,
+         *          编号复用后由FdCtx代数的变化识别,重新注册
+         */
+        bool isPersistentEvents()const{return m_persistent;}
+
+        /**
+         * @brief 空闲线程忙轮询的最长时间(微秒),0表示不忙轮询
+         */
+        uint32_t getBusyPollUs()const{return m_busyPollUs;}
+
+        std::ostream&dump(std::ostream&os)override;
+
+        /**
+         * @brief 是否使用io_uring后端
+         */
+        bool isIoUring()const{return m_uring!=nullptr;}
+
+        /**
+         * @brief 通过io_uring执行一次IO操作,当前协程挂起直到完成
+         * @details 调用方填好opcode、fd、addr、len等字段,user_data和链接的超时由这里设置。
+         *          开启时句柄注册为固定文件,不超过缓冲区大小的读写改用注册缓冲区。
+         *          sqe引用的缓冲区在完成前由内核读写,不能位于共享栈协程的栈上。
+         *          RECVMSG/SENDMSG的msghdr和iovec在提交前复制到堆上,调用方的结构体只需在调用期间有效,
+         *          完成后回写msg_namelen、msg_controllen和msg_flags
+         * @param[in] sqe 待提交的操作
+         * @param[in] timeout_ms 超时时间(毫秒),~0ull表示不超时
+         * @return 操作结果,失败返回-errno,超时返回-ETIMEDOUT
+         */
+        int submitIo(const io_uring_sqe&sqe,uint64_t timeout_ms);
+
         /**
          * @brief 返回当前的IOManager
          */
         static IOManager*GetThis();
         protected:
         void tickle()override;
+        void tickleThread(ThreadContext* ctx)override;
         bool stopping()override;
         void idle()override;
         void onTimerInsertedAtFront()override;
-
-        /**
-         * @brief 重置socket句柄上下文的容器大小
-         * @param[in] size 容量大小
-         */
-        void contextResize(size_t size);
+        int getTimerWheelIndex()override;
+        void onTimerInboxPushed(size_t index)override;
+        void onTaskLoop()override;
 
         /**
          * @brief 判断是否可以停止
@@ -144,17 +241,90 @@ namespace Sylar{
          * @return 返回是否可以停止
          */
         bool stopping(uint64_t&timeout);
+
+        /**
+         * @brief 返回句柄上下文,不加锁
+         * @param[in] fd 句柄
+         * @param[in] auto_create 所在分段不存在时是否创建
+         * @return fd无效或分段不存在时返回nullptr
+         */
+        FdContext*getFdContext(int fd,bool auto_create);
+
+        /**
+         * @brief 返回句柄所属的reactor
+         */
+        Reactor*getReactor(FdContext*fd_ctx);
+
+        /**
+         * @brief 为未分配的句柄选择reactor(需持有fd_ctx->mutex)
+         */
+        void assignReactor(FdContext*fd_ctx);
+
+        /**
+         * @brief 解除句柄与reactor的绑定(需持有fd_ctx->mutex,且句柄已移出epoll)
+         */
+        void releaseReactor(FdContext*fd_ctx);
+
+        /**
+         * @brief 句柄的事件投递到的线程,共享模式下为-1
+         */
+        int getOwnerThread(FdContext*fd_ctx);
+
+        /**
+         * @brief 唤醒在reactor上等待的线程
+         * @return 已有未取走的唤醒时返回false
+         */
+        bool wakeReactor(Reactor*reactor);
+
+        /**
+         * @brief 取出io_uring的所有完成事件并唤醒对应协程
+         */
+        void reapIoUring();
+
+        /**
+         * @brief 处理一个完成事件
+         */
+        void completeIo(const io_uring_cqe&cqe);
+
+        /**
+         * @brief 取消句柄上进行中的io_uring操作并移出固定文件表(需持有fd_ctx->mutex)
+         */
+        void cancelIo(FdContext*fd_ctx);
+
+        /**
+         * @brief 检查句柄的FdCtx代数,变化时丢弃按旧句柄保存的注册状态(需持有fd_ctx->mutex)
+         * @details 旧句柄在别处关闭时内核已把它移出epoll,但固定文件表中仍是旧文件
+         */
+        void refreshGeneration(FdContext*fd_ctx);
         private:
-        //epoll文件句柄
-        int m_epfd=0;
-        //pipe文件句柄
-        int m_tickleFds[2];
+        //共享模式下只有一个reactor,多reactor模式下与线程上下文一一对应
+        std::vector<Reactor*>m_reactors;
+        //是否为每个线程一个epoll
+        bool m_multiReactor=false;
+        //是否按分配的句柄数选择reactor,否则轮询
+        bool m_leastLoaded=false;
+        //轮询分配的下一个位置
+        std::atomic<uint32_t>m_nextReactor={0};
+        //句柄是否持久注册在epoll中
+        bool m_persistent=false;
+        //句柄注册相关的epoll_ctl调用次数
+        std::atomic<uint64_t>m_epollCtlCount={0};
+        //空闲线程阻塞前忙轮询的最长时间(微秒)
+        uint32_t m_busyPollUs=0;
+        //socket的SO_BUSY_POLL(微秒)
+        uint32_t m_soBusyPollUs=0;
         //当前等待执行的事件数量
         std::atomic<size_t>m_pendingEventCount={0};
-        //IOManger的Mutex
-        RWMutexType m_mutex;
-        //soecket事件上下文的容器
-        std::vector<FdContext*>m_fdContexts;
+        //累计注册的事件数,用于判断stopping检查期间是否有新事件
+        std::atomic<uint64_t>m_eventSeq={0};
+        //socket事件上下文表,以fd为下标,分段创建且不移动,查找不加锁
+        RadixTable<FdContext>m_fdContexts;
+        //io_uring后端,使用epoll时为nullptr
+        IoUring*m_uring=nullptr;
+        //io_uring句柄(已加入epoll)
+        int m_uringFd=-1;
+        //未提交的操作达到该数量时立即提交
+        uint32_t m_uringBatch=32;
 
     };
 }
@@ -1,6 +1,8 @@
 #include "mutex.h"
 #include "macro.h"
 #include "scheduler.h"
+#include "config.h"
+#include <errno.h>
 
 namespace Sylar {
 
@@ -15,8 +17,11 @@ Semaphore::~Semaphore() {
 }
 
 void Semaphore::wait() {
-    if(sem_wait(&m_semaphore)) {
-        throw std::logic_error("sem_wait error");
+    //被信号打断(如watchdog采集调用栈)时继续等待
+    while(sem_wait(&m_semaphore)) {
+        if(errno != EINTR) {
+            throw std::logic_error("sem_wait error");
+        }
     }
 }
 
@@ -70,4 +75,190 @@ void FiberSemaphore::notify() {
     }
 }
 
+void FiberWaitList::wait(Spinlock::Lock& lock) {
+    Scheduler* scheduler = Scheduler::GetThis();
+    Semaphore sem;
+    Waiter waiter;
+    waiter.scheduler = scheduler;
+    if(scheduler) {
+        waiter.fiber = Fiber::GetThis();
+    } else {
+        waiter.sem = &sem;
+    }
+    m_waiters.push_back(std::move(waiter));
+    lock.unlock();
+    if(scheduler) {
+        //唤醒可能早于切出,调度器会等本协程切出后再恢复它
+        Fiber::YieldToHold();
+    } else {
+        sem.wait();
+    }
+}
+
+bool FiberWaitList::notifyOne() {
+    if(m_waiters.empty()) {
+        return false;
+    }
+    Waiter& waiter = m_waiters.front();
+    if(waiter.scheduler) {
+        waiter.scheduler->schedule(std::move(waiter.fiber));
+    } else {
+        waiter.sem->notify();
+    }
+    m_waiters.pop_front();
+    return true;
+}
+
+void FiberWaitList::notifyAll() {
+    while(notifyOne()) {
+    }
+}
+
+static ConfigVar<uint32_t>::ptr g_fiber_mutex_spin_count =
+    Config::Lookup<uint32_t>("fiber.mutex.spin_count", 100, "fiber mutex spin count before parking the fiber");
+
+static std::atomic<uint32_t> s_spin_count {100};
+
+namespace {
+
+struct FiberMutexIniter {
+    FiberMutexIniter() {
+        s_spin_count = g_fiber_mutex_spin_count->getValue();
+        g_fiber_mutex_spin_count->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_spin_count = new_value;
+        });
+    }
+};
+
+static FiberMutexIniter s_init;
+
+}
+
+static inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * @brief 自旋尝试try_lock,成功返回true
+ */
+template<class F>
+static bool SpinTry(F try_lock) {
+    for(uint32_t i = s_spin_count; i > 0; --i) {
+        if(try_lock()) {
+            return true;
+        }
+        CpuRelax();
+    }
+    return false;
+}
+
+bool FiberMutex::tryLock() {
+    bool expected = false;
+    return m_locked.compare_exchange_strong(expected, true, std::memory_order_acquire);
+}
+
+void FiberMutex::lock() {
+    if(tryLock() || SpinTry([this](){ return !m_locked.load(std::memory_order_relaxed) && tryLock();})) {
+        return;
+    }
+    Spinlock::Lock lock(m_mutex);
+    if(tryLock()) {
+        return;
+    }
+    //解锁方把锁直接交给等待者,被唤醒时已经持有锁
+    m_waiters.wait(lock);
+}
+
+void FiberMutex::unlock() {
+    Spinlock::Lock lock(m_mutex);
+    if(!m_waiters.notifyOne()) {
+        m_locked.store(false, std::memory_order_release);
+    }
+}
+
+bool FiberRWMutex::tryRdlock() {
+    Spinlock::Lock lock(m_mutex);
+    if(m_writer || !m_writeWaiters.empty()) {
+        return false;
+    }
+    ++m_readers;
+    return true;
+}
+
+bool FiberRWMutex::tryWrlock() {
+    Spinlock::Lock lock(m_mutex);
+    if(m_writer || m_readers) {
+        return false;
+    }
+    m_writer = true;
+    return true;
+}
+
+void FiberRWMutex::rdlock() {
+    if(tryRdlock() || SpinTry([this](){ return tryRdlock();})) {
+        return;
+    }
+    Spinlock::Lock lock(m_mutex);
+    if(!m_writer && m_writeWaiters.empty()) {
+        ++m_readers;
+        return;
+    }
+    m_readWaiters.wait(lock);
+}
+
+void FiberRWMutex::wrlock() {
+    if(tryWrlock() || SpinTry([this](){ return tryWrlock();})) {
+        return;
+    }
+    Spinlock::Lock lock(m_mutex);
+    if(!m_writer && !m_readers) {
+        m_writer = true;
+        return;
+    }
+    m_writeWaiters.wait(lock);
+}
+
+void FiberRWMutex::unlock() {
+    Spinlock::Lock lock(m_mutex);
+    if(m_writer) {
+        m_writer = false;
+        //写锁释放时先放行等待的读者,避免读者饿死
+        if(!m_readWaiters.empty()) {
+            m_readers += m_readWaiters.size();
+            m_readWaiters.notifyAll();
+            return;
+        }
+    } else {
+        SYLAR_ASSERT(m_readers > 0);
+        if(--m_readers) {
+            return;
+        }
+    }
+    if(m_writeWaiters.notifyOne()) {
+        m_writer = true;
+    }
+}
+
+void FiberCondition::wait(FiberMutex::Lock& lock) {
+    Spinlock::Lock wait_lock(m_mutex);
+    //先登记再释放FiberMutex,notify不会丢失
+    lock.unlock();
+    m_waiters.wait(wait_lock);
+    lock.lock();
+}
+
+void FiberCondition::notifyOne() {
+    Spinlock::Lock lock(m_mutex);
+    m_waiters.notifyOne();
+}
+
+void FiberCondition::notifyAll() {
+    Spinlock::Lock lock(m_mutex);
+    m_waiters.notifyAll();
+}
+
 }
@@ -12,6 +12,7 @@
 
 #include "noncopyable.h"
 #include "fiber.h"
+#include "ring_queue.h"
 
 namespace Sylar {
 
@@ -444,7 +445,172 @@ private:
     size_t m_concurrency;
 };
 
+/**
+ * @brief 等待者列表
+ * @details 本身不加锁,由使用者的锁保护。在协程调度器中等待时挂起协程,
+ *          由唤醒方通过调度器恢复;否则阻塞线程。按等待的先后顺序唤醒
+ */
+class FiberWaitList {
+public:
+    /**
+     * @brief 登记当前协程/线程,释放lock后挂起,直到被唤醒
+     * @param[in] lock 保护本列表的锁,返回时已释放
+     */
+    void wait(Spinlock::Lock& lock);
+
+    /**
+     * @brief 唤醒最早的一个等待者,需持有保护本列表的锁
+     * @return 没有等待者返回false
+     */
+    bool notifyOne();
+
+    /**
+     * @brief 唤醒所有等待者,需持有保护本列表的锁
+     */
+    void notifyAll();
 
+    /**
+     * @brief 是否没有等待者
+     */
+    bool empty() const { return m_waiters.empty();}
+
+    /**
+     * @brief 返回等待者数量
+     */
+    size_t size() const { return m_waiters.size();}
+private:
+    struct Waiter {
+        /// 协程所在的调度器,为空表示线程等待
+        Scheduler* scheduler = nullptr;
+        /// 等待的协程
+        Fiber::ptr fiber;
+        /// 线程等待使用的信号量
+        Semaphore* sem = nullptr;
+    };
+    RingQueue<Waiter> m_waiters;
+};
+
+/**
+ * @brief 协程互斥锁
+ * @details 加锁失败时先自旋一小段时间(fiber.mutex.spin_count),仍失败则挂起当前协程,
+ *          不阻塞线程;解锁时直接把锁交给最早的等待者并通过调度器恢复它。
+ *          可以在持有期间执行hook的IO操作。不在协程调度器中时阻塞线程
+ */
+class FiberMutex : Noncopyable {
+public:
+    /// 局部锁
+    typedef ScopedLockImpl<FiberMutex> Lock;
+
+    /**
+     * @brief 加锁
+     */
+    void lock();
+
+    /**
+     * @brief 尝试加锁
+     * @return 成功返回true
+     */
+    bool tryLock();
+
+    /**
+     * @brief 解锁
+     */
+    void unlock();
+private:
+    /// 保护等待者列表
+    Spinlock m_mutex;
+    /// 是否已被持有
+    std::atomic<bool> m_locked = {false};
+    /// 等待者
+    FiberWaitList m_waiters;
+};
+
+/**
+ * @brief 协程读写锁
+ * @details 有写者等待时新的读者排队;写锁释放时优先放行所有等待的读者,
+ *          最后一个读者释放时放行一个写者,读写双方都不会饿死
+ */
+class FiberRWMutex : Noncopyable {
+public:
+    /// 局部读锁
+    typedef ReadScopedLockImpl<FiberRWMutex> ReadLock;
+
+    /// 局部写锁
+    typedef WriteScopedLockImpl<FiberRWMutex> WriteLock;
+
+    /**
+     * @brief 上读锁
+     */
+    void rdlock();
+
+    /**
+     * @brief 上写锁
+     */
+    void wrlock();
+
+    /**
+     * @brief 尝试上读锁
+     */
+    bool tryRdlock();
+
+    /**
+     * @brief 尝试上写锁
+     */
+    bool tryWrlock();
+
+    /**
+     * @brief 解锁(读锁或写锁)
+     */
+    void unlock();
+private:
+    /// 保护内部状态
+    Spinlock m_mutex;
+    /// 持有读锁的数量
+    uint32_t m_readers = 0;
+    /// 是否持有写锁
+    bool m_writer = false;
+    /// 等待读锁的协程
+    FiberWaitList m_readWaiters;
+    /// 等待写锁的协程
+    FiberWaitList m_writeWaiters;
+};
+
+/**
+ * @brief 协程条件变量,配合FiberMutex使用
+ */
+class FiberCondition : Noncopyable {
+public:
+    /**
+     * @brief 释放lock并挂起,被唤醒后重新加锁
+     * @pre lock 已加锁
+     */
+    void wait(FiberMutex::Lock& lock);
+
+    /**
+     * @brief 等待直到pred()为true
+     */
+    template<class Pred>
+    void wait(FiberMutex::Lock& lock, Pred pred) {
+        while(!pred()) {
+            wait(lock);
+        }
+    }
+
+    /**
+     * @brief 唤醒一个等待者
+     */
+    void notifyOne();
+
+    /**
+     * @brief 唤醒所有等待者
+     */
+    void notifyAll();
+private:
+    /// 保护等待者列表
+    Spinlock m_mutex;
+    /// 等待者
+    FiberWaitList m_waiters;
+};
 
 }
 
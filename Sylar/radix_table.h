@@ -0,0 +1,123 @@
+/**
+ * @file radix_table.h
+ * @brief 按下标查找、无锁读取的两级分段表
+ * @details 用于以fd为下标的上下文表,扩容不移动已有元素
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_RADIX_TABLE_H__
+#define __SYLAR_RADIX_TABLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "noncopyable.h"
+
+namespace Sylar {
+
+/**
+ * @brief 两级基数表
+ * @details 根数组固定为2^RootBits个叶子指针,每个叶子连续存放2^LeafBits个元素。
+ *          叶子在第一次访问时创建,通过CAS发布,之后直到析构都不会移动或释放,
+ *          因此返回的元素指针始终有效,查找只需一次原子读,不加锁。
+ *          元素本身的并发访问由调用方负责
+ */
+template<class T, uint32_t LeafBits = 10, uint32_t RootBits = 12>
+class RadixTable : Noncopyable {
+public:
+    /// 叶子大小
+    static const size_t LEAF_SIZE = (size_t)1 << LeafBits;
+    /// 最大下标(不含)
+    static const size_t CAPACITY = (size_t)1 << (LeafBits + RootBits);
+
+    RadixTable() {
+        for(size_t i = 0; i < ROOT_SIZE; ++i) {
+            m_root[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~RadixTable() {
+        for(size_t i = 0; i < ROOT_SIZE; ++i) {
+            delete m_root[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief 查找元素,所在叶子尚未创建时返回nullptr
+     */
+    T* find(size_t index) const {
+        if(index >= CAPACITY) {
+            return nullptr;
+        }
+        Leaf* leaf = m_root[index >> LeafBits].load(std::memory_order_acquire);
+        return leaf ? &leaf->items[index & (LEAF_SIZE - 1)] : nullptr;
+    }
+
+    /**
+     * @brief 查找元素,所在叶子尚未创建时创建
+     * @return 下标超出CAPACITY时返回nullptr
+     */
+    T* get(size_t index) {
+        return get(index, [](T&, size_t){});
+    }
+
+    /**
+     * @brief 查找元素,所在叶子尚未创建时创建
+     * @param[in] init 新叶子发布前对其中每个元素调用init(item, index)
+     * @return 下标超出CAPACITY时返回nullptr
+     */
+    template<class Init>
+    T* get(size_t index, Init init) {
+        if(index >= CAPACITY) {
+            return nullptr;
+        }
+        std::atomic<Leaf*>& slot = m_root[index >> LeafBits];
+        Leaf* leaf = slot.load(std::memory_order_acquire);
+        if(!leaf) {
+            Leaf* new_leaf = new Leaf;
+            size_t base = index & ~(LEAF_SIZE - 1);
+            for(size_t i = 0; i < LEAF_SIZE; ++i) {
+                init(new_leaf->items[i], base + i);
+            }
+            //多个线程同时创建同一叶子时只有一个成功,其余释放自己创建的
+            if(slot.compare_exchange_strong(leaf, new_leaf, std::memory_order_acq_rel)) {
+                leaf = new_leaf;
+            } else {
+                delete new_leaf;
+            }
+        }
+        return &leaf->items[index & (LEAF_SIZE - 1)];
+    }
+
+    /**
+     * @brief 遍历已创建的叶子中的所有元素
+     */
+    template<class Func>
+    void foreach(Func cb) {
+        for(size_t i = 0; i < ROOT_SIZE; ++i) {
+            Leaf* leaf = m_root[i].load(std::memory_order_acquire);
+            if(!leaf) {
+                continue;
+            }
+            for(size_t j = 0; j < LEAF_SIZE; ++j) {
+                cb(leaf->items[j], (i << LeafBits) + j);
+            }
+        }
+    }
+private:
+    static const size_t ROOT_SIZE = (size_t)1 << RootBits;
+
+    struct Leaf {
+        /// 值初始化,原子类型的元素也从0开始
+        Leaf() : items() {}
+        T items[LEAF_SIZE];
+    };
+
+    std::atomic<Leaf*> m_root[ROOT_SIZE];
+};
+
+}
+
+#endif
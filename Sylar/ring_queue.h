@@ -0,0 +1,118 @@
+/**
+ * @file ring_queue.h
+ * @brief 基于环形数组的双端队列
+ * @details 容量按2的幂增长且不收缩,稳定运行后入队出队不再申请内存
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_RING_QUEUE_H__
+#define __SYLAR_RING_QUEUE_H__
+
+#include <stddef.h>
+#include <vector>
+#include <utility>
+
+namespace Sylar {
+
+/**
+ * @brief 环形双端队列
+ * @details 元素需要可默认构造和移动,出队的槽位会被重置为默认值以释放资源
+ */
+template<class T>
+class RingQueue {
+public:
+    /**
+     * @brief 返回元素数量
+     */
+    size_t size() const { return m_size;}
+
+    /**
+     * @brief 是否为空
+     */
+    bool empty() const { return m_size == 0;}
+
+    /**
+     * @brief 返回第i个元素(从队头开始)
+     */
+    T& operator[](size_t i) { return m_buf[(m_head + i) & (m_buf.size() - 1)];}
+
+    T& front() { return m_buf[m_head];}
+
+    T& back() { return (*this)[m_size - 1];}
+
+    void push_back(T&& v) {
+        if(m_size == m_buf.size()) {
+            grow();
+        }
+        (*this)[m_size] = std::move(v);
+        ++m_size;
+    }
+
+    void push_front(T&& v) {
+        if(m_size == m_buf.size()) {
+            grow();
+        }
+        m_head = (m_head - 1) & (m_buf.size() - 1);
+        m_buf[m_head] = std::move(v);
+        ++m_size;
+    }
+
+    void pop_front() {
+        m_buf[m_head] = T();
+        m_head = (m_head + 1) & (m_buf.size() - 1);
+        --m_size;
+    }
+
+    void pop_back() {
+        back() = T();
+        --m_size;
+    }
+
+    /**
+     * @brief 删除第i个元素,保持其余元素的顺序
+     */
+    void erase(size_t i) {
+        if(i < m_size / 2) {
+            for(size_t x = i; x > 0; --x) {
+                (*this)[x] = std::move((*this)[x - 1]);
+            }
+            pop_front();
+        } else {
+            for(size_t x = i + 1; x < m_size; ++x) {
+                (*this)[x - 1] = std::move((*this)[x]);
+            }
+            pop_back();
+        }
+    }
+
+    void clear() {
+        while(!empty()) {
+            pop_back();
+        }
+    }
+private:
+    /**
+     * @brief 容量翻倍,元素按顺序搬到新数组的开头
+     */
+    void grow() {
+        std::vector<T> buf(m_buf.empty() ? 16 : m_buf.size() * 2);
+        for(size_t i = 0; i < m_size; ++i) {
+            buf[i] = std::move((*this)[i]);
+        }
+        m_buf.swap(buf);
+        m_head = 0;
+    }
+private:
+    /// 环形数组,大小为0或2的幂
+    std::vector<T> m_buf;
+    /// 队头下标
+    size_t m_head = 0;
+    /// 元素数量
+    size_t m_size = 0;
+};
+
+}
+
+#endif
@@ -44,8 +44,7 @@ int32_t RockStream::sendMessage(Message::ptr msg) {
     if(isConnected()) {
         RockSendCtx::ptr ctx(new RockSendCtx);
         ctx->msg = msg;
-        enqueue(ctx);
-        return 1;
+        return enqueue(ctx) ? 1 : -1;
     } else {
         return -1;
     }
@@ -63,7 +62,21 @@ RockResult::ptr RockStream::request(RockRequest::ptr req, uint32_t timeout_ms) {
         uint64_t ts = Sylar::GetCurrentMS();
         ctx->timer = Sylar::IOManager::GetThis()->addTimer(timeout_ms,
                 std::bind(&RockStream::onTimeOut, shared_from_this(), ctx));
-        enqueue(ctx);
+        //ctx和定时器已就绪,不能在发送队列上挂起,否则超时唤醒会与队列唤醒重复
+        if(!tryEnqueue(ctx)) {
+            Sylar::Scheduler* scd = ctx->scheduler;
+            if(Sylar::Atomic::compareAndSwapBool(ctx->scheduler, scd, (Sylar::Scheduler*)nullptr)) {
+                //抢在超时回调之前收回ctx,当前协程不会再被调度
+                getAndDelCtx(ctx->sn);
+                if(ctx->timer) {
+                    ctx->timer->cancel();
+                    ctx->timer = nullptr;
+                }
+                return std::make_shared<RockResult>(isConnected() ? AsyncSocketStream::QUEUE_FULL
+                        : AsyncSocketStream::NOT_CONNECT, 0, nullptr, req);
+            }
+            //超时回调已经调度了当前协程,照常让出以消费这次唤醒
+        }
         Sylar::Fiber::YieldToHold();
         return std::make_shared<RockResult>(ctx->result, Sylar::GetCurrentMS() - ts, ctx->response, req);
     } else {
@@ -2,11 +2,35 @@
 #include"log.h"
 #include"macro.h"
 #include"hook.h"
+#include"config.h"
+#include"util.h"
+#include"watchdog.h"
+#include <algorithm>
+#include <execinfo.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
 
 namespace Sylar{
 
     static Sylar::Logger::ptr g_logger=SYLAR_LOG_NAME("system");
 
+    static Sylar::ConfigVar<bool>::ptr g_scheduler_work_stealing=
+        Sylar::Config::Lookup("scheduler.work_stealing",false,"scheduler work stealing mode");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_scheduler_fiber_cache=
+        Sylar::Config::Lookup<uint32_t>("scheduler.fiber_cache",16,"max finished fibers cached per thread for reuse");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_scheduler_aging_normal=
+        Sylar::Config::Lookup<uint32_t>("scheduler.aging.normal_ms",10,"relative deadline of normal priority tasks in ms");
+
+    static Sylar::ConfigVar<uint32_t>::ptr g_scheduler_aging_low=
+        Sylar::Config::Lookup<uint32_t>("scheduler.aging.low_ms",100,"relative deadline of low priority tasks in ms");
+
+    static Sylar::ConfigVar<bool>::ptr g_watchdog_signal_backtrace=
+        Sylar::Config::Lookup("fiber.watchdog.signal_backtrace",true,"signal stuck threads to capture their backtrace, set false to opt out");
+
     /**
      * @brief 线程局部变量，指向当前线程所使用的调度器实例。
      * @details 每个线程都有自己独立的 t_scheduler 变量，初始值为 nullptr。
@@ -19,10 +43,26 @@ namespace Sylar{
      *          当线程关联到调度器后，该变量会被设置为调度器的主协程指针。
      */
     static thread_local Fiber*t_scheduler_fiber=nullptr;
+    /**
+     * @brief 线程局部变量，指向当前线程在调度器中的工作线程上下文(本地队列)。
+     */
+    static thread_local void*t_thread_context=nullptr;
 
-    Scheduler::Scheduler(size_t threads,bool use_caller,const std::string&name)
-            :m_name(name){
+    Scheduler::Scheduler(size_t threads,bool use_caller,const std::string&name
+                         ,const CpuAffinity&affinity,const ElasticConfig&elastic)
+            :m_name(name)
+            ,m_workStealing(g_scheduler_work_stealing->getValue())
+            ,m_affinity(affinity)
+            ,m_elastic(elastic){
             SYLAR_ASSERT(threads>0);
+            //弹性模式关闭时最多线程数等于最少线程数
+            if(m_elastic.maxThreads<threads){
+                m_elastic.maxThreads=threads;
+            }
+            size_t elastic_threads=m_elastic.maxThreads-threads;
+            m_agingUs[PRIORITY_HIGH]=0;
+            m_agingUs[PRIORITY_NORMAL]=g_scheduler_aging_normal->getValue()*1000ull;
+            m_agingUs[PRIORITY_LOW]=g_scheduler_aging_low->getValue()*1000ull;
 
             if(use_caller){//是否使用当前线程
                 Sylar::Fiber::GetThis();//确保当前线程初始化了协程环境
@@ -43,12 +83,38 @@ namespace Sylar{
                 m_rootThread=-1;
             }
             m_threadCount=threads;
+
+            //每个工作线程(包括use_caller的调用线程)一个本地队列
+            size_t contexts=threads+(use_caller?1:0);
+            for(size_t i=0;i<contexts;++i){
+                ThreadContext*ctx=new ThreadContext;
+                ctx->index=i;
+                m_threadContexts.push_back(ctx);
+            }
+            //弹性线程的上下文也在构造时分配,线程退出后保留给下一个增加的线程复用
+            for(size_t i=0;i<elastic_threads;++i){
+                ThreadContext*ctx=new ThreadContext;
+                ctx->index=contexts+i;
+                ctx->elastic=true;
+                m_threadContexts.push_back(ctx);
+            }
+            m_elasticThreads.resize(elastic_threads);
+            if(use_caller){
+                m_threadContexts[0]->threadId=m_rootThread;
+                m_threadContexts[0]->pthread=pthread_self();
+                t_thread_context=m_threadContexts[0];
+            }
     }
 
     Scheduler::~Scheduler(){
         SYLAR_ASSERT(m_stopping);
+        Watchdog::GetInstance()->del(this);
         if(GetThis()==this){
             t_scheduler=nullptr;
+            t_thread_context=nullptr;
+        }
+        for(auto i:m_threadContexts){
+            delete i;
         }
     }
 
@@ -68,17 +134,44 @@ namespace Sylar{
         }
         //设置调度器状态为运行中
         m_stopping=false;
+        Watchdog::GetInstance()->add(this);
         SYLAR_ASSERT(m_threads.empty());
         //创建线程池
         m_threads.resize(m_threadCount);
+        size_t base=m_rootThread==-1?0:1;
         for(size_t i=0;i<m_threadCount;++i){
-            m_threads[i].reset(new Thread(std::bind(&Scheduler::run,this)
-            ,m_name+"_"+std::to_string(i)));
+            m_threads[i]=startThread(m_threadContexts[base+i],i);
             m_threadIds.push_back(m_threads[i]->getId());
         }
         lock.unlock();
     }
 
+    Thread::ptr Scheduler::startThread(ThreadContext*ctx,size_t index){
+        return Thread::ptr(new Thread([this,ctx,index](){
+            //先绑定再进入调度循环,之后线程分配的协程栈、epoll事件数组等都落在本地节点
+            if(!m_affinity.empty()){
+                Thread::SetAffinity(m_affinity,index);
+            }
+            ctx->pthread=pthread_self();
+            ctx->threadId=Sylar::GetThreadId();
+            t_thread_context=ctx;
+            run();
+            t_thread_context=nullptr;
+            if(ctx->elastic){
+                {
+                    //线程即将被join,清除pthread避免定向唤醒/采集调用栈向已回收的线程发信号
+                    ThreadContext::MutexType::Lock lock(ctx->mutex);
+                    ctx->threadId=-1;
+                    ctx->pthread=0;
+                    ctx->idle=false;
+                }
+                --m_elasticThreadCount;
+                ++m_retireCount;
+                ctx->active=false;
+            }
+        },m_name+"_"+std::to_string(index)));
+    }
+
     void Scheduler::stop(){
         m_autoStop=true;
         //检查主协程状态，如果主协程已完成且没有线程，直接退出
@@ -101,7 +194,7 @@ namespace Sylar{
         }
         //设置停止标志并通知线程
         m_stopping=true;
-        for(size_t i=0;i<m_threadCount;++i){
+        for(size_t i=0;i<getThreadCount();++i){
             tickle();
         }
         if(m_rootFiber){
@@ -117,6 +210,12 @@ namespace Sylar{
         {
             MutexType::Lock lock(m_mutex);
             thrs.swap(m_threads);
+            for(auto&i:m_elasticThreads){
+                if(i){
+                    thrs.push_back(i);
+                    i.reset();
+                }
+            }
         }
         for(auto& i:thrs){
             i->join();
@@ -127,6 +226,13 @@ namespace Sylar{
         t_scheduler=this;
     }
 
+    /**
+     * @brief 两个时间点的间隔,系统时间回拨时返回0
+     */
+    static uint64_t Elapsed(uint64_t begin,uint64_t end){
+        return end>begin?end-begin:0;
+    }
+
     void Scheduler::run() {
      //打印调试日志，标记当前线程进入调度器运行状态   
     SYLAR_LOG_DEBUG(g_logger) << m_name << " run";
@@ -142,72 +248,178 @@ namespace Sylar{
     //空闲协程，用于在没有任务可执行时防止线程空转
     Fiber::ptr idle_fiber(new Fiber(std::bind(&Scheduler::idle, this)));
     Fiber::ptr cb_fiber;
+    //执行完毕的协程对象(连同其栈)缓存起来,供后续回调任务复用
+    std::vector<Fiber::ptr> fiber_cache;
+    size_t fiber_cache_size = g_scheduler_fiber_cache->getValue();
 
     FiberAndThread ft;
+    ThreadContext* ctx = static_cast<ThreadContext*>(t_thread_context);
+    uint64_t tick = 0;
+    ThreadStats local_stats;
+    ThreadStats& stats = ctx ? ctx->stats : local_stats;
+    //弹性线程会退出,回调任务不使用需要绑定线程的共享栈
+    bool elastic = ctx && ctx->elastic;
+    uint64_t spawn_wait_us = m_elastic.spawnWaitMs * 1000ull;
+    bool busy = false;
 
     while(true) {
+        onTaskLoop();
         ft.reset();
         bool tickle_me = false;
         bool is_active = false;
-        {
-            MutexType::Lock lock(m_mutex);
-            auto it = m_fibers.begin();
-            while(it != m_fibers.end()) {
-                //如果任务绑定了特定线程且当前线程不匹配，跳过该任务
-                if(it->thread != -1 && it->thread != Sylar::GetThreadId()) {
-                    ++it;
-                    tickle_me = true;
+        //绑定到本线程的任务只会出现在本线程的信箱中,优先处理
+        if(ctx && ctx->pinnedSize > 0) {
+            ThreadContext::MutexType::Lock lock(ctx->mutex);
+            size_t n = ctx->pinned.size();
+            for(size_t i = 0; i < n; ++i) {
+                FiberAndThread& front = ctx->pinned.front();
+                //协程可能还没有在原线程上完成切出,放到信箱尾部稍后再执行
+                if(front.fiber && front.fiber->getState() == Fiber::EXEC) {
+                    FiberAndThread tmp(std::move(front));
+                    ctx->pinned.pop_front();
+                    ctx->pinned.push_back(std::move(tmp));
                     continue;
                 }
-
-                SYLAR_ASSERT(it->fiber || it->cb);
-                //如果任务是协程且状态位EXEC,跳过该任务
-                if(it->fiber && it->fiber->getState() == Fiber::EXEC) {
-                    ++it;
-                    continue;
-                }
-                //如果找到了可执行任务，将其从队列中移除，并标记为活跃任务
-                ft = *it;
-                m_fibers.erase(it++);
+                ft = std::move(front);
+                ctx->pinned.pop_front();
                 ++m_activeThreadCount;
+                --m_pinnedTaskCount;
                 is_active = true;
                 break;
             }
-            tickle_me |= it != m_fibers.end();
+            ctx->pinnedSize = ctx->pinned.size();
+        }
+        //共享队列中有高优先级或截止时间任务时先处理共享队列
+        bool global_first = m_urgentTaskCount > 0;
+        //优先从本地队列尾部取任务(LIFO),每61轮跳过一次本地队列,
+        //避免本地任务源源不断时共享队列中的任务被饿死
+        if(!is_active && ctx && !global_first && m_localTaskCount > 0 && (++tick % 61)) {
+            is_active = popLocal(ctx, ft);
+        }
+        if(!is_active) {
+            is_active = popGlobal(ft, tickle_me);
+        }
+        if(!is_active && ctx && global_first && m_localTaskCount > 0) {
+            is_active = popLocal(ctx, ft);
+        }
+        //本地队列和共享队列都没有任务时,从其他线程的本地队列窃取
+        if(!is_active && ctx && m_localTaskCount > 0) {
+            is_active = steal(ctx, ft);
+        }
+        //共享栈协程只能在绑定的线程上恢复,转投到该线程的信箱
+        if(ft.fiber && ft.fiber->getStackThread() != -1
+                && ft.fiber->getStackThread() != Sylar::GetThreadId()) {
+            schedule(ft.fiber, ft.fiber->getStackThread());
+            ft.reset();
+        }
+        //未绑定的共享栈协程不能绑定到会退出的弹性线程上,转投给第一个常驻线程
+        if(ft.fiber && elastic && ft.fiber->isSharedStack()
+                && ft.fiber->getStackThread() == -1) {
+            schedule(ft.fiber, m_threadContexts[0]->threadId);
+            ft.reset();
+        }
+        //本地队列中的协程可能仍在其他线程上执行(尚未完成切出),放回共享队列稍后再执行
+        if(ft.fiber && ft.fiber->getState() == Fiber::EXEC) {
+            {
+                MutexType::Lock lock(m_mutex);
+                pushGlobalNoLock(std::move(ft));
+            }
+            ft.reset();
+            tickle_me = true;
         }
 
         if(tickle_me) {
             tickle();
         }
+        uint64_t start_us = 0;
+        if(ft.fiber || ft.cb) {
+            start_us = Sylar::GetCurrentUS();
+            busy = true;
+            if(ft.enqueueUs) {
+                uint64_t wait_us = Elapsed(ft.enqueueUs, start_us);
+                stats.queueWait.add(wait_us);
+                if(wait_us >= spawn_wait_us && !m_elasticThreads.empty()) {
+                    maybeSpawnThread();
+                }
+            }
+        }
         //如果任务是协程，调用其swapIn()方法切换到协程执行
         if(ft.fiber && (ft.fiber->getState() != Fiber::TERM
                         && ft.fiber->getState() != Fiber::EXCEPT)) {
+            if(ctx) {
+                ctx->beginRun(ft.fiber->getId(), start_us);
+            }
+            Fiber::BeginTimeSlice();
             ft.fiber->swapIn();
+            Fiber::EndTimeSlice();
+            if(ctx) {
+                ctx->endRun();
+            }
             --m_activeThreadCount;
+            stats.runTime.add(Elapsed(start_us, Sylar::GetCurrentUS()));
+            stats.switches.add();
             //如果协程状态位Ready,重新加入任务队列
             if(ft.fiber->getState() == Fiber::READY) {
-                schedule(ft.fiber);
+                reschedule(ctx, ft.fiber);
             } else if(ft.fiber->getState() != Fiber::TERM
                     && ft.fiber->getState() != Fiber::EXCEPT) {
                 ft.fiber->m_state = Fiber::HOLD;
+            } else if(ft.fiber.use_count() == 1
+                    && ft.fiber->isSharedStack() == (m_sharedStack && !elastic)
+                    && fiber_cache.size() < fiber_cache_size) {
+                fiber_cache.push_back(ft.fiber);
             }
             ft.reset();
+        } else if(ft.cb && InlineTask::Is(ft.cb)) {
+            //不会让出的短任务直接在调度协程上执行,省去协程切换
+            TaskFunction cb(std::move(ft.cb));
+            ft.reset();
+            if(ctx) {
+                ctx->beginRun(0, start_us);
+            }
+            runInline(cb);
+            if(ctx) {
+                ctx->endRun();
+            }
+            --m_activeThreadCount;
+            stats.runTime.add(Elapsed(start_us, Sylar::GetCurrentUS()));
+            stats.inlineTasks.add();
         } else if(ft.cb) {
             //如果任务是回调函数，将其包装为协程后执行
             if(cb_fiber) {
-                cb_fiber->reset(ft.cb);
+                cb_fiber->reset(std::move(ft.cb));
+            } else if(!fiber_cache.empty()) {
+                cb_fiber = fiber_cache.back();
+                fiber_cache.pop_back();
+                cb_fiber->reset(std::move(ft.cb));
             } else {
-                cb_fiber.reset(new Fiber(ft.cb));
+                cb_fiber.reset(new Fiber(std::move(ft.cb), 0, false, m_sharedStack && !elastic));
             }
+            cb_fiber->setPriority(ft.priority);
             ft.reset();
+            if(ctx) {
+                ctx->beginRun(cb_fiber->getId(), start_us);
+            }
+            Fiber::BeginTimeSlice();
             cb_fiber->swapIn();
+            Fiber::EndTimeSlice();
+            if(ctx) {
+                ctx->endRun();
+            }
             --m_activeThreadCount;
+            stats.runTime.add(Elapsed(start_us, Sylar::GetCurrentUS()));
+            stats.switches.add();
             if(cb_fiber->getState() == Fiber::READY) {
-                schedule(cb_fiber);
+                reschedule(ctx, cb_fiber);
                 cb_fiber.reset();
             } else if(cb_fiber->getState() == Fiber::EXCEPT
                     || cb_fiber->getState() == Fiber::TERM) {
-                cb_fiber->reset(nullptr);
+                //回调中通过Fiber::GetThis()留存了协程(如等待join)时不能复用,否则状态被重置为INIT
+                if(cb_fiber.use_count() == 1) {
+                    cb_fiber->reset(nullptr);
+                } else {
+                    cb_fiber.reset();
+                }
             } else {//if(cb_fiber->getState() != Fiber::TERM) {
                 cb_fiber->m_state = Fiber::HOLD;
                 cb_fiber.reset();
@@ -224,8 +436,23 @@ namespace Sylar{
             }
 
             ++m_idleThreadCount;
+            if(ctx) {
+                ctx->idle = true;
+            }
+            uint64_t idle_begin = Sylar::GetCurrentUS();
+            stats.idleSince.store(idle_begin, std::memory_order_relaxed);
+            if(elastic && busy) {
+                ctx->lastBusyUs = idle_begin;
+                busy = false;
+            }
             idle_fiber->swapIn();
+            if(ctx) {
+                ctx->idle = false;
+                ctx->woken = false;
+            }
             --m_idleThreadCount;
+            stats.idleSince.store(0, std::memory_order_relaxed);
+            stats.idleUs.add(Elapsed(idle_begin, Sylar::GetCurrentUS()));
             if(idle_fiber->getState() != Fiber::TERM
                     && idle_fiber->getState() != Fiber::EXCEPT) {
                 idle_fiber->m_state = Fiber::HOLD;
@@ -238,15 +465,453 @@ void Scheduler::tickle() {
     SYLAR_LOG_INFO(g_logger) << "tickle";
 }
 
+void Scheduler::tickleThread(ThreadContext* /*ctx*/) {
+    tickle();
+}
+
 bool Scheduler::stopping() {
     MutexType::Lock lock(m_mutex);
     return m_autoStop && m_stopping
-        && m_fibers.empty() && m_activeThreadCount == 0;
+        && m_globalTaskCount == 0 && m_localTaskCount == 0
+        && m_pinnedTaskCount == 0 && m_activeThreadCount == 0;
+}
+
+bool Scheduler::hasLocalTask() {
+    ThreadContext* ctx = static_cast<ThreadContext*>(t_thread_context);
+    if(t_scheduler != this || !ctx) {
+        return false;
+    }
+    return ctx->pinnedSize > 0 || ctx->size > 0;
+}
+
+bool Scheduler::hasPendingTask() {
+    return hasLocalTask() || m_globalTaskCount > 0
+        || (m_workStealing && m_localTaskCount > 0);
+}
+
+bool Scheduler::shouldRetire() {
+    ThreadContext* ctx = static_cast<ThreadContext*>(t_thread_context);
+    if(t_scheduler != this || !ctx || !ctx->elastic || m_stopping) {
+        return false;
+    }
+    if(Elapsed(ctx->lastBusyUs, Sylar::GetCurrentUS()) < m_elastic.idleMs * 1000ull) {
+        return false;
+    }
+    //信箱和本地队列为空时摘除线程id,之后投递给本线程的任务转为普通任务
+    ThreadContext::MutexType::Lock lock(ctx->mutex);
+    if(!ctx->pinned.empty() || !ctx->tasks.empty()) {
+        return false;
+    }
+    ctx->threadId = -1;
+    SYLAR_LOG_INFO(g_logger) << m_name << " elastic thread " << Sylar::GetThreadId()
+        << " retire, threads=" << getThreadCount() - 1;
+    return true;
+}
+
+void Scheduler::maybeSpawnThread() {
+    if(m_stopping || hasIdleThreads()
+            || m_elasticThreadCount >= m_elasticThreads.size()) {
+        return;
+    }
+    //两次增加线程至少间隔spawnWaitMs,给新线程消化积压的时间
+    uint64_t now = NowUs();
+    uint64_t last = m_lastSpawnUs;
+    if(Elapsed(last, now) < m_elastic.spawnWaitMs * 1000ull
+            || !m_lastSpawnUs.compare_exchange_strong(last, now)) {
+        return;
+    }
+    MutexType::Lock lock(m_mutex);
+    if(m_stopping) {
+        return;
+    }
+    size_t base = m_threadContexts.size() - m_elasticThreads.size();
+    for(size_t i = 0; i < m_elasticThreads.size(); ++i) {
+        ThreadContext* ctx = m_threadContexts[base + i];
+        if(ctx->active) {
+            continue;
+        }
+        //槽位上已退出的线程在释放锁后再回收,join期间不阻塞其他线程
+        Thread::ptr old;
+        old.swap(m_elasticThreads[i]);
+        ctx->active = true;
+        ctx->lastBusyUs = Sylar::GetCurrentUS();
+        ++m_elasticThreadCount;
+        ++m_spawnCount;
+        m_elasticThreads[i] = startThread(ctx, m_threadCount + i);
+        SYLAR_LOG_INFO(g_logger) << m_name << " elastic thread " << m_elasticThreads[i]->getId()
+            << " spawn, threads=" << getThreadCount();
+        lock.unlock();
+        if(old) {
+            old->join();
+        }
+        return;
+    }
+}
+
+Scheduler::ThreadContext* Scheduler::getThreadContext(int thread) {
+    ThreadContext* ctx = static_cast<ThreadContext*>(t_thread_context);
+    if(t_scheduler == this && ctx && ctx->threadId == thread) {
+        return ctx;
+    }
+    //线程数量固定且很少,顺序查找即可
+    for(auto i : m_threadContexts) {
+        if(i->threadId == thread) {
+            return i;
+        }
+    }
+    return nullptr;
+}
+
+Scheduler::ThreadContext* Scheduler::getCurrentContext() {
+    if(t_scheduler != this) {
+        return nullptr;
+    }
+    return static_cast<ThreadContext*>(t_thread_context);
+}
+
+Scheduler::ThreadStats* Scheduler::getThreadStats() {
+    ThreadContext* ctx = static_cast<ThreadContext*>(t_thread_context);
+    if(t_scheduler != this || !ctx) {
+        return nullptr;
+    }
+    return &ctx->stats;
+}
+
+uint64_t Scheduler::NowUs() {
+    return Sylar::GetCurrentUS();
+}
+
+uint64_t Scheduler::ThreadStats::getIdleUs() const {
+    uint64_t since = idleSince.load(std::memory_order_relaxed);
+    return idleUs.get() + (since ? Elapsed(since, Sylar::GetCurrentUS()) : 0);
+}
+
+void Scheduler::ThreadStats::merge(const ThreadStats& o) {
+    queueWait.merge(o.queueWait);
+    runTime.merge(o.runTime);
+    switches.add(o.switches.get());
+    inlineTasks.add(o.inlineTasks.get());
+    idleUs.add(o.getIdleUs());
+    wakeups.add(o.wakeups.get());
+    eventsPerWakeup.merge(o.eventsPerWakeup);
+    spinUs.add(o.spinUs.get());
+    spinHits.add(o.spinHits.get());
+    spinMisses.add(o.spinMisses.get());
+}
+
+std::ostream& Scheduler::ThreadStats::dump(std::ostream& os, const std::string& prefix) const {
+    os << prefix << "switches=" << switches.get()
+       << " inline_tasks=" << inlineTasks.get()
+       << " idle_ms=" << getIdleUs() / 1000
+       << " wakeups=" << wakeups.get();
+    if(spinHits.get() || spinMisses.get()) {
+        os << " spin_ms=" << spinUs.get() / 1000
+           << " spin_hits=" << spinHits.get()
+           << " spin_misses=" << spinMisses.get();
+    }
+    os << std::endl << prefix << "queue_wait_us: ";
+    queueWait.dump(os) << std::endl << prefix << "run_us: ";
+    runTime.dump(os) << std::endl << prefix << "events_per_wakeup: ";
+    return eventsPerWakeup.dump(os);
+}
+
+Scheduler::ThreadContext* Scheduler::getLocalContext() {
+    if(!m_workStealing || t_scheduler != this) {
+        return nullptr;
+    }
+    return static_cast<ThreadContext*>(t_thread_context);
+}
+
+void Scheduler::pushGlobalNoLock(FiberAndThread&& ft) {
+    //重新入队的任务也重新计时:各优先级队列按入队时间排列,队首才是最早的
+    ft.enqueueUs = Sylar::GetCurrentUS();
+    if(ft.deadline) {
+        m_deadlineFibers.push_back(std::move(ft));
+        std::push_heap(m_deadlineFibers.begin(), m_deadlineFibers.end(), &FiberAndThread::DeadlineLater);
+        ++m_urgentTaskCount;
+    } else {
+        if(ft.priority == PRIORITY_HIGH) {
+            ++m_urgentTaskCount;
+        }
+        m_fibers[ft.priority].push_back(std::move(ft));
+    }
+    ++m_globalTaskCount;
+}
+
+/**
+ * @brief 任务能否在当前线程上执行
+ */
+template<class T>
+static bool IsRunnable(const T& ft, int thread, bool& tickle_me) {
+    //如果任务绑定了特定线程且当前线程不匹配，跳过该任务
+    if(ft.thread != -1 && ft.thread != thread) {
+        tickle_me = true;
+        return false;
+    }
+    SYLAR_ASSERT(ft.fiber || ft.cb);
+    //如果任务是协程且状态位EXEC,跳过该任务
+    return !ft.fiber || ft.fiber->getState() != Fiber::EXEC;
+}
+
+bool Scheduler::popGlobal(FiberAndThread& ft, bool& tickle_me) {
+    if(m_globalTaskCount == 0) {
+        return false;
+    }
+    int thread = Sylar::GetThreadId();
+    MutexType::Lock lock(m_mutex);
+    //每个优先级队列内部按入队顺序排列,只需比较各队列中第一个可执行的任务
+    size_t best = 0;
+    int best_class = -1;
+    uint64_t best_key = 0;
+    for(int i = 0; i < PRIORITY_COUNT; ++i) {
+        RingQueue<FiberAndThread>& queue = m_fibers[i];
+        for(size_t x = 0; x < queue.size(); ++x) {
+            if(!IsRunnable(queue[x], thread, tickle_me)) {
+                continue;
+            }
+            uint64_t key = queue[x].enqueueUs + m_agingUs[i];
+            if(best_class == -1 || key < best_key) {
+                best = x;
+                best_class = i;
+                best_key = key;
+            }
+            break;
+        }
+    }
+    //堆顶通常可以执行;否则退化为线性查找最早的可执行任务
+    size_t dbest = m_deadlineFibers.size();
+    for(size_t x = 0; x < m_deadlineFibers.size(); ++x) {
+        if(IsRunnable(m_deadlineFibers[x], thread, tickle_me)
+                && (dbest == m_deadlineFibers.size()
+                    || m_deadlineFibers[x].deadline < m_deadlineFibers[dbest].deadline)) {
+            dbest = x;
+            if(x == 0) {
+                break;
+            }
+        }
+    }
+    int stats_index = best_class;
+    if(dbest != m_deadlineFibers.size()
+            && (best_class == -1 || m_deadlineFibers[dbest].deadline < best_key)) {
+        if(dbest == 0) {
+            std::pop_heap(m_deadlineFibers.begin(), m_deadlineFibers.end(), &FiberAndThread::DeadlineLater);
+            ft = std::move(m_deadlineFibers.back());
+            m_deadlineFibers.pop_back();
+        } else {
+            ft = std::move(m_deadlineFibers[dbest]);
+            m_deadlineFibers[dbest] = std::move(m_deadlineFibers.back());
+            m_deadlineFibers.pop_back();
+            std::make_heap(m_deadlineFibers.begin(), m_deadlineFibers.end(), &FiberAndThread::DeadlineLater);
+        }
+        stats_index = PRIORITY_COUNT;
+    } else if(best_class != -1) {
+        ft = std::move(m_fibers[best_class][best]);
+        m_fibers[best_class].erase(best);
+    } else {
+        return false;
+    }
+    ++m_activeThreadCount;
+    --m_globalTaskCount;
+    if(ft.deadline || ft.priority == PRIORITY_HIGH) {
+        --m_urgentTaskCount;
+    }
+    tickle_me |= m_globalTaskCount > 0;
+
+    uint64_t now = Sylar::GetCurrentUS();
+    uint64_t wait = now > ft.enqueueUs ? now - ft.enqueueUs : 0;
+    QueueStats& stats = m_queueStats[stats_index];
+    ++stats.count;
+    stats.waitUs += wait;
+    if(wait > stats.maxWaitUs) {
+        stats.maxWaitUs = wait;
+    }
+    if(ft.deadline && now > ft.deadline) {
+        ++stats.missed;
+    }
+    return true;
+}
+
+bool Scheduler::popLocal(ThreadContext* ctx, FiberAndThread& ft) {
+    ThreadContext::MutexType::Lock lock(ctx->mutex);
+    if(ctx->tasks.empty()) {
+        return false;
+    }
+    ft = std::move(ctx->tasks.back());
+    ctx->tasks.pop_back();
+    ctx->size = ctx->tasks.size();
+    ++m_activeThreadCount;
+    --m_localTaskCount;
+    return true;
+}
+
+bool Scheduler::steal(ThreadContext* self, FiberAndThread& ft) {
+    size_t n = m_threadContexts.size();
+    for(size_t i = 1; i <= n; ++i) {
+        ThreadContext* victim = m_threadContexts[(self->index + i) % n];
+        if(victim->size == 0) {
+            continue;
+        }
+        std::vector<FiberAndThread> batch;
+        {
+            ThreadContext::MutexType::Lock lock(victim->mutex);
+            if(victim->tasks.empty()) {
+                continue;
+            }
+            //从头部窃取(FIFO),顺带搬走剩余任务的一半,减少后续的窃取次数
+            ft = std::move(victim->tasks.front());
+            victim->tasks.pop_front();
+            ++m_activeThreadCount;
+            --m_localTaskCount;
+            if(victim != self) {
+                size_t count = victim->tasks.size() / 2;
+                batch.reserve(count);
+                for(size_t x = 0; x < count; ++x) {
+                    batch.push_back(std::move(victim->tasks.front()));
+                    victim->tasks.pop_front();
+                }
+            }
+            victim->size = victim->tasks.size();
+        }
+        if(!batch.empty()) {
+            ThreadContext::MutexType::Lock lock(self->mutex);
+            for(size_t x = batch.size(); x > 0; --x) {
+                self->tasks.push_front(std::move(batch[x - 1]));
+            }
+            self->size = self->tasks.size();
+        }
+        return true;
+    }
+    return false;
+}
+
+void Scheduler::runInline(TaskFunction& cb) {
+    Fiber::SetYieldable(false);
+    try {
+        cb();
+    } catch (std::exception& ex) {
+        SYLAR_LOG_ERROR(g_logger) << "InlineTask Except: " << ex.what()
+            << std::endl
+            << Sylar::BacktraceToString();
+    } catch (...) {
+        SYLAR_LOG_ERROR(g_logger) << "InlineTask Except"
+            << std::endl
+            << Sylar::BacktraceToString();
+    }
+    Fiber::SetYieldable(true);
+    cb = nullptr;
+}
+
+/**
+ * @brief 让工作线程采集自身调用栈的信号
+ * @details SIGURG已被IOManager用于定向唤醒且在空闲线程等待前屏蔽,这里使用实时信号
+ */
+static int BacktraceSignal() {
+    return SIGRTMIN + 1;
+}
+
+namespace {
+
+/**
+ * @brief 首次开启信号采集时安装信号处理函数
+ * @details 预先调用一次::backtrace,让libgcc在信号处理函数之外完成加载
+ */
+struct BacktraceSignalIniter {
+    BacktraceSignalIniter(void (*handler)(int)) {
+        void* frames[1];
+        ::backtrace(frames, 1);
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = handler;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(BacktraceSignal(), &sa, nullptr);
+    }
+};
+
+}
+
+void Scheduler::OnBacktraceSignal(int /*sig*/) {
+    int saved_errno = errno;
+    ThreadContext* ctx = static_cast<ThreadContext*>(t_thread_context);
+    if(ctx) {
+        int n = ::backtrace(ctx->frames, sizeof(ctx->frames) / sizeof(ctx->frames[0]));
+        ctx->frameCount.store(n, std::memory_order_release);
+    }
+    errno = saved_errno;
+}
+
+size_t Scheduler::checkLongRunning(uint64_t now_us, uint64_t budget_us) {
+    bool capture = g_watchdog_signal_backtrace->getValue();
+    if(capture) {
+        static BacktraceSignalIniter s_initer(&Scheduler::OnBacktraceSignal);
+    }
+    size_t reported = 0;
+    for(auto ctx : m_threadContexts) {
+        uint64_t since = ctx->runningSince.load(std::memory_order_acquire);
+        if(!since || since == ctx->reportedSince
+                || Elapsed(since, now_us) < budget_us) {
+            continue;
+        }
+        ctx->reportedSince = since;
+        uint64_t fiber_id = ctx->runningFiber.load(std::memory_order_relaxed);
+
+        //在任务仍在运行时采集调用栈,最多等待10ms
+        std::string bt;
+        ctx->frameCount.store(-1, std::memory_order_relaxed);
+        int rt = -1;
+        if(capture) {
+            //持锁发送,弹性线程退出时在同一把锁下清除pthread
+            ThreadContext::MutexType::Lock lock(ctx->mutex);
+            if(ctx->pthread) {
+                rt = pthread_kill(ctx->pthread, BacktraceSignal());
+            }
+        }
+        if(rt == 0) {
+            for(int i = 0; i < 100 && ctx->frameCount.load(std::memory_order_acquire) < 0; ++i) {
+                usleep(100);
+            }
+            int n = ctx->frameCount.load(std::memory_order_acquire);
+            if(n > 0 && ctx->runningSince.load(std::memory_order_acquire) == since) {
+                //跳过信号处理函数和信号跳板两层
+                bt = BacktraceToString(ctx->frames + std::min(n, 2), n - std::min(n, 2), "    ");
+            }
+        }
+        ++m_longRunningCount;
+        ++reported;
+        SYLAR_LOG_WARN(g_logger) << "fiber running too long: scheduler=" << m_name
+            << " thread=" << ctx->threadId
+            << " fiber_id=" << fiber_id
+            << (fiber_id ? "" : "(inline task)")
+            << " running_ms=" << Elapsed(since, now_us) / 1000
+            << " budget_ms=" << budget_us / 1000
+            << std::endl << (bt.empty() ? "    <backtrace unavailable>\n" : bt);
+    }
+    return reported;
+}
+
+void Scheduler::reschedule(ThreadContext* ctx, Fiber::ptr fiber) {
+    if(!ctx || !m_workStealing || fiber->getStackThread() != -1
+            || ResolvePriority(fiber, PRIORITY_DEFAULT) != PRIORITY_NORMAL) {
+        schedule(fiber);
+        return;
+    }
+    //让出的协程放到本地队列头部,排在已有任务之后执行,也最先被其他线程窃取
+    bool need_tickle = false;
+    {
+        ThreadContext::MutexType::Lock lock(ctx->mutex);
+        need_tickle = ctx->tasks.empty() && hasIdleThreads();
+        ctx->tasks.push_front(FiberAndThread(fiber, -1));
+        ctx->size = ctx->tasks.size();
+        ++m_localTaskCount;
+    }
+    if(need_tickle) {
+        tickle();
+    }
 }
 
 void Scheduler::idle() {
     SYLAR_LOG_INFO(g_logger) << "idle";
-    while(!stopping()) {
+    while(!stopping() && !shouldRetire()) {
         Sylar::Fiber::YieldToHold();
     }
 }
@@ -265,9 +930,25 @@ void Scheduler::switchTo(int thread) {
 std::ostream& Scheduler::dump(std::ostream& os) {
     os << "[Scheduler name=" << m_name
        << " size=" << m_threadCount
+       << " threads=" << getThreadCount();
+    if(!m_elasticThreads.empty()) {
+        os << " min_threads=" << m_threadCount
+           << " max_threads=" << m_threadCount + m_elasticThreads.size()
+           << " elastic_spawned=" << m_spawnCount
+           << " elastic_retired=" << m_retireCount;
+    }
+    os
        << " active_count=" << m_activeThreadCount
        << " idle_count=" << m_idleThreadCount
-       << " stopping=" << m_stopping
+       << " work_stealing=" << m_workStealing
+       << " local_tasks=" << m_localTaskCount
+       << " pinned_tasks=" << m_pinnedTaskCount
+       << " shared_stack=" << m_sharedStack
+       << " stopping=" << m_stopping;
+    if(!m_affinity.empty()) {
+        os << " affinity=(" << m_affinity.toString() << ")";
+    }
+    os
        << " ]" << std::endl << "    ";
     for(size_t i = 0; i < m_threadIds.size(); ++i) {
         if(i) {
@@ -275,6 +956,34 @@ std::ostream& Scheduler::dump(std::ostream& os) {
         }
         os << m_threadIds[i];
     }
+    static const char* s_queue_names[PRIORITY_COUNT + 1] = {"high", "normal", "low", "deadline"};
+    {
+        MutexType::Lock lock(m_mutex);
+        for(int i = 0; i <= PRIORITY_COUNT; ++i) {
+            const QueueStats& stats = m_queueStats[i];
+            os << std::endl << "    " << s_queue_names[i]
+               << ": depth=" << (i < PRIORITY_COUNT ? m_fibers[i].size() : m_deadlineFibers.size())
+               << " dispatched=" << stats.count
+               << " avg_wait_us=" << (stats.count ? stats.waitUs / stats.count : 0)
+               << " max_wait_us=" << stats.maxWaitUs;
+            if(i == PRIORITY_COUNT) {
+                os << " missed=" << stats.missed;
+            }
+        }
+    }
+    os << std::endl << "    tickles=" << m_tickleCount
+       << " tickle_coalesced=" << m_tickleCoalesced
+       << " tickle_targeted=" << m_tickleTargeted
+       << " long_running=" << m_longRunningCount;
+    //各线程的统计只由所属线程写入,这里无锁读取并汇总
+    ThreadStats total;
+    for(auto i : m_threadContexts) {
+        os << std::endl << "    thread " << i->threadId << (i->elastic ? " elastic" : "") << ":" << std::endl;
+        i->stats.dump(os, "        ");
+        total.merge(i->stats);
+    }
+    os << std::endl << "    total:" << std::endl;
+    total.dump(os, "        ");
     return os;
 }
 
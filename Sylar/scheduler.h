@@ -11,13 +11,29 @@
 
 #include <memory>
 #include <vector>
-#include <list>
 #include <iostream>
+#include <type_traits>
 #include "fiber.h"
 #include "thread.h"
+#include "histogram.h"
+#include "ring_queue.h"
 
 namespace Sylar {
 
+/**
+ * @brief 调度器弹性线程数配置
+ * @details 构造时的线程数为最少线程数。任务排队等待超过spawnWaitMs且没有空闲线程时
+ *          增加一个线程,直到maxThreads;增加的线程连续空闲超过idleMs后退出
+ */
+struct ElasticConfig {
+    /// 最多线程数(与构造函数的threads含义相同),不大于threads时关闭弹性模式
+    size_t maxThreads = 0;
+    /// 触发增加线程的排队等待时间(毫秒)
+    uint32_t spawnWaitMs = 50;
+    /// 增加的线程空闲多久后退出(毫秒)
+    uint32_t idleMs = 30000;
+};
+
 /**
  * @brief 协程调度器
  * @details 封装的是N-M的协程调度器
@@ -28,13 +44,36 @@ public:
     using ptr=std::shared_ptr<Scheduler>;
     using MutexType=Mutex;
 
+    /**
+     * @brief 任务优先级
+     * @details 每个优先级相当于一个相对截止时间(见 scheduler.aging.* 配置),
+     *          run()总是挑选截止时间最早的任务,等待足够久的低优先级任务会排到高优先级任务前面,不会被饿死。
+     *          回调任务所在的协程继承任务的优先级,之后被IO事件等再次调度时沿用
+     */
+    enum Priority {
+        /// 协程沿用Fiber::getPriority(),回调任务为NORMAL
+        PRIORITY_DEFAULT = -1,
+        /// 延迟敏感的任务,如请求处理
+        PRIORITY_HIGH = 0,
+        /// 普通任务
+        PRIORITY_NORMAL = 1,
+        /// 批处理等后台任务
+        PRIORITY_LOW = 2,
+        /// 优先级数量
+        PRIORITY_COUNT = 3
+    };
+
     /**
      * @brief 构造函数
      * @param[in] threads 线程数量
      * @param[in] use_caller 是否使用当前调用线程
      * @param[in] name 协程调度器名称
+     * @param[in] affinity 工作线程的CPU/NUMA绑定,不作用于use_caller的调用线程
+     * @param[in] elastic 弹性线程数配置,默认线程数固定
      */
-    Scheduler(size_t threads = 1, bool use_caller = true, const std::string& name = "");
+    Scheduler(size_t threads = 1, bool use_caller = true, const std::string& name = ""
+              ,const CpuAffinity& affinity = CpuAffinity()
+              ,const ElasticConfig& elastic = ElasticConfig());
 
     /**
      * @brief 析构函数
@@ -70,32 +109,48 @@ public:
      * @brief 调度协程
      * @param[in] fc 协程或函数
      * @param[in] thread 协程执行的线程id,-1标识任意线程
+     * @param[in] priority 优先级,绑定线程的任务按投递顺序执行,忽略优先级
      */
     template<class FiberOrCb>
-    void schedule(FiberOrCb fc, int thread = -1) {
-        bool need_tickle = false;
-        {
-            MutexType::Lock lock(m_mutex);
-            need_tickle = scheduleNoLock(fc, thread);
-        }
+    void schedule(FiberOrCb fc, int thread = -1, Priority priority = PRIORITY_DEFAULT) {
+        int p = ResolvePriority(fc, priority);
+        scheduleImpl(std::move(fc), thread, p, 0);
+    }
 
-        if(need_tickle) {
-            tickle();
-        }
+    /**
+     * @brief 按截止时间调度协程
+     * @details 与各优先级的任务一起按截止时间先后执行
+     * @param[in] fc 协程或函数
+     * @param[in] deadline_ms 绝对截止时间(Sylar::GetCurrentMS())
+     * @param[in] thread 协程执行的线程id,-1标识任意线程
+     */
+    template<class FiberOrCb>
+    void scheduleDeadline(FiberOrCb fc, uint64_t deadline_ms, int thread = -1) {
+        int p = ResolvePriority(fc, PRIORITY_DEFAULT);
+        scheduleImpl(std::move(fc), thread, p, deadline_ms ? deadline_ms * 1000 : 1);
     }
 
     /**
      * @brief 批量调度协程
+     * @details 只加一次锁,元素中的协程/回调被移走
      * @param[in] begin 协程数组的开始
      * @param[in] end 协程数组的结束
      */
     template<class InputIterator>
     void schedule(InputIterator begin, InputIterator end) {
         bool need_tickle = false;
-        {
+        ThreadContext* ctx = getLocalContext();
+        if(ctx) {
+            ThreadContext::MutexType::Lock lock(ctx->mutex);
+            while(begin != end) {
+                need_tickle = scheduleLocalNoLock(ctx, &*begin) || need_tickle;
+                ++begin;
+            }
+        } else {
             MutexType::Lock lock(m_mutex);
             while(begin != end) {
-                need_tickle = scheduleNoLock(&*begin, -1) || need_tickle;
+                need_tickle = scheduleNoLock(&*begin, -1
+                            , ResolvePriority(&*begin, PRIORITY_DEFAULT), 0) || need_tickle;
                 ++begin;
             }
         }
@@ -105,13 +160,73 @@ public:
     }
 
     void switchTo(int thread = -1);
-    std::ostream& dump(std::ostream& os);
+    virtual std::ostream& dump(std::ostream& os);
+
+    /**
+     * @brief 设置是否开启工作窃取模式
+     * @details 开启后,工作线程内提交的任务进入该线程的本地队列(LIFO执行),
+     *          空闲线程从其他线程本地队列的另一端窃取(FIFO),
+     *          跨线程提交的任务仍然进入共享的注入队列
+     */
+    void setWorkStealing(bool v) { m_workStealing = v;}
+
+    /**
+     * @brief 是否开启工作窃取模式
+     */
+    bool isWorkStealing() const { return m_workStealing;}
+
+    /**
+     * @brief 设置回调任务是否运行在共享栈协程上
+     * @details 适合大量长期挂起的连接,CPU密集的调度器应保持独立栈
+     */
+    void setSharedStack(bool v) { m_sharedStack = v;}
+
+    /**
+     * @brief 回调任务是否运行在共享栈协程上
+     */
+    bool isSharedStack() const { return m_sharedStack;}
+
+    /**
+     * @brief 返回工作线程的CPU/NUMA绑定
+     */
+    const CpuAffinity& getCpuAffinity() const { return m_affinity;}
+
+    /**
+     * @brief 返回弹性线程数配置
+     */
+    const ElasticConfig& getElasticConfig() const { return m_elastic;}
+
+    /**
+     * @brief 返回当前的工作线程数(包括弹性增加的线程)
+     */
+    size_t getThreadCount() const { return m_threadCount + m_elasticThreadCount;}
+
+    /**
+     * @brief 检查连续运行超过预算的任务,输出其协程id和调用栈
+     * @details 由Watchdog线程周期调用。每次连续运行只报告一次,
+     *          调用栈通过信号让工作线程在自身栈上采集,可用fiber.watchdog.signal_backtrace关闭。
+     *          安装处理函数时先调用一次::backtrace完成libgcc的加载,处理函数中不再有非异步信号安全的操作;
+     *          信号以SA_RESTART安装,被打断的系统调用自动重启
+     * @param[in] now_us 当前时间(微秒)
+     * @param[in] budget_us 单次运行的时间预算(微秒)
+     * @return 本次报告的任务数
+     */
+    size_t checkLongRunning(uint64_t now_us, uint64_t budget_us);
 protected:
+    struct ThreadContext;
+
     /**
      * @brief 通知协程调度器有任务了
      */
 
     virtual void tickle();
+
+    /**
+     * @brief 通知指定的工作线程有绑定给它的任务了
+     * @details 默认实现退化为tickle()
+     */
+    virtual void tickleThread(ThreadContext* ctx);
+
     /**
      * @brief 协程调度函数
      */
@@ -127,6 +242,12 @@ protected:
      */
     virtual void idle();
 
+    /**
+     * @brief 调度循环每次取任务之前调用
+     * @details 处理本线程上不能等到空闲时才处理的事件,默认不做任何事
+     */
+    virtual void onTaskLoop() {}
+
     /**
      * @brief 设置当前的协程调度器
      */
@@ -136,30 +257,175 @@ protected:
      * @brief 是否有空闲线程
      */
     bool hasIdleThreads() { return m_idleThreadCount > 0;}
+
+    /**
+     * @brief 当前线程的信箱或本地队列中是否还有任务
+     * @details idle在进入等待前调用,避免错过投递给本线程的任务
+     */
+    bool hasLocalTask();
+
+    /**
+     * @brief 是否有本线程可以取到的任务(信箱、本地队列、共享队列,开启工作窃取时包括其他线程的本地队列)
+     * @details 只读计数不加锁,用于idle忙轮询时判断是否回到调度循环
+     */
+    bool hasPendingTask();
+
+    /**
+     * @brief 当前线程是否应作为空闲的弹性线程退出
+     * @details idle在每次等待结束后调用,返回true时idle应返回,线程随之退出
+     */
+    bool shouldRetire();
+
+    /**
+     * @brief 返回当前线程在本调度器中的上下文
+     * @return 当前线程不属于本调度器时返回nullptr
+     */
+    ThreadContext* getCurrentContext();
+
+    /**
+     * @brief 返回所有工作线程上下文(构造时分配,下标即ThreadContext::index)
+     */
+    const std::vector<ThreadContext*>& getThreadContexts() const { return m_threadContexts;}
 private:
+    /**
+     * @brief 调度协程
+     * @param[in] priority 已确定的优先级
+     * @param[in] deadline_us 绝对截止时间(微秒),0表示按优先级调度
+     */
+    template<class FiberOrCb>
+    void scheduleImpl(FiberOrCb&& fc, int thread, int priority, uint64_t deadline_us) {
+        bool need_tickle = false;
+        thread = GetStackThread(fc, thread);
+        if(thread != -1) {
+            //绑定线程的任务直接投递到目标线程的信箱,只唤醒该线程
+            ThreadContext* target = getThreadContext(thread);
+            if(target) {
+                bool pinned = false;
+                {
+                    ThreadContext::MutexType::Lock lock(target->mutex);
+                    //弹性线程可能已经退出,此时按未绑定的任务调度
+                    if(target->threadId == thread) {
+                        need_tickle = schedulePinnedNoLock(target, std::forward<FiberOrCb>(fc), priority);
+                        pinned = true;
+                    }
+                }
+                if(pinned) {
+                    if(need_tickle) {
+                        tickleThread(target);
+                    }
+                    return;
+                }
+                thread = -1;
+            }
+        }
+        //只有普通优先级的任务进入本地队列,其余任务进入共享队列参与排序
+        ThreadContext* ctx = (thread == -1 && priority == PRIORITY_NORMAL && !deadline_us)
+                                ? getLocalContext() : nullptr;
+        if(ctx) {
+            ThreadContext::MutexType::Lock lock(ctx->mutex);
+            need_tickle = scheduleLocalNoLock(ctx, std::forward<FiberOrCb>(fc));
+        } else {
+            MutexType::Lock lock(m_mutex);
+            need_tickle = scheduleNoLock(std::forward<FiberOrCb>(fc), thread, priority, deadline_us);
+        }
+
+        if(need_tickle) {
+            tickle();
+        }
+    }
+
     /**
      * @brief 协程调度启动(无锁)
      */
     template<class FiberOrCb>
-    bool scheduleNoLock(FiberOrCb fc, int thread) {
-        bool need_tickle = m_fibers.empty();
-        FiberAndThread ft(fc, thread);
+    bool scheduleNoLock(FiberOrCb&& fc, int thread, int priority, uint64_t deadline_us) {
+        bool need_tickle = m_globalTaskCount == 0;
+        FiberAndThread ft(std::forward<FiberOrCb>(fc), thread);
         if(ft.fiber || ft.cb) {
-            m_fibers.push_back(ft);
+            ft.priority = priority;
+            ft.deadline = deadline_us;
+            pushGlobalNoLock(std::move(ft));
         }
         return need_tickle;
     }
+
+    /**
+     * @brief 协程调度到线程本地队列(需持有ctx->mutex)
+     * @return 是否需要唤醒空闲线程来窃取
+     */
+    template<class FiberOrCb>
+    bool scheduleLocalNoLock(ThreadContext* ctx, FiberOrCb&& fc) {
+        bool need_tickle = ctx->tasks.empty() && hasIdleThreads();
+        FiberAndThread ft(std::forward<FiberOrCb>(fc), -1);
+        if(ft.fiber || ft.cb) {
+            ft.enqueueUs = NowUs();
+            ctx->tasks.push_back(std::move(ft));
+            ctx->size = ctx->tasks.size();
+            ++m_localTaskCount;
+        }
+        return need_tickle;
+    }
+
+    /**
+     * @brief 协程调度到指定线程的信箱(需持有ctx->mutex)
+     * @return 目标线程是否处于空闲状态,需要唤醒
+     */
+    template<class FiberOrCb>
+    bool schedulePinnedNoLock(ThreadContext* ctx, FiberOrCb&& fc, int priority) {
+        FiberAndThread ft(std::forward<FiberOrCb>(fc), ctx->threadId);
+        if(!ft.fiber && !ft.cb) {
+            return false;
+        }
+        ft.priority = priority;
+        ft.enqueueUs = NowUs();
+        ctx->pinned.push_back(std::move(ft));
+        ctx->pinnedSize = ctx->pinned.size();
+        ++m_pinnedTaskCount;
+        return ctx->idle;
+    }
+
+    /**
+     * @brief 返回当前线程在本调度器中的本地队列
+     * @return 未开启工作窃取或当前线程不属于本调度器时返回nullptr
+     */
+    ThreadContext* getLocalContext();
+
+    /**
+     * @brief 根据线程id返回工作线程上下文
+     * @return 线程不属于本调度器时返回nullptr
+     */
+    ThreadContext* getThreadContext(int thread);
 private:
     /**
      * @brief 协程/函数/线程组
+     * @details 只能移动,回调存放在TaskFunction中,小的回调不申请堆内存
      */
     struct FiberAndThread {
         /// 协程
         Fiber::ptr fiber;
         /// 协程执行函数
-        std::function<void()> cb;
+        TaskFunction cb;
         /// 线程id
         int thread;
+        /// 优先级
+        int priority = PRIORITY_NORMAL;
+        /// 绝对截止时间(微秒),0表示按优先级调度
+        uint64_t deadline = 0;
+        /// 入队时间(微秒)
+        uint64_t enqueueUs = 0;
+
+        /**
+         * @brief 是否是按回调构造的参数类型
+         */
+        template<class F>
+        struct IsCallback {
+            typedef typename std::decay<F>::type type;
+            static const bool value = !std::is_same<type, Fiber::ptr>::value
+                && !std::is_same<type, Fiber::ptr*>::value
+                && !std::is_same<type, std::function<void()>*>::value
+                && !std::is_same<type, TaskFunction*>::value
+                && !std::is_same<type, FiberAndThread>::value;
+        };
 
         /**
          * @brief 构造函数
@@ -167,7 +433,7 @@ private:
          * @param[in] thr 线程id
          */
         FiberAndThread(Fiber::ptr f, int thr)
-            :fiber(f), thread(thr) {
+            :fiber(std::move(f)), thread(thr) {
         }
 
         /**
@@ -183,11 +449,12 @@ private:
 
         /**
          * @brief 构造函数
-         * @param[in] f 协程执行函数
+         * @param[in] f 协程执行函数(lambda、std::bind、std::function等)
          * @param[in] thr 线程id
          */
-        FiberAndThread(std::function<void()> f, int thr)
-            :cb(f), thread(thr) {
+        template<class F, class = typename std::enable_if<IsCallback<F>::value>::type>
+        FiberAndThread(F&& f, int thr)
+            :cb(std::forward<F>(f)), thread(thr) {
         }
 
         /**
@@ -197,8 +464,18 @@ private:
          * @post *f = nullptr
          */
         FiberAndThread(std::function<void()>* f, int thr)
-            :thread(thr) {
-            cb.swap(*f);
+            :cb(std::move(*f)), thread(thr) {
+            *f = nullptr;
+        }
+
+        /**
+         * @brief 构造函数
+         * @param[in] f 协程执行函数指针
+         * @param[in] thr 线程id
+         * @post *f 为空
+         */
+        FiberAndThread(TaskFunction* f, int thr)
+            :cb(std::move(*f)), thread(thr) {
         }
 
         /**
@@ -208,6 +485,16 @@ private:
             :thread(-1) {
         }
 
+        FiberAndThread(FiberAndThread&&) = default;
+        FiberAndThread& operator=(FiberAndThread&&) = default;
+
+        /**
+         * @brief 截止时间堆的比较函数,截止时间最早的在堆顶
+         */
+        static bool DeadlineLater(const FiberAndThread& a, const FiberAndThread& b) {
+            return a.deadline > b.deadline;
+        }
+
         /**
          * @brief 重置数据
          */
@@ -215,19 +502,274 @@ private:
             fiber = nullptr;
             cb = nullptr;
             thread = -1;
+            priority = PRIORITY_NORMAL;
+            deadline = 0;
+            enqueueUs = 0;
+        }
+    };
+
+protected:
+    /**
+     * @brief 工作线程的运行统计
+     * @details 只由所属线程写入,dump时汇总,不会在调度路径上引入锁或原子读改写
+     */
+    struct ThreadStats {
+        /// 任务在队列中的等待时间(微秒)
+        Histogram queueWait;
+        /// 任务每次执行(切入到切出)的时间(微秒)
+        Histogram runTime;
+        /// 切入任务协程的次数
+        StatCounter switches;
+        /// 在调度协程上直接执行的InlineTask数量
+        StatCounter inlineTasks;
+        /// 已结束的空闲时间(微秒)
+        StatCounter idleUs;
+        /// 当前这次空闲的开始时间(微秒),不在空闲中时为0
+        std::atomic<uint64_t> idleSince = {0};
+        /// epoll_wait返回的次数
+        StatCounter wakeups;
+        /// 每次epoll_wait返回的IO事件数
+        Histogram eventsPerWakeup;
+        /// 忙轮询的时间(微秒,包含在空闲时间内)
+        StatCounter spinUs;
+        /// 忙轮询期间等到IO事件或任务的次数
+        StatCounter spinHits;
+        /// 忙轮询预算用完仍转入阻塞等待的次数
+        StatCounter spinMisses;
+
+        /**
+         * @brief 返回累计空闲时间(微秒),包括正在进行的这次空闲
+         */
+        uint64_t getIdleUs() const;
+
+        /**
+         * @brief 把o的数据累加到当前统计
+         */
+        void merge(const ThreadStats& o);
+
+        /**
+         * @brief 输出统计
+         * @param[in] prefix 每行的前缀
+         */
+        std::ostream& dump(std::ostream& os, const std::string& prefix) const;
+    };
+
+    /**
+     * @brief 工作线程上下文
+     * @details 每个工作线程独占一个本地双端队列,
+     *          线程自身从尾部压入/弹出(LIFO),其他线程从头部窃取(FIFO);
+     *          绑定到该线程的任务投递到独立的信箱,不参与窃取
+     */
+    struct ThreadContext {
+        using MutexType=Spinlock;
+
+        /// 本地队列和信箱的锁(几乎只有所属线程访问,窃取/投递时才有竞争)
+        MutexType mutex;
+        /// 本地任务队列
+        RingQueue<FiberAndThread> tasks;
+        /// 本地任务队列长度(无锁读取,用于窃取前快速跳过空队列)
+        std::atomic<size_t> size = {0};
+        /// 绑定到该线程的任务信箱(FIFO)
+        RingQueue<FiberAndThread> pinned;
+        /// 信箱长度(无锁读取)
+        std::atomic<size_t> pinnedSize = {0};
+        /// 是否处于idle状态
+        std::atomic<bool> idle = {false};
+        /// 是否已被定向唤醒且尚未回到调度循环(用于合并重复的唤醒)
+        std::atomic<bool> woken = {false};
+        /// 所属线程id
+        std::atomic<int> threadId = {-1};
+        /// 所属线程
+        pthread_t pthread = 0;
+        /// 在m_threadContexts中的下标
+        size_t index = 0;
+        /// 运行统计
+        ThreadStats stats;
+        /// 是否为弹性模式下按需增加的线程
+        bool elastic = false;
+        /// 弹性线程是否正在运行
+        std::atomic<bool> active = {false};
+        /// 弹性线程最近一次执行完任务进入空闲的时间(微秒)
+        uint64_t lastBusyUs = 0;
+        /// 当前任务开始运行的时间(微秒),0表示没有在运行任务
+        std::atomic<uint64_t> runningSince = {0};
+        /// 当前运行的协程id,InlineTask为0
+        std::atomic<uint64_t> runningFiber = {0};
+        /// Watchdog已报告过的runningSince(只由Watchdog线程访问)
+        uint64_t reportedSince = 0;
+        /// 信号处理函数采集的调用栈
+        void* frames[64];
+        /// 采集到的层数,-1表示尚未采集完成
+        std::atomic<int> frameCount = {-1};
+
+        /**
+         * @brief 记录开始运行任务
+         */
+        void beginRun(uint64_t fiber_id, uint64_t now_us) {
+            runningFiber.store(fiber_id, std::memory_order_relaxed);
+            runningSince.store(now_us, std::memory_order_release);
+        }
+
+        /**
+         * @brief 记录任务运行结束
+         */
+        void endRun() {
+            runningSince.store(0, std::memory_order_relaxed);
         }
     };
+
+    /**
+     * @brief 返回当前线程的运行统计
+     * @return 当前线程不属于本调度器时返回nullptr
+     */
+    ThreadStats* getThreadStats();
+    /**
+     * @brief 共享队列中各类任务的统计
+     */
+    struct QueueStats {
+        /// 已出队执行的任务数
+        uint64_t count = 0;
+        /// 累计等待时间(微秒)
+        uint64_t waitUs = 0;
+        /// 最大等待时间(微秒)
+        uint64_t maxWaitUs = 0;
+        /// 出队时已超过截止时间的任务数
+        uint64_t missed = 0;
+    };
+private:
+    /**
+     * @brief 任务放入共享队列(需持有m_mutex)
+     * @details 记录入队时间,重新入队的任务排到队尾并重新计算等待时间
+     */
+    void pushGlobalNoLock(FiberAndThread&& ft);
+
+    /**
+     * @brief 从共享队列取出截止时间最早的可执行任务
+     * @param[out] ft 取出的任务
+     * @param[out] tickle_me 队列中是否还有需要其他线程处理的任务
+     * @return 是否取到任务
+     */
+    bool popGlobal(FiberAndThread& ft, bool& tickle_me);
+
+    /**
+     * @brief 从当前线程本地队列尾部取任务
+     */
+    bool popLocal(ThreadContext* ctx, FiberAndThread& ft);
+
+    /**
+     * @brief 从其他线程的本地队列窃取任务
+     * @param[in] self 当前线程的本地队列
+     * @param[out] ft 窃取到的任务
+     * @return 是否窃取成功
+     */
+    bool steal(ThreadContext* self, FiberAndThread& ft);
+
+    /**
+     * @brief 将让出(READY)的任务重新放回队列
+     */
+    void reschedule(ThreadContext* ctx, Fiber::ptr fiber);
+
+    /**
+     * @brief 在调度协程上直接执行InlineTask
+     */
+    void runInline(TaskFunction& cb);
+
+    /**
+     * @brief 调用栈采集信号的处理函数,在被检查的工作线程上执行
+     */
+    static void OnBacktraceSignal(int sig);
+
+    /**
+     * @brief 任务排队过久时按需增加弹性线程
+     */
+    void maybeSpawnThread();
+
+    /**
+     * @brief 启动工作线程
+     * @param[in] ctx 线程使用的上下文
+     * @param[in] index 线程序号,用于CPU绑定和线程名
+     */
+    Thread::ptr startThread(ThreadContext* ctx, size_t index);
+
+    /**
+     * @brief 返回当前时间(微秒),用于记录任务入队时间
+     */
+    static uint64_t NowUs();
+
+    /**
+     * @brief 共享栈协程只能在绑定的线程上恢复,返回它应投递的线程
+     */
+    static int GetStackThread(const Fiber::ptr& f, int thread) {
+        int t = f ? f->getStackThread() : -1;
+        return t == -1 ? thread : t;
+    }
+
+    static int GetStackThread(Fiber::ptr* f, int thread) {
+        return GetStackThread(*f, thread);
+    }
+
+    template<class T>
+    static int GetStackThread(const T&, int thread) {
+        return thread;
+    }
+
+    /**
+     * @brief 确定任务的优先级,未指定时协程沿用上次执行时的优先级
+     */
+    static int ResolvePriority(const Fiber::ptr& f, int priority) {
+        if(priority == PRIORITY_DEFAULT && f) {
+            priority = f->getPriority();
+        }
+        return priority < 0 || priority >= PRIORITY_COUNT ? PRIORITY_NORMAL : priority;
+    }
+
+    static int ResolvePriority(Fiber::ptr* f, int priority) {
+        return ResolvePriority(*f, priority);
+    }
+
+    template<class T>
+    static int ResolvePriority(const T&, int priority) {
+        return priority < 0 || priority >= PRIORITY_COUNT ? PRIORITY_NORMAL : priority;
+    }
 private:
     /// Mutex
     MutexType m_mutex;
     /// 线程池
     std::vector<Thread::ptr> m_threads;
-    /// 待执行的协程队列
-    std::list<FiberAndThread> m_fibers;
+    /// 待执行的协程队列,每个优先级一个FIFO
+    RingQueue<FiberAndThread> m_fibers[PRIORITY_COUNT];
+    /// 按截止时间调度的任务(以截止时间为键的小顶堆)
+    std::vector<FiberAndThread> m_deadlineFibers;
+    /// 各优先级相对截止时间(微秒)
+    uint64_t m_agingUs[PRIORITY_COUNT];
+    /// 各优先级及截止时间任务(下标PRIORITY_COUNT)的统计
+    QueueStats m_queueStats[PRIORITY_COUNT + 1];
+    /// 共享队列中的任务总数
+    std::atomic<size_t> m_globalTaskCount = {0};
+    /// 共享队列中高优先级和截止时间任务的数量,不为0时先于本地队列处理
+    std::atomic<size_t> m_urgentTaskCount = {0};
     /// use_caller为true时有效, 调度协程
     Fiber::ptr m_rootFiber;
     /// 协程调度器名称
     std::string m_name;
+    /// 各工作线程的上下文(构造时分配,运行期间不变)
+    std::vector<ThreadContext*> m_threadContexts;
+    /// 本地队列中的任务总数
+    std::atomic<size_t> m_localTaskCount = {0};
+    /// 各线程信箱中的任务总数
+    std::atomic<size_t> m_pinnedTaskCount = {0};
+    /// 是否开启工作窃取模式
+    bool m_workStealing = false;
+    /// 回调任务是否使用共享栈协程
+    bool m_sharedStack = false;
+    /// 工作线程的CPU/NUMA绑定
+    CpuAffinity m_affinity;
+    /// 弹性线程数配置
+    ElasticConfig m_elastic;
+    /// 弹性线程,与m_threadContexts末尾的弹性上下文一一对应,已退出的线程在复用槽位时join
+    std::vector<Thread::ptr> m_elasticThreads;
+    /// 最近一次增加线程的时间(微秒),用于限制增加速度
+    std::atomic<uint64_t> m_lastSpawnUs = {0};
 protected:
     /// 协程下的线程id数组
     std::vector<int> m_threadIds;
@@ -237,6 +779,20 @@ protected:
     std::atomic<size_t> m_activeThreadCount = {0};
     /// 空闲线程数量
     std::atomic<size_t> m_idleThreadCount = {0};
+    /// 实际发出的唤醒次数(tickle可能来自任意线程,按调度器汇总)
+    std::atomic<uint64_t> m_tickleCount = {0};
+    /// 因已有未处理的唤醒而合并掉的唤醒次数
+    std::atomic<uint64_t> m_tickleCoalesced = {0};
+    /// 定向唤醒指定线程的次数
+    std::atomic<uint64_t> m_tickleTargeted = {0};
+    /// 正在运行的弹性线程数
+    std::atomic<size_t> m_elasticThreadCount = {0};
+    /// 累计增加的弹性线程数
+    std::atomic<uint64_t> m_spawnCount = {0};
+    /// 累计退出的弹性线程数
+    std::atomic<uint64_t> m_retireCount = {0};
+    /// Watchdog报告的超时运行次数
+    std::atomic<uint64_t> m_longRunningCount = {0};
     /// 是否正在停止
     bool m_stopping = true;
     /// 是否自动停止
@@ -69,7 +69,7 @@ Socket::~Socket() {
 }
 
 int64_t Socket::getSendTimeout() {
-    FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+    FdCtx* ctx = FdMgr::GetInstance()->get(m_sock);
     if(ctx) {
         return ctx->getTimeout(SO_SNDTIMEO);
     }
@@ -82,7 +82,7 @@ void Socket::setSendTimeout(int64_t v) {
 }
 
 int64_t Socket::getRecvTimeout() {
-    FdCtx::ptr ctx = FdMgr::GetInstance()->get(m_sock);
+    FdCtx* ctx = FdMgr::GetInstance()->get(m_sock);
     if(ctx) {
         return ctx->getTimeout(SO_RCVTIMEO);
     }
@@ -143,8 +143,13 @@ Socket::ptr Socket::accept() {
     return nullptr;
 }
 
+bool Socket::attach(int sock) {
+    FdMgr::GetInstance()->get(sock, true);
+    return init(sock);
+}
+
 bool Socket::init(int sock) {
-    FdCtx::ptr ctx = FdMgr::GetInstance()->get(sock);
+    FdCtx* ctx = FdMgr::GetInstance()->get(sock);
     if(ctx && ctx->isSocket() && !ctx->isClose()) {
         m_sock = sock;
         m_isConnected = true;
@@ -159,6 +159,14 @@ public:
      */
     virtual Socket::ptr accept();
 
+    /**
+     * @brief 用已建立连接的socket句柄初始化
+     * @details 供不经过hook的接入路径使用(如协程接口),会登记到FdManager并设置为非阻塞
+     * @param[in] sock socket句柄
+     * @return 是否成功
+     */
+    bool attach(int sock);
+
     /**
      * @brief 绑定地址
      * @param[in] addr 地址
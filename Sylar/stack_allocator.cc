@@ -0,0 +1,284 @@
+#include "stack_allocator.h"
+#include "config.h"
+#include "log.h"
+#include "macro.h"
+#include "mutex.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+#include <new>
+
+namespace Sylar {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<std::string>::ptr g_fiber_stack_allocator =
+    Config::Lookup<std::string>("fiber.stack_allocator", "mmap", "fiber stack allocator, mmap or malloc");
+
+static ConfigVar<uint32_t>::ptr g_fiber_stack_thread_cache =
+    Config::Lookup<uint32_t>("fiber.stack_pool.thread_cache", 64, "max cached fiber stacks per thread");
+
+static ConfigVar<uint32_t>::ptr g_fiber_stack_global_cache =
+    Config::Lookup<uint32_t>("fiber.stack_pool.global_cache", 1024, "max cached fiber stacks shared by all threads");
+
+static ConfigVar<bool>::ptr g_fiber_stack_huge_page =
+    Config::Lookup<bool>("fiber.stack_pool.huge_page", false, "use transparent huge pages for fiber stacks");
+
+static size_t GetPageSize() {
+    static size_t s_page_size = sysconf(_SC_PAGESIZE);
+    return s_page_size;
+}
+
+static size_t RoundUpToPage(size_t size) {
+    size_t page = GetPageSize();
+    return (size + page - 1) / page * page;
+}
+
+void* MallocStackAllocator::alloc(size_t size) {
+    return malloc(size);
+}
+
+void MallocStackAllocator::dealloc(void* vp, size_t size) {
+    free(vp);
+}
+
+namespace {
+
+struct StackNode {
+    void* sp;
+    size_t size;
+};
+
+struct GlobalStackPool {
+    Spinlock mutex;
+    std::vector<StackNode> stacks;
+};
+
+/**
+ * @brief 全局空闲链表,故意不释放,避免静态析构顺序问题
+ */
+GlobalStackPool& GetGlobalPool() {
+    static GlobalStackPool* s_pool = new GlobalStackPool;
+    return *s_pool;
+}
+
+struct ThreadStackCache {
+    std::vector<StackNode> stacks;
+};
+
+static std::atomic<uint64_t> s_mapped_count {0};
+static std::atomic<uint64_t> s_global_cached_count {0};
+
+void UnmapStack(void* sp, size_t size) {
+    size_t page = GetPageSize();
+    if(munmap((char*)sp - page, size + page)) {
+        SYLAR_LOG_ERROR(g_logger) << "munmap(" << sp << ", " << size
+            << ") errno=" << errno << " errstr=" << strerror(errno);
+    }
+    --s_mapped_count;
+}
+
+bool PopStack(std::vector<StackNode>& stacks, size_t size, void*& sp) {
+    for(size_t i = stacks.size(); i > 0; --i) {
+        if(stacks[i - 1].size == size) {
+            sp = stacks[i - 1].sp;
+            stacks[i - 1] = stacks.back();
+            stacks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+static thread_local ThreadStackCache* t_stack_cache = nullptr;
+/// 线程退出后不再使用线程缓存,直接走全局链表
+static thread_local bool t_stack_cache_dead = false;
+
+/**
+ * @brief 线程退出时释放线程缓存的栈
+ */
+struct ThreadStackCacheHolder {
+    ~ThreadStackCacheHolder() {
+        if(t_stack_cache) {
+            for(auto& i : t_stack_cache->stacks) {
+                UnmapStack(i.sp, i.size);
+            }
+            delete t_stack_cache;
+            t_stack_cache = nullptr;
+        }
+        t_stack_cache_dead = true;
+    }
+};
+
+static thread_local ThreadStackCacheHolder t_stack_cache_holder;
+
+ThreadStackCache* GetThreadCache() {
+    if(t_stack_cache_dead) {
+        return nullptr;
+    }
+    if(!t_stack_cache) {
+        (void)&t_stack_cache_holder;
+        t_stack_cache = new ThreadStackCache;
+    }
+    return t_stack_cache;
+}
+
+}
+
+MmapStackAllocator::MmapStackAllocator(size_t thread_cache, size_t global_cache, bool huge_page)
+    :m_threadCache(thread_cache)
+    ,m_globalCache(global_cache)
+    ,m_hugePage(huge_page) {
+}
+
+void* MmapStackAllocator::map(size_t size) {
+    size_t page = GetPageSize();
+    void* base = mmap(nullptr, size + page, PROT_READ | PROT_WRITE
+                    , MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if(base == MAP_FAILED) {
+        SYLAR_LOG_ERROR(g_logger) << "mmap fiber stack size=" << size
+            << " errno=" << errno << " errstr=" << strerror(errno);
+        throw std::bad_alloc();
+    }
+    //栈向低地址增长,保护页放在最低处
+    if(mprotect(base, page, PROT_NONE)) {
+        SYLAR_LOG_ERROR(g_logger) << "mprotect guard page errno=" << errno
+            << " errstr=" << strerror(errno);
+    }
+#ifdef MADV_HUGEPAGE
+    if(m_hugePage) {
+        madvise((char*)base + page, size, MADV_HUGEPAGE);
+    }
+#endif
+    ++s_mapped_count;
+    return (char*)base + page;
+}
+
+void* MmapStackAllocator::alloc(size_t size) {
+    size = RoundUpToPage(size);
+    void* sp = nullptr;
+    ThreadStackCache* cache = GetThreadCache();
+    if(cache && PopStack(cache->stacks, size, sp)) {
+        return sp;
+    }
+    if(s_global_cached_count > 0) {
+        GlobalStackPool& pool = GetGlobalPool();
+        Spinlock::Lock lock(pool.mutex);
+        if(PopStack(pool.stacks, size, sp)) {
+            --s_global_cached_count;
+            return sp;
+        }
+    }
+    return map(size);
+}
+
+void MmapStackAllocator::dealloc(void* vp, size_t size) {
+    if(!vp) {
+        return;
+    }
+    size = RoundUpToPage(size);
+    ThreadStackCache* cache = GetThreadCache();
+    if(cache && cache->stacks.size() < m_threadCache) {
+        cache->stacks.push_back({vp, size});
+        return;
+    }
+    if(s_global_cached_count < m_globalCache) {
+        //进入全局链表的栈短期内不一定被复用,先归还物理页
+        madvise(vp, size, MADV_DONTNEED);
+        GlobalStackPool& pool = GetGlobalPool();
+        Spinlock::Lock lock(pool.mutex);
+        pool.stacks.push_back({vp, size});
+        ++s_global_cached_count;
+        return;
+    }
+    UnmapStack(vp, size);
+}
+
+uint64_t MmapStackAllocator::GetMappedCount() {
+    return s_mapped_count;
+}
+
+uint64_t MmapStackAllocator::GetGlobalCachedCount() {
+    return s_global_cached_count;
+}
+
+static std::atomic<StackAllocator*> s_default_allocator {nullptr};
+
+/**
+ * @brief 持有所有设置过的分配器,保证存量协程归还栈时分配器仍然有效
+ */
+static std::vector<StackAllocator::ptr>& GetAllocatorHolder() {
+    static std::vector<StackAllocator::ptr>* s_holder = new std::vector<StackAllocator::ptr>;
+    return *s_holder;
+}
+
+static Mutex& GetAllocatorMutex() {
+    static Mutex* s_mutex = new Mutex;
+    return *s_mutex;
+}
+
+void StackAllocator::SetDefault(StackAllocator::ptr v) {
+    Mutex::Lock lock(GetAllocatorMutex());
+    GetAllocatorHolder().push_back(v);
+    s_default_allocator = v.get();
+}
+
+static StackAllocator::ptr CreateFromConfig() {
+    if(g_fiber_stack_allocator->getValue() == "malloc") {
+        return std::make_shared<MallocStackAllocator>();
+    }
+    if(g_fiber_stack_allocator->getValue() != "mmap") {
+        SYLAR_LOG_ERROR(g_logger) << "invalid fiber.stack_allocator="
+            << g_fiber_stack_allocator->getValue() << ", use mmap";
+    }
+    return std::make_shared<MmapStackAllocator>(g_fiber_stack_thread_cache->getValue()
+                    ,g_fiber_stack_global_cache->getValue()
+                    ,g_fiber_stack_huge_page->getValue());
+}
+
+namespace {
+
+struct StackAllocatorIniter {
+    StackAllocatorIniter() {
+        StackAllocator::SetDefault(CreateFromConfig());
+        g_fiber_stack_allocator->addListener([](const std::string& old_value, const std::string& new_value){
+            SYLAR_LOG_INFO(g_logger) << "fiber stack allocator changed from "
+                                     << old_value << " to " << new_value;
+            StackAllocator::SetDefault(CreateFromConfig());
+        });
+        g_fiber_stack_thread_cache->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            MmapStackAllocator* a = dynamic_cast<MmapStackAllocator*>(StackAllocator::GetDefault());
+            if(a) {
+                a->setThreadCache(new_value);
+            }
+        });
+        g_fiber_stack_global_cache->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            MmapStackAllocator* a = dynamic_cast<MmapStackAllocator*>(StackAllocator::GetDefault());
+            if(a) {
+                a->setGlobalCache(new_value);
+            }
+        });
+        g_fiber_stack_huge_page->addListener([](const bool& old_value, const bool& new_value){
+            MmapStackAllocator* a = dynamic_cast<MmapStackAllocator*>(StackAllocator::GetDefault());
+            if(a) {
+                a->setHugePage(new_value);
+            }
+        });
+    }
+};
+
+}
+
+StackAllocator* StackAllocator::GetDefault() {
+    StackAllocator* rt = s_default_allocator;
+    if(SYLAR_LIKELY(rt)) {
+        return rt;
+    }
+    static StackAllocatorIniter s_initer;
+    return s_default_allocator;
+}
+
+}
@@ -0,0 +1,121 @@
+/**
+ * @file stack_allocator.h
+ * @brief 协程栈分配器
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_STACK_ALLOCATOR_H__
+#define __SYLAR_STACK_ALLOCATOR_H__
+
+#include <memory>
+#include <string>
+#include <atomic>
+#include <stddef.h>
+
+namespace Sylar {
+
+/**
+ * @brief 协程栈分配器基类
+ * @details 通过 SetDefault 替换全局默认分配器即可接入自定义实现,
+ *          已设置过的分配器不会被释放,保证存量协程可以正确归还栈
+ */
+class StackAllocator {
+public:
+    using ptr = std::shared_ptr<StackAllocator>;
+
+    virtual ~StackAllocator() {}
+
+    /**
+     * @brief 分配协程栈
+     * @param[in] size 栈大小
+     * @return 栈的起始地址(低地址)
+     */
+    virtual void* alloc(size_t size) = 0;
+
+    /**
+     * @brief 归还协程栈
+     * @param[in] vp alloc返回的地址
+     * @param[in] size alloc时的栈大小
+     */
+    virtual void dealloc(void* vp, size_t size) = 0;
+
+    /**
+     * @brief 返回分配器名称
+     */
+    virtual std::string getName() const = 0;
+
+    /**
+     * @brief 返回默认分配器,由配置 fiber.stack_allocator 决定
+     */
+    static StackAllocator* GetDefault();
+
+    /**
+     * @brief 设置默认分配器
+     */
+    static void SetDefault(StackAllocator::ptr v);
+};
+
+/**
+ * @brief 使用malloc/free的协程栈分配器
+ */
+class MallocStackAllocator : public StackAllocator {
+public:
+    void* alloc(size_t size) override;
+    void dealloc(void* vp, size_t size) override;
+    std::string getName() const override { return "malloc";}
+};
+
+/**
+ * @brief 基于mmap的协程栈池
+ * @details 每个栈底部多映射一页 PROT_NONE 的保护页,栈溢出直接触发SIGSEGV,
+ *          不再悄悄破坏堆内存。释放的栈优先放入线程本地空闲链表,
+ *          满了再放入全局空闲链表,都满了才munmap。
+ */
+class MmapStackAllocator : public StackAllocator {
+public:
+    using ptr = std::shared_ptr<MmapStackAllocator>;
+
+    /**
+     * @brief 构造函数
+     * @param[in] thread_cache 每个线程最多缓存的栈数量
+     * @param[in] global_cache 全局最多缓存的栈数量
+     * @param[in] huge_page 是否对栈开启透明大页
+     */
+    MmapStackAllocator(size_t thread_cache, size_t global_cache, bool huge_page);
+
+    void* alloc(size_t size) override;
+    void dealloc(void* vp, size_t size) override;
+    std::string getName() const override { return "mmap";}
+
+    void setThreadCache(size_t v) { m_threadCache = v;}
+    void setGlobalCache(size_t v) { m_globalCache = v;}
+    void setHugePage(bool v) { m_hugePage = v;}
+
+    /**
+     * @brief 返回当前已映射(含缓存中)的栈数量
+     */
+    static uint64_t GetMappedCount();
+
+    /**
+     * @brief 返回全局空闲链表中的栈数量
+     */
+    static uint64_t GetGlobalCachedCount();
+private:
+    /**
+     * @brief 映射一个新的栈
+     */
+    void* map(size_t size);
+private:
+    /// 每个线程最多缓存的栈数量
+    std::atomic<size_t> m_threadCache;
+    /// 全局最多缓存的栈数量
+    std::atomic<size_t> m_globalCache;
+    /// 是否开启透明大页
+    std::atomic<bool> m_hugePage;
+};
+
+}
+
+#endif
@@ -2,11 +2,18 @@
 #include "Sylar/util.h"
 #include "Sylar/log.h"
 #include "Sylar/macro.h"
+#include "Sylar/config.h"
 
 namespace Sylar {
 
 static Sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static Sylar::ConfigVar<uint32_t>::ptr g_async_stream_queue_size =
+    Sylar::Config::Lookup("async_socket_stream.queue_size", (uint32_t)4096, "async socket stream send queue size");
+
+static Sylar::ConfigVar<uint32_t>::ptr g_async_stream_send_batch =
+    Sylar::Config::Lookup("async_socket_stream.send_batch", (uint32_t)64, "async socket stream max contexts sent per wakeup");
+
 AsyncSocketStream::Ctx::Ctx()
     :sn(0)
     ,timeout(0)
@@ -37,6 +44,7 @@ void AsyncSocketStream::Ctx::doRsp() {
 AsyncSocketStream::AsyncSocketStream(Socket::ptr sock, bool owner)
     :SocketStream(sock, owner)
     ,m_waitSem(2)
+    ,m_queue(g_async_stream_queue_size->getValue())
     ,m_sn(0)
     ,m_autoConnect(false)
     ,m_iomanager(nullptr)
@@ -77,6 +85,7 @@ bool AsyncSocketStream::start() {
             }
         }
 
+        m_queue.reopen();
         startRead();
         startWrite();
         return true;
@@ -117,14 +126,14 @@ void AsyncSocketStream::doRead() {
 
 void AsyncSocketStream::doWrite() {
     try {
+        size_t batch = g_async_stream_send_batch->getValue();
+        std::vector<SendCtx::ptr> ctxs;
+        auto self = shared_from_this();
         while(isConnected()) {
-            m_sem.wait();
-            std::list<SendCtx::ptr> ctxs;
-            {
-                RWMutexType::WriteLock lock(m_queueMutex);
-                m_queue.swap(ctxs);
+            ctxs.clear();
+            if(!m_queue.recvBatch(ctxs, batch)) {
+                break;
             }
-            auto self = shared_from_this();
             for(auto& i : ctxs) {
                 if(!i->doSend(self)) {
                     innerClose();
@@ -136,10 +145,7 @@ void AsyncSocketStream::doWrite() {
         //TODO log
     }
     SYLAR_LOG_DEBUG(g_logger) << "doWrite out " << this;
-    {
-        RWMutexType::WriteLock lock(m_queueMutex);
-        m_queue.clear();
-    }
+    m_queue.clear();
     m_waitSem.notify();
 }
 
@@ -185,14 +191,12 @@ bool AsyncSocketStream::addCtx(Ctx::ptr ctx) {
 
 bool AsyncSocketStream::enqueue(SendCtx::ptr ctx) {
     SYLAR_ASSERT(ctx);
-    RWMutexType::WriteLock lock(m_queueMutex);
-    bool empty = m_queue.empty();
-    m_queue.push_back(ctx);
-    lock.unlock();
-    if(empty) {
-        m_sem.notify();
-    }
-    return empty;
+    return m_queue.send(std::move(ctx));
+}
+
+bool AsyncSocketStream::tryEnqueue(SendCtx::ptr ctx) {
+    SYLAR_ASSERT(ctx);
+    return m_queue.trySend(ctx);
 }
 
 bool AsyncSocketStream::innerClose() {
@@ -201,16 +205,14 @@ bool AsyncSocketStream::innerClose() {
         m_disconnectCb(shared_from_this());
     }
     SocketStream::close();
-    m_sem.notify();
+    //关闭发送队列以唤醒写协程,并让后续的enqueue失败
+    m_queue.close();
     std::unordered_map<uint32_t, Ctx::ptr> ctxs;
     {
         RWMutexType::WriteLock lock(m_mutex);
         ctxs.swap(m_ctxs);
     }
-    {
-        RWMutexType::WriteLock lock(m_queueMutex);
-        m_queue.clear();
-    }
+    m_queue.clear();
     for(auto& i : ctxs) {
         i.second->result = IO_ERROR;
         i.second->doRsp();
@@ -2,6 +2,7 @@
 #define __SYLAR_STREAMS_ASYNC_SOCKET_STREAM_H__
 
 #include "socket_stream.h"
+#include "Sylar/channel.h"
 #include <list>
 #include <unordered_map>
 #include <boost/any.hpp>
@@ -31,7 +32,8 @@ public:
         OK = 0,         ///< 操作成功
         TIMEOUT = -1,   ///< 操作超时
         IO_ERROR = -2,  ///< 输入输出错误
-        NOT_CONNECT = -3 ///< 未连接
+        NOT_CONNECT = -3, ///< 未连接
+        QUEUE_FULL = -4  ///< 发送队列已满
     };
 protected:
     /**
@@ -124,15 +126,22 @@ protected:
     }
 
     bool addCtx(Ctx::ptr ctx);
+    /**
+     * @brief 把发送上下文放入发送队列,队列满时挂起直到写协程腾出空位
+     * @return 连接已关闭返回false
+     */
     bool enqueue(SendCtx::ptr ctx);
+    /**
+     * @brief 非阻塞地把发送上下文放入发送队列,不会挂起当前协程
+     * @return 队列已满或连接已关闭返回false
+     */
+    bool tryEnqueue(SendCtx::ptr ctx);
 
     bool innerClose();
     bool waitFiber();
 protected:
-    Sylar::FiberSemaphore m_sem;        ///< 协程信号量
     Sylar::FiberSemaphore m_waitSem;    ///< 等待协程信号量
-    RWMutexType m_queueMutex;           ///< 队列互斥锁
-    std::list<SendCtx::ptr> m_queue;    ///< 发送上下文队列
+    Channel<SendCtx::ptr> m_queue;      ///< 发送上下文队列,连接关闭时关闭
     RWMutexType m_mutex;                ///< 互斥锁
     std::unordered_map<uint32_t, Ctx::ptr> m_ctxs; ///< 上下文映射表
 
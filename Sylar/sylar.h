@@ -12,13 +12,16 @@
 #include "address.h"
 #include "application.h"
 #include "bytearray.h"
+#include "channel.h"
 #include "config.h"
 #include "daemon.h"
 #include "endian.h"
 #include "env.h"
 #include "fd_manager.h"
 #include "fiber.h"
+#include "future.h"
 #include "hook.h"
+#include "io_uring.h"
 #include "iomanager.h"
 #include "library.h"
 #include "log.h"
@@ -36,6 +39,7 @@
 #include "timer.h"
 #include "uri.h"
 #include "util.h"
+#include "watchdog.h"
 #include "worker.h"
 
 #include "DataBase/database.h"
@@ -0,0 +1,245 @@
+/**
+ * @file task_function.h
+ * @brief 调度任务的回调类型
+ * @details TaskFunction 是只能移动的 void() 回调,小的可调用对象直接存放在对象内部,
+ *          调度捕获少量变量的lambda时不需要申请堆内存
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_TASK_FUNCTION_H__
+#define __SYLAR_TASK_FUNCTION_H__
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Sylar {
+
+class TaskFunction;
+
+/**
+ * @brief 不会让出的短任务
+ * @details 调度器识别到此类任务后直接在调度协程上执行,不创建协程也不切换上下文,
+ *          适合定时器回调、事件通知这类很快就结束的回调。
+ *          任务中不允许让出(包括会挂起协程的hook函数),debug模式下会断言
+ */
+class InlineTask {
+public:
+    InlineTask(std::function<void()> cb)
+        :m_cb(std::move(cb)) {
+    }
+
+    void operator()() const { m_cb();}
+
+    /**
+     * @brief 判断回调是否由InlineTask包装
+     */
+    static bool Is(const std::function<void()>& cb) {
+        return cb.target<InlineTask>() != nullptr;
+    }
+
+    /**
+     * @brief 判断回调是否由InlineTask包装
+     */
+    static bool Is(const TaskFunction& cb);
+private:
+    std::function<void()> m_cb;
+};
+
+/**
+ * @brief 只能移动的任务回调
+ * @details 不超过 INLINE_SIZE 且移动构造不抛异常的可调用对象存放在内部缓冲区,
+ *          更大的对象才在堆上分配
+ */
+class TaskFunction {
+public:
+    /// 内部缓冲区大小,能放下std::function或捕获若干指针/智能指针的lambda
+    static const size_t INLINE_SIZE = 48;
+
+    TaskFunction() {}
+
+    TaskFunction(std::nullptr_t) {}
+
+    /**
+     * @brief 从可调用对象构造
+     * @details 空的std::function和空函数指针构造出空的TaskFunction
+     */
+    template<class F, class = typename std::enable_if<
+            !std::is_same<typename std::decay<F>::type, TaskFunction>::value>::type>
+    TaskFunction(F&& f) {
+        typedef typename std::decay<F>::type Functor;
+        if(IsNull(f)) {
+            return;
+        }
+        m_inlineTask = IsInlineTask(f);
+        construct<Functor>(std::forward<F>(f), std::integral_constant<bool
+                , (sizeof(Functor) <= INLINE_SIZE
+                    && alignof(Functor) <= alignof(Storage)
+                    && std::is_nothrow_move_constructible<Functor>::value)>());
+    }
+
+    TaskFunction(TaskFunction&& oth) noexcept {
+        moveFrom(oth);
+    }
+
+    TaskFunction& operator=(TaskFunction&& oth) noexcept {
+        if(this != &oth) {
+            reset();
+            moveFrom(oth);
+        }
+        return *this;
+    }
+
+    TaskFunction& operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    TaskFunction(const TaskFunction&) = delete;
+    TaskFunction& operator=(const TaskFunction&) = delete;
+
+    ~TaskFunction() {
+        reset();
+    }
+
+    void operator()() {
+        m_ops->invoke(&m_storage);
+    }
+
+    explicit operator bool() const { return m_ops != nullptr;}
+
+    /**
+     * @brief 是否由InlineTask包装
+     */
+    bool isInlineTask() const { return m_inlineTask;}
+
+    /**
+     * @brief 释放持有的可调用对象
+     */
+    void reset() {
+        if(m_ops) {
+            m_ops->destroy(&m_storage);
+            m_ops = nullptr;
+            m_inlineTask = false;
+        }
+    }
+private:
+    typedef typename std::aligned_storage<INLINE_SIZE, alignof(std::max_align_t)>::type Storage;
+
+    struct Ops {
+        /// 调用
+        void (*invoke)(void* storage);
+        /// 移动到dst并析构src
+        void (*relocate)(void* dst, void* src);
+        /// 析构
+        void (*destroy)(void* storage);
+    };
+
+    /**
+     * @brief 存放在内部缓冲区的可调用对象
+     */
+    template<class Functor>
+    struct LocalOps {
+        static void invoke(void* p) {
+            (*static_cast<Functor*>(p))();
+        }
+
+        static void relocate(void* dst, void* src) {
+            Functor* f = static_cast<Functor*>(src);
+            new (dst) Functor(std::move(*f));
+            f->~Functor();
+        }
+
+        static void destroy(void* p) {
+            static_cast<Functor*>(p)->~Functor();
+        }
+
+        static const Ops* Get() {
+            static const Ops s_ops = {&invoke, &relocate, &destroy};
+            return &s_ops;
+        }
+    };
+
+    /**
+     * @brief 存放在堆上的可调用对象,内部缓冲区只保存指针
+     */
+    template<class Functor>
+    struct HeapOps {
+        static Functor*& ptr(void* p) {
+            return *static_cast<Functor**>(p);
+        }
+
+        static void invoke(void* p) {
+            (*ptr(p))();
+        }
+
+        static void relocate(void* dst, void* src) {
+            new (dst) Functor*(ptr(src));
+        }
+
+        static void destroy(void* p) {
+            delete ptr(p);
+        }
+
+        static const Ops* Get() {
+            static const Ops s_ops = {&invoke, &relocate, &destroy};
+            return &s_ops;
+        }
+    };
+
+    template<class Functor, class F>
+    void construct(F&& f, std::true_type) {
+        new (&m_storage) Functor(std::forward<F>(f));
+        m_ops = LocalOps<Functor>::Get();
+    }
+
+    template<class Functor, class F>
+    void construct(F&& f, std::false_type) {
+        new (&m_storage) Functor*(new Functor(std::forward<F>(f)));
+        m_ops = HeapOps<Functor>::Get();
+    }
+
+    void moveFrom(TaskFunction& oth) {
+        if(oth.m_ops) {
+            oth.m_ops->relocate(&m_storage, &oth.m_storage);
+            m_ops = oth.m_ops;
+            m_inlineTask = oth.m_inlineTask;
+            oth.m_ops = nullptr;
+            oth.m_inlineTask = false;
+        }
+    }
+
+    template<class F>
+    static bool IsNull(const F&) { return false;}
+
+    template<class R, class... Args>
+    static bool IsNull(R (*f)(Args...)) { return f == nullptr;}
+
+    static bool IsNull(const std::function<void()>& f) { return !f;}
+
+    template<class F>
+    static bool IsInlineTask(const F&) { return false;}
+
+    static bool IsInlineTask(const InlineTask&) { return true;}
+
+    static bool IsInlineTask(const std::function<void()>& f) { return InlineTask::Is(f);}
+private:
+    /// 内部缓冲区
+    Storage m_storage;
+    /// 可调用对象的操作表,为空表示没有可调用对象
+    const Ops* m_ops = nullptr;
+    /// 是否由InlineTask包装
+    bool m_inlineTask = false;
+};
+
+inline bool InlineTask::Is(const TaskFunction& cb) {
+    return cb.isInlineTask();
+}
+
+}
+
+#endif
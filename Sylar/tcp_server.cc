@@ -112,9 +112,11 @@ void TcpServer::startAccept(Socket::ptr sock) {
         Socket::ptr client = sock->accept();
         if(client) {
             client->setRecvTimeout(m_recvTimeout);
+            // 多reactor模式下连接在accept时分配给一个I/O线程，处理协程从一开始就在该线程上运行
+            int thread = m_ioWorker->assignFd(client->getSocket());
             // 将处理客户端连接的任务调度到 I/O 工作线程中执行
             m_ioWorker->schedule(std::bind(&TcpServer::handleClient,
-                        shared_from_this(), client));
+                        shared_from_this(), client), thread);
         } else {
             SYLAR_LOG_ERROR(g_logger) << "accept errno=" << errno
                 << " errstr=" << strerror(errno);
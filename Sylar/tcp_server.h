@@ -47,6 +47,8 @@ namespace Sylar{
     std::string io_worker;
     // 处理业务逻辑的工作协程名称
     std::string process_worker;
+    /// 优先使用绑定在该NUMA节点上的工作调度器实例,-1表示不限制
+    int numa_node = -1;
     std::map<std::string, std::string> args;
 
     bool isValid() const {
@@ -64,6 +66,7 @@ namespace Sylar{
             && accept_worker == oth.accept_worker
             && io_worker == oth.io_worker
             && process_worker == oth.process_worker
+            && numa_node == oth.numa_node
             && args == oth.args
             && id == oth.id
             && type == oth.type;
@@ -92,6 +95,7 @@ public:
         conf.accept_worker = node["accept_worker"].as<std::string>();
         conf.io_worker = node["io_worker"].as<std::string>();
         conf.process_worker = node["process_worker"].as<std::string>();
+        conf.numa_node = node["numa_node"].as<int>(conf.numa_node);
         conf.args = LexicalCast<std::string
             ,std::map<std::string, std::string> >()(node["args"].as<std::string>(""));
         if(node["address"].IsDefined()) {
@@ -124,6 +128,7 @@ public:
         node["accept_worker"] = conf.accept_worker;
         node["io_worker"] = conf.io_worker;
         node["process_worker"] = conf.process_worker;
+        node["numa_node"] = conf.numa_node;
         node["args"] = YAML::Load(LexicalCast<std::map<std::string, std::string>
             , std::string>()(conf.args));
         for(auto& i : conf.address) {
@@ -1,10 +1,19 @@
 #include"thread.h"                                             
 #include"log.h"
 #include"util.h"
+#include<sched.h>
+#include<string.h>
+#include<errno.h>
+#include<unistd.h>
+#include<sys/syscall.h>
+#include<linux/mempolicy.h>
+#include<fstream>
+#include<sstream>
 
 namespace Sylar {
     static thread_local Thread* t_thread = nullptr;
     static thread_local std::string t_thread_name = "UNKNOWN";
+    static thread_local int t_numa_node = -1;
 
     static Sylar::Logger::ptr g_logger=SYLAR_LOG_NAME("system");
 
@@ -86,4 +95,112 @@ void* Thread::run(void* arg) {
     return 0;
 }
 
-}
\ No newline at end of file
+std::string CpuAffinity::toString() const {
+    std::stringstream ss;
+    ss << "cpus=";
+    for(size_t i = 0; i < cpus.size(); ++i) {
+        size_t j = i;
+        while(j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            ++j;
+        }
+        if(i) {
+            ss << ",";
+        }
+        ss << cpus[i];
+        if(j != i) {
+            ss << "-" << cpus[j];
+        }
+        i = j;
+    }
+    ss << " numa=" << numaNode
+       << " per_thread=" << perThread;
+    return ss.str();
+}
+
+std::vector<int> CpuAffinity::ParseCpuList(const std::string& str) {
+    std::vector<int> cpus;
+    std::stringstream ss(str);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        int begin = -1;
+        int end = -1;
+        int n = sscanf(item.c_str(), "%d-%d", &begin, &end);
+        if(n <= 0 || begin < 0) {
+            continue;
+        }
+        if(n == 1) {
+            end = begin;
+        }
+        for(int i = begin; i <= end && i < CPU_SETSIZE; ++i) {
+            cpus.push_back(i);
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> CpuAffinity::GetNodeCpus(int node) {
+    if(node < 0) {
+        return std::vector<int>();
+    }
+    std::ifstream ifs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string line;
+    if(!ifs || !std::getline(ifs, line)) {
+        return std::vector<int>();
+    }
+    return ParseCpuList(line);
+}
+
+bool Thread::SetAffinity(const CpuAffinity& affinity, size_t index) {
+    bool ok = true;
+    std::vector<int> cpus = affinity.cpus;
+    if(cpus.empty() && affinity.numaNode >= 0) {
+        cpus = CpuAffinity::GetNodeCpus(affinity.numaNode);
+        if(cpus.empty()) {
+            SYLAR_LOG_ERROR(g_logger) << "numa node " << affinity.numaNode
+                << " has no cpus, thread " << t_thread_name << " not bound";
+            ok = false;
+        }
+    }
+    if(!cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if(affinity.perThread) {
+            CPU_SET(cpus[index % cpus.size()], &set);
+        } else {
+            for(auto& i : cpus) {
+                CPU_SET(i, &set);
+            }
+        }
+        int rt = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if(rt) {
+            SYLAR_LOG_ERROR(g_logger) << "pthread_setaffinity_np thread=" << t_thread_name
+                << " " << affinity.toString() << " rt=" << rt << " errstr=" << strerror(rt);
+            ok = false;
+        }
+    }
+    if(affinity.numaNode >= 0) {
+        //优先(而非强制)从本节点分配,本节点内存不足时仍可使用其他节点
+        const int bits = sizeof(unsigned long) * 8;
+        unsigned long mask[1024 / (sizeof(unsigned long) * 8)] = {0};
+        if(affinity.numaNode >= 1024) {
+            ok = false;
+        } else {
+            mask[affinity.numaNode / bits] |= 1ul << (affinity.numaNode % bits);
+            if(syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, 1024 + 1)) {
+                SYLAR_LOG_ERROR(g_logger) << "set_mempolicy thread=" << t_thread_name
+                    << " node=" << affinity.numaNode << " errno=" << errno
+                    << " errstr=" << strerror(errno);
+                ok = false;
+            } else {
+                t_numa_node = affinity.numaNode;
+            }
+        }
+    }
+    return ok;
+}
+
+int Thread::GetNumaNode() {
+    return t_numa_node;
+}
+
+}
@@ -10,8 +10,43 @@
 
 #include "mutex.h"
 #include<string>//Zhujiayong
+#include<vector>
 
 namespace Sylar{
+    /**
+     * @brief 线程的CPU/NUMA绑定配置
+     */
+    struct CpuAffinity{
+        /// 允许运行的CPU编号,为空且指定了numaNode时取该节点的全部CPU
+        std::vector<int> cpus;
+        /// 绑定的NUMA节点,-1表示不绑定;绑定后线程优先从该节点分配内存
+        int numaNode=-1;
+        /// 每个线程只绑定cpus中的一个CPU(按线程序号轮流分配),否则线程可以运行在cpus中任意一个CPU上
+        bool perThread=false;
+
+        /**
+         * @brief 是否没有任何绑定
+         */
+        bool empty()const{return cpus.empty()&&numaNode<0;}
+
+        /**
+         * @brief 输出为 cpus=0-3,8 numa=0 per_thread=1 格式
+         */
+        std::string toString()const;
+
+        /**
+         * @brief 解析CPU列表
+         * @param[in] str 形如 "0-3,8,10-11" 的列表(与 /sys 中 cpulist 格式相同)
+         * @return 解析出的CPU编号,格式错误的部分被忽略
+         */
+        static std::vector<int> ParseCpuList(const std::string&str);
+
+        /**
+         * @brief 返回NUMA节点上的CPU列表,节点不存在返回空
+         */
+        static std::vector<int> GetNodeCpus(int node);
+    };
+
     /**
      * @brief 线程类
      */
@@ -60,6 +95,21 @@ namespace Sylar{
          * @param[in] name 线程名称
          */
         static void SetName(const std::string&name);
+
+        /**
+         * @brief 把当前线程绑定到CPU/NUMA节点
+         * @details 绑定NUMA节点时把线程的内存策略设为优先该节点,
+         *          之后该线程首次访问的页(协程栈、epoll事件数组、缓冲区等)都分配在本节点
+         * @param[in] affinity 绑定配置
+         * @param[in] index 线程序号,perThread时用于选择CPU
+         * @return 全部设置成功返回true
+         */
+        static bool SetAffinity(const CpuAffinity&affinity,size_t index=0);
+
+        /**
+         * @brief 返回当前线程绑定的NUMA节点,未绑定返回-1
+         */
+        static int GetNumaNode();
     private:
         /**
          * @brief 线程执行函数
@@ -1,6 +1,10 @@
 #include "timer.h"
 #include "util.h"
+#include "macro.h"
+#include "fiber.h"
+#include <string.h>
 #include <time.h>
+#include <algorithm>
 
 namespace Sylar {
 
@@ -16,76 +20,270 @@ uint64_t GetSystemMS() {
     return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-TimeWheel::TimeWheel(size_t slot_size, uint64_t tick_ms)
-    : m_slotSize(slot_size)
-    , m_tickMs(tick_ms)
-    , m_currentSlot(0) {
-    m_slots.resize(slot_size);
-    for(auto& slot : m_slots) {
-        slot.expiration = 0;
+/// 各层每个槽对应的tick数的位移
+static const int s_wheel_shift[TimeWheel::LEVELS] = {0, 8, 14, 20};
+/// 各层的槽数
+static const size_t s_wheel_size[TimeWheel::LEVELS] = {256, 64, 64, 64};
+
+void TimerSlot::push(Timer* timer) {
+    timer->m_prevTimer = tail;
+    timer->m_nextTimer = nullptr;
+    if(tail) {
+        tail->m_nextTimer = timer;
+    } else {
+        head = timer;
     }
+    tail = timer;
 }
 
-bool TimeWheel::addTimer(std::shared_ptr<Timer> timer) {
-    RWMutex::WriteLock lock(m_mutex);
-    uint64_t now = GetMonotonicMS();
-    if(timer->m_next < now) {
-        return false;
+void TimerSlot::unlink(Timer* timer) {
+    if(timer->m_prevTimer) {
+        timer->m_prevTimer->m_nextTimer = timer->m_nextTimer;
+    } else {
+        head = timer->m_nextTimer;
     }
+    if(timer->m_nextTimer) {
+        timer->m_nextTimer->m_prevTimer = timer->m_prevTimer;
+    } else {
+        tail = timer->m_prevTimer;
+    }
+    timer->m_prevTimer = timer->m_nextTimer = nullptr;
+}
 
-    // 计算定时器应该放在哪个槽
-    uint64_t diff = timer->m_next - now;
-    size_t ticks = diff / m_tickMs;
-    size_t slot = (m_currentSlot + ticks) % m_slotSize;
-    
-    // 设置槽的过期时间
-    m_slots[slot].expiration = timer->m_next;
-    m_slots[slot].timers.push_back(timer);
-    return true;
+Timer* TimerSlot::take() {
+    Timer* timers = head;
+    head = tail = nullptr;
+    expiration = ~0ull;
+    return timers;
+}
+
+TimeWheel::TimeWheel(uint64_t now_ms)
+    : m_current(now_ms) {
+    for(int i = 0; i < LEVELS; ++i) {
+        m_slots[i].resize(s_wheel_size[i]);
+        memset(m_bits[i], 0, sizeof(m_bits[i]));
+    }
+}
+
+TimeWheel::~TimeWheel() {
+    clear();
+}
+
+int TimeWheel::findSlot(int level, size_t pos) const {
+    const uint64_t* bits = m_bits[level];
+    size_t size = s_wheel_size[level];
+    size_t words = size >> 6;
+    size_t w = pos >> 6;
+    uint64_t word = bits[w] & (~0ull << (pos & 63));
+    //最后一轮回到起始的字,包含pos之前(绕回)的位
+    for(size_t i = 0; i <= words; ++i) {
+        if(word) {
+            size_t idx = (w << 6) | __builtin_ctzll(word);
+            return (idx + size - pos) & (size - 1);
+        }
+        w = (w + 1) % words;
+        word = bits[w];
+    }
+    return -1;
 }
 
-uint64_t TimeWheel::getNextTimer() {
-    RWMutex::ReadLock lock(m_mutex);
-    uint64_t now = GetMonotonicMS();
+void TimeWheel::expire(Timer* timer, std::vector<std::shared_ptr<Timer>>& expired) {
+    timer->m_level = -1;
+    --m_size;
+    expired.push_back(std::move(timer->m_self));
+}
+
+void TimeWheel::place(Timer* timer, std::vector<std::shared_ptr<Timer>>* expired) {
+    uint64_t expire = timer->m_next;
+    if(expire <= m_current) {
+        if(expired) {
+            this->expire(timer, *expired);
+        } else {
+            timer->m_level = LEVELS;
+            m_overdue.push(timer);
+        }
+        return;
+    }
+    int level = 0;
+    size_t slot = 0;
+    for(; level < LEVELS; ++level) {
+        int shift = s_wheel_shift[level];
+        uint64_t diff = (expire >> shift) - (m_current >> shift);
+        if(diff < s_wheel_size[level]) {
+            slot = (expire >> shift) & (s_wheel_size[level] - 1);
+            break;
+        }
+    }
+    if(level == LEVELS) {
+        //超出总跨度,放在最高层最远的槽,下放时重新计算
+        level = LEVELS - 1;
+        slot = ((m_current >> s_wheel_shift[level]) + s_wheel_size[level] - 1)
+                    & (s_wheel_size[level] - 1);
+    }
+    timer->m_level = level;
+    timer->m_slot = slot;
+    TimerSlot& ts = m_slots[level][slot];
+    ts.push(timer);
+    ts.expiration = std::min(ts.expiration, timer->m_next);
+    m_bits[level][slot >> 6] |= 1ull << (slot & 63);
+}
+
+Timer* TimeWheel::takeSlot(int level, size_t slot) {
+    m_bits[level][slot >> 6] &= ~(1ull << (slot & 63));
+    return m_slots[level][slot].take();
+}
+
+bool TimeWheel::addTimer(std::shared_ptr<Timer> timer) {
     uint64_t next = ~0ull;
+    if(m_size) {
+        next = getNextTimer(m_current);
+        next = next == ~0ull ? next : m_current + next;
+    }
+    Timer* raw = timer.get();
+    raw->m_seq = ++m_seq;
+    raw->m_self = std::move(timer);
+    place(raw, nullptr);
+    ++m_size;
+    return raw->m_next < next;
+}
 
-    for(size_t i = 0; i < m_slotSize; ++i) {
-        size_t slot = (m_currentSlot + i) % m_slotSize;
-        if(!m_slots[slot].timers.empty()) {
-            if(m_slots[slot].expiration <= now) {
-                return 0;
-            }
-            next = std::min(next, m_slots[slot].expiration - now);
+std::shared_ptr<Timer> TimeWheel::removeTimer(Timer* timer) {
+    if(timer->m_level < 0) {
+        return nullptr;
+    }
+    if(timer->m_level == LEVELS) {
+        m_overdue.unlink(timer);
+    } else {
+        TimerSlot& ts = m_slots[timer->m_level][timer->m_slot];
+        ts.unlink(timer);
+        //槽的最早执行时间只在清空时重置,之前作为下界使用
+        if(ts.empty()) {
+            ts.expiration = ~0ull;
+            m_bits[timer->m_level][timer->m_slot >> 6] &= ~(1ull << (timer->m_slot & 63));
         }
     }
+    timer->m_level = -1;
+    --m_size;
+    return std::move(timer->m_self);
+}
 
+uint64_t TimeWheel::nextTick() const {
+    uint64_t next = ~0ull;
+    for(int level = 0; level < LEVELS; ++level) {
+        int shift = s_wheel_shift[level];
+        //高层当前所在的槽不会有定时器(已下放),从下一个槽开始找
+        uint64_t base = (m_current >> shift) + 1;
+        int off = findSlot(level, base & (s_wheel_size[level] - 1));
+        if(off >= 0) {
+            next = std::min(next, (base + off) << shift);
+        }
+    }
     return next;
 }
 
-void TimeWheel::getExpiredTimers(std::vector<std::shared_ptr<Timer>>& expired) {
-    RWMutex::WriteLock lock(m_mutex);
-    uint64_t now = GetMonotonicMS();
+uint64_t TimeWheel::getNextTimer(uint64_t now_ms) const {
+    uint64_t next = getNextExpire();
+    if(next == ~0ull) {
+        return ~0ull;
+    }
+    return next <= now_ms ? 0 : next - now_ms;
+}
 
-    while(true) {
-        auto& slot = m_slots[m_currentSlot];
-        if(slot.expiration > now) {
-            break;
+uint64_t TimeWheel::getNextExpire() const {
+    if(!m_size) {
+        return ~0ull;
+    }
+    if(!m_overdue.empty()) {
+        return 0;
+    }
+    //同一层中各槽的时间范围从当前位置起依次递增,第一个非空槽就是该层最早的
+    uint64_t next = ~0ull;
+    for(int level = 0; level < LEVELS; ++level) {
+        size_t size = s_wheel_size[level];
+        size_t pos = ((m_current >> s_wheel_shift[level]) + 1) & (size - 1);
+        int off = findSlot(level, pos);
+        if(off >= 0) {
+            next = std::min(next, m_slots[level][(pos + off) & (size - 1)].expiration);
         }
+    }
+    return next;
+}
+
+void TimeWheel::processTick(uint64_t tick, std::vector<std::shared_ptr<Timer>>& expired) {
+    m_current = tick;
+    //先下放高层,下放到第1层的定时器可能正好落在这次要下放的槽里
+    for(int level = LEVELS - 1; level > 0; --level) {
+        int shift = s_wheel_shift[level];
+        if(tick & ((1ull << shift) - 1)) {
+            continue;
+        }
+        Timer* timer = takeSlot(level, (tick >> shift) & (s_wheel_size[level] - 1));
+        while(timer) {
+            Timer* next = timer->m_nextTimer;
+            timer->m_prevTimer = timer->m_nextTimer = nullptr;
+            place(timer, &expired);
+            timer = next;
+        }
+    }
+    Timer* timer = takeSlot(0, tick & (s_wheel_size[0] - 1));
+    while(timer) {
+        Timer* next = timer->m_nextTimer;
+        timer->m_prevTimer = timer->m_nextTimer = nullptr;
+        expire(timer, expired);
+        timer = next;
+    }
+}
 
-        expired.insert(expired.end(), slot.timers.begin(), slot.timers.end());
-        slot.timers.clear();
-        slot.expiration = 0;
-        m_currentSlot = (m_currentSlot + 1) % m_slotSize;
+void TimeWheel::getExpiredTimers(uint64_t now_ms, std::vector<std::shared_ptr<Timer>>& expired) {
+    size_t begin = expired.size();
+    Timer* timer = m_overdue.take();
+    while(timer) {
+        Timer* next = timer->m_nextTimer;
+        timer->m_prevTimer = timer->m_nextTimer = nullptr;
+        expire(timer, expired);
+        timer = next;
     }
+    while(m_current < now_ms) {
+        //跳过中间没有定时器需要处理的tick
+        uint64_t tick = m_size ? nextTick() : ~0ull;
+        if(tick > now_ms) {
+            m_current = now_ms;
+            break;
+        }
+        processTick(tick, expired);
+    }
+    std::sort(expired.begin() + begin, expired.end(),
+            [](const std::shared_ptr<Timer>& lhs, const std::shared_ptr<Timer>& rhs) {
+        if(lhs->m_next != rhs->m_next) {
+            return lhs->m_next < rhs->m_next;
+        }
+        return lhs->m_seq < rhs->m_seq;
+    });
 }
 
 void TimeWheel::clear() {
-    RWMutex::WriteLock lock(m_mutex);
-    for(auto& slot : m_slots) {
-        slot.timers.clear();
-        slot.expiration = 0;
+    std::vector<std::shared_ptr<Timer>> timers;
+    timers.reserve(m_size);
+    for(int level = 0; level < LEVELS; ++level) {
+        for(size_t slot = 0; slot < m_slots[level].size(); ++slot) {
+            Timer* timer = takeSlot(level, slot);
+            while(timer) {
+                Timer* next = timer->m_nextTimer;
+                timer->m_prevTimer = timer->m_nextTimer = nullptr;
+                expire(timer, timers);
+                timer = next;
+            }
+        }
+    }
+    Timer* timer = m_overdue.take();
+    while(timer) {
+        Timer* next = timer->m_nextTimer;
+        timer->m_prevTimer = timer->m_nextTimer = nullptr;
+        expire(timer, timers);
+        timer = next;
     }
-    m_currentSlot = 0;
+    //定时器在链表之外释放
+    timers.clear();
 }
 
 bool Timer::Comparator::operator()(const Timer::ptr& lhs, const Timer::ptr& rhs) const {
@@ -121,24 +319,37 @@ Timer::Timer(uint64_t next)
 }
 
 bool Timer::cancel() {
+    if(m_wheel >= 0) {
+        return m_manager->cancelTimer(this);
+    }
     TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
     if(m_cb) {
         m_cb = nullptr;
+        m_manager->m_timeWheel.removeTimer(this);
         return true;
     }
     return false;
 }
 
 bool Timer::refresh() {
+    if(m_wheel >= 0) {
+        return m_manager->refreshTimer(this);
+    }
     TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
     if(!m_cb) {
         return false;
     }
+    //从槽中摘下再放回,不分配内存
+    Timer::ptr self = m_manager->m_timeWheel.removeTimer(this);
     m_next = GetMonotonicMS() + m_ms;
-    return m_manager->m_timeWheel.addTimer(shared_from_this());
+    m_manager->addTimer(self ? self : shared_from_this(), lock);
+    return true;
 }
 
 bool Timer::reset(uint64_t ms, bool from_now) {
+    if(m_wheel >= 0) {
+        return m_manager->resetTimer(this, ms, from_now);
+    }
     if(ms == m_ms && !from_now) {
         return true;
     }
@@ -152,28 +363,208 @@ bool Timer::reset(uint64_t ms, bool from_now) {
     } else {
         start = m_next - m_ms;
     }
+    Timer::ptr self = m_manager->m_timeWheel.removeTimer(this);
     m_ms = ms;
     m_next = start + m_ms;
-    return m_manager->m_timeWheel.addTimer(shared_from_this());
+    m_manager->addTimer(self ? self : shared_from_this(), lock);
+    return true;
 }
 
 TimerManager::TimerManager()
-    : m_timeWheel(60, 1000) {  // 60个槽，每个槽1秒
+    : m_timeWheel(GetMonotonicMS()) {
     m_lastMonotonicTime = GetMonotonicMS();
     m_lastSystemTime = GetSystemMS();
 }
 
 TimerManager::~TimerManager() {
+    for(auto w : m_wheels) {
+        Timer* timer = w->inbox.exchange(nullptr);
+        while(timer) {
+            Timer* next = timer->m_nextQueued;
+            timer->m_nextQueued = nullptr;
+            Timer::ptr self;
+            self.swap(timer->m_queuedSelf);
+            timer = next;
+        }
+        delete w;
+    }
 }
 
 Timer::ptr TimerManager::addTimer(uint64_t ms, std::function<void()> cb
                                   ,bool recurring) {
     Timer::ptr timer(new Timer(ms, cb, recurring, this));
-    RWMutexType::WriteLock lock(m_mutex);
-    addTimer(timer, lock);
+    if(m_wheels.empty()) {
+        RWMutexType::WriteLock lock(m_mutex);
+        addTimer(timer, lock);
+        return timer;
+    }
+    int index = getTimerWheelIndex();
+    if(index >= 0) {
+        //所属线程直接加入,不加锁;线程正在运行,回到idle时会重新计算等待时间,无需唤醒
+        ThreadTimerWheel* w = m_wheels[index];
+        timer->m_wheel = index;
+        ++w->live;
+        w->wheel.addTimer(timer);
+        publishTimerWheel(w);
+        return timer;
+    }
+    index = m_timerTargets[m_nextTimerTarget.fetch_add(1, std::memory_order_relaxed)
+                % m_timerTargets.size()];
+    timer->m_wheel = index;
+    ++m_wheels[index]->live;
+    pushTimerOp(timer.get(), TIMER_ADD, true);
     return timer;
 }
 
+void TimerManager::initTimerWheels(size_t count, const std::vector<size_t>& targets) {
+    SYLAR_ASSERT(m_wheels.empty() && count > 0 && !targets.empty());
+    uint64_t now_ms = GetMonotonicMS();
+    for(size_t i = 0; i < count; ++i) {
+        m_wheels.push_back(new ThreadTimerWheel(now_ms));
+    }
+    m_timerTargets = targets;
+}
+
+TimerManager::ThreadTimerWheel* TimerManager::getLocalTimerWheel() {
+    int index = getTimerWheelIndex();
+    if(index < 0 || (size_t)index >= m_wheels.size()) {
+        return nullptr;
+    }
+    return m_wheels[index];
+}
+
+void TimerManager::pushTimerOp(Timer* timer, uint32_t op, bool wake) {
+    size_t index = timer->m_wheel;
+    timer->m_pendingOps.fetch_or(op);
+    m_timerInboxOps.fetch_add(1, std::memory_order_relaxed);
+    //已在收件箱中的定时器,所属线程取走时会看到这次记录的操作
+    if(!timer->m_queued.exchange(true)) {
+        ThreadTimerWheel* w = m_wheels[index];
+        timer->m_queuedSelf = timer->shared_from_this();
+        Timer* head = w->inbox.load(std::memory_order_relaxed);
+        do {
+            timer->m_nextQueued = head;
+        } while(!w->inbox.compare_exchange_weak(head, timer
+                    , std::memory_order_release, std::memory_order_relaxed));
+    }
+    if(wake) {
+        onTimerInboxPushed(index);
+    }
+}
+
+void TimerManager::drainTimerInbox(ThreadTimerWheel* w) {
+    Timer* timer = w->inbox.exchange(nullptr, std::memory_order_acquire);
+    if(!timer) {
+        return;
+    }
+    //按入队顺序处理
+    Timer* timers = nullptr;
+    while(timer) {
+        Timer* next = timer->m_nextQueued;
+        timer->m_nextQueued = timers;
+        timers = timer;
+        timer = next;
+    }
+    uint64_t now_ms = GetMonotonicMS();
+    while(timers) {
+        timer = timers;
+        timers = timer->m_nextQueued;
+        timer->m_nextQueued = nullptr;
+        Timer::ptr self;
+        self.swap(timer->m_queuedSelf);
+        //先出队再取操作,之后投递的操作会让定时器重新入队
+        timer->m_queued = false;
+        uint32_t ops = timer->m_pendingOps.exchange(0);
+        if(ops & TIMER_CANCEL) {
+            w->wheel.removeTimer(timer);
+            timer->m_cb = nullptr;
+            continue;
+        }
+        if(timer->m_state != Timer::ARMED) {
+            continue;
+        }
+        //所属线程可能已经先刷新过,定时器已在时间轮中
+        if((ops & TIMER_ADD) && timer->m_level < 0) {
+            w->wheel.addTimer(self);
+        }
+        if(ops & TIMER_RESET) {
+            uint64_t arg = timer->m_resetArg.load();
+            uint64_t ms = arg >> 1;
+            uint64_t start = (arg & 1) ? now_ms : timer->m_next - timer->m_ms;
+            timer->m_ms = ms;
+            rearmTimer(w, timer, start + ms);
+        }
+        if(ops & TIMER_REFRESH) {
+            rearmTimer(w, timer, now_ms + timer->m_ms);
+        }
+    }
+    publishTimerWheel(w);
+}
+
+void TimerManager::rearmTimer(ThreadTimerWheel* w, Timer* timer, uint64_t next) {
+    Timer::ptr self = w->wheel.removeTimer(timer);
+    timer->m_next = next;
+    w->wheel.addTimer(self ? self : timer->shared_from_this());
+}
+
+void TimerManager::publishTimerWheel(ThreadTimerWheel* w) {
+    w->next.store(w->wheel.getNextExpire(), std::memory_order_relaxed);
+}
+
+bool TimerManager::cancelTimer(Timer* timer) {
+    int state = Timer::ARMED;
+    if(!timer->m_state.compare_exchange_strong(state, Timer::CANCELLED)) {
+        return false;
+    }
+    ThreadTimerWheel* w = m_wheels[timer->m_wheel];
+    --w->live;
+    if(getTimerWheelIndex() == timer->m_wheel) {
+        Timer::ptr self = w->wheel.removeTimer(timer);
+        timer->m_cb = nullptr;
+        publishTimerWheel(w);
+        return true;
+    }
+    //已不计入live,留在时间轮中也不影响停止;到期前所属线程醒来时才摘除,不必唤醒
+    pushTimerOp(timer, TIMER_CANCEL, false);
+    return true;
+}
+
+bool TimerManager::refreshTimer(Timer* timer) {
+    if(timer->m_state != Timer::ARMED) {
+        return false;
+    }
+    if(getTimerWheelIndex() == timer->m_wheel) {
+        ThreadTimerWheel* w = m_wheels[timer->m_wheel];
+        rearmTimer(w, timer, GetMonotonicMS() + timer->m_ms);
+        publishTimerWheel(w);
+        return true;
+    }
+    //刷新只会推迟执行时间,所属线程按原来的时间醒来时处理即可
+    pushTimerOp(timer, TIMER_REFRESH, false);
+    return true;
+}
+
+bool TimerManager::resetTimer(Timer* timer, uint64_t ms, bool from_now) {
+    if(timer->m_state != Timer::ARMED) {
+        return false;
+    }
+    if(getTimerWheelIndex() == timer->m_wheel) {
+        if(ms == timer->m_ms && !from_now) {
+            return true;
+        }
+        ThreadTimerWheel* w = m_wheels[timer->m_wheel];
+        uint64_t start = from_now ? GetMonotonicMS() : timer->m_next - timer->m_ms;
+        timer->m_ms = ms;
+        rearmTimer(w, timer, start + ms);
+        publishTimerWheel(w);
+        return true;
+    }
+    //参数先于操作位写入,所属线程看到操作位时参数已可见
+    timer->m_resetArg = ms << 1 | (from_now ? 1 : 0);
+    pushTimerOp(timer, TIMER_RESET, true);
+    return true;
+}
+
 static void OnTimer(std::weak_ptr<void> weak_cond, std::function<void()> cb) {
     std::shared_ptr<void> tmp = weak_cond.lock();
     if(tmp) {
@@ -184,13 +575,33 @@ static void OnTimer(std::weak_ptr<void> weak_cond, std::function<void()> cb) {
 Timer::ptr TimerManager::addConditionTimer(uint64_t ms, std::function<void()> cb
                                     ,std::weak_ptr<void> weak_cond
                                     ,bool recurring) {
+    if(InlineTask::Is(cb)) {
+        return addTimer(ms, InlineTask(std::bind(&OnTimer, weak_cond, cb)), recurring);
+    }
     return addTimer(ms, std::bind(&OnTimer, weak_cond, cb), recurring);
 }
 
 uint64_t TimerManager::getNextTimer() {
+    if(!m_wheels.empty()) {
+        ThreadTimerWheel* w = getLocalTimerWheel();
+        if(w) {
+            drainTimerInbox(w);
+            return w->wheel.getNextTimer(GetMonotonicMS());
+        }
+        //不属于任何时间轮的线程返回各线程发布的最早执行时间
+        uint64_t next = ~0ull;
+        for(auto i : m_wheels) {
+            next = std::min(next, i->next.load(std::memory_order_relaxed));
+        }
+        if(next == ~0ull) {
+            return ~0ull;
+        }
+        uint64_t now_ms = GetMonotonicMS();
+        return next <= now_ms ? 0 : next - now_ms;
+    }
     RWMutexType::ReadLock lock(m_mutex);
     m_tickled = false;
-    return m_timeWheel.getNextTimer();
+    return m_timeWheel.getNextTimer(GetMonotonicMS());
 }
 
 bool TimerManager::detectTimeAnomaly() {
@@ -210,20 +621,67 @@ bool TimerManager::detectTimeAnomaly() {
 }
 
 void TimerManager::listExpiredCb(std::vector<std::function<void()> >& cbs) {
+    uint64_t now_ms = GetMonotonicMS();
     std::vector<Timer::ptr> expired;
+    if(!m_wheels.empty()) {
+        ThreadTimerWheel* w = getLocalTimerWheel();
+        if(!w) {
+            return;
+        }
+        drainTimerInbox(w);
+        if(w->wheel.getNextTimer(now_ms) != 0) {
+            return;
+        }
+        w->wheel.getExpiredTimers(now_ms, expired);
+        cbs.reserve(cbs.size() + expired.size());
+        for(auto& timer : expired) {
+            if(timer->m_recurring) {
+                //其他线程已取消,取消操作还在收件箱中
+                if(timer->m_state != Timer::ARMED) {
+                    timer->m_cb = nullptr;
+                    continue;
+                }
+                //循环定时器到期后仍是ARMED,回调交给调度器后到执行前仍可能被取消,执行时再检查一次
+                Timer::ptr self = timer;
+                std::function<void()> cb = timer->m_cb;
+                std::function<void()> guarded = [self, cb]() {
+                    if(self->m_state == Timer::ARMED) {
+                        cb();
+                    }
+                };
+                if(InlineTask::Is(cb)) {
+                    cbs.push_back(InlineTask(std::move(guarded)));
+                } else {
+                    cbs.push_back(std::move(guarded));
+                }
+                timer->m_next = now_ms + timer->m_ms;
+                w->wheel.addTimer(timer);
+                continue;
+            }
+            int state = Timer::ARMED;
+            if(timer->m_state.compare_exchange_strong(state, Timer::DONE)) {
+                --w->live;
+                cbs.push_back(std::move(timer->m_cb));
+            }
+            timer->m_cb = nullptr;
+        }
+        publishTimerWheel(w);
+        return;
+    }
     {
-        RWMutexType::WriteLock lock(m_mutex);
-        m_timeWheel.getExpiredTimers(expired);
+        RWMutexType::ReadLock lock(m_mutex);
+        if(m_timeWheel.getNextTimer(now_ms) != 0) {
+            return;
+        }
     }
-
+    RWMutexType::WriteLock lock(m_mutex);
+    m_timeWheel.getExpiredTimers(now_ms, expired);
     cbs.reserve(expired.size());
-    uint64_t now_ms = GetMonotonicMS();
 
     for(auto& timer : expired) {
         cbs.push_back(timer->m_cb);
         if(timer->m_recurring) {
             timer->m_next = now_ms + timer->m_ms;
-            RWMutexType::WriteLock lock(m_mutex);
             m_timeWheel.addTimer(timer);
         } else {
             timer->m_cb = nullptr;
@@ -232,7 +690,7 @@ void TimerManager::listExpiredCb(std::vector<std::function<void()> >& cbs) {
 }
 
 void TimerManager::addTimer(Timer::ptr val, RWMutexType::WriteLock& lock) {
-    bool at_front = m_timeWheel.addTimer(val);
+    bool at_front = m_timeWheel.addTimer(val) && !m_tickled;
     if(at_front) {
         m_tickled = true;
     }
@@ -244,8 +702,28 @@ void TimerManager::addTimer(Timer::ptr val, RWMutexType::WriteLock& lock) {
 }
 
 bool TimerManager::hasTimer() {
+    if(!m_wheels.empty()) {
+        for(auto w : m_wheels) {
+            if(w->live > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
     RWMutexType::ReadLock lock(m_mutex);
-    return m_timeWheel.getNextTimer() != ~0ull;
+    return m_timeWheel.size() > 0;
+}
+
+bool TimerManager::hasExpiredThreadTimer() {
+    ThreadTimerWheel* w = m_wheels.empty() ? nullptr : getLocalTimerWheel();
+    if(!w) {
+        return false;
+    }
+    if(w->inbox.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    uint64_t next = w->next.load(std::memory_order_relaxed);
+    return next != ~0ull && next <= GetMonotonicMS();
 }
 
 }
@@ -11,10 +11,12 @@
 #include <memory>
 #include <vector>
 #include <list>
+#include <atomic>
 #include "thread.h"
 
 namespace Sylar {
 
+class Timer;
 class TimerManager;
 
 /**
@@ -31,61 +33,156 @@ uint64_t GetSystemMS();
 
 /**
  * @brief 时间轮槽
+ * @details 定时器节点自身带前后指针(侵入式双向链表),摘除是常数时间,
+ *          重新加入时间轮也不需要分配内存
  */
 struct TimerSlot {
-    /// 定时器列表
-    std::list<std::shared_ptr<Timer>> timers;
-    /// 槽的过期时间
-    uint64_t expiration;
+    /// 链表头
+    Timer* head = nullptr;
+    /// 链表尾
+    Timer* tail = nullptr;
+    /// 槽内最早的执行时间,空槽为~0ull
+    uint64_t expiration = ~0ull;
+
+    /**
+     * @brief 是否为空
+     */
+    bool empty() const { return head == nullptr;}
+
+    /**
+     * @brief 加到链表尾部
+     */
+    void push(Timer* timer);
+
+    /**
+     * @brief 从链表中摘除
+     */
+    void unlink(Timer* timer);
+
+    /**
+     * @brief 取走整条链表并重置为空槽
+     * @return 链表头,沿m_nextTimer遍历
+     */
+    Timer* take();
 };
 
 /**
- * @brief 时间轮
+ * @brief 分层时间轮
+ * @details 4层,以1毫秒为一个tick。第0层256个槽,每个槽对应一个tick;第1~3层各64个槽,
+ *          每个槽的跨度是下一层转一圈的时间(256毫秒/16.4秒/17.5分钟),总跨度约18.6小时,
+ *          更远的定时器放在最高层最远的槽,到时重新计算位置。
+ *          时间走到高层某个槽的起点时,把槽内的定时器按剩余时间下放(cascade)到低层。
+ *          每层用位图记录非空槽,插入、查找最近的执行时间都是常数时间。
+ *          同一个tick到期的定时器按执行时间、再按加入顺序返回。
+ *          不加锁,由调用方(TimerManager)保证互斥
  */
 class TimeWheel {
 public:
+    /// 层数
+    static const int LEVELS = 4;
+
     /**
      * @brief 构造函数
-     * @param[in] slot_size 时间轮槽数量
-     * @param[in] tick_ms 每个槽的时间间隔(毫秒)
+     * @param[in] now_ms 当前单调时钟时间(毫秒)
      */
-    TimeWheel(size_t slot_size, uint64_t tick_ms);
+    TimeWheel(uint64_t now_ms);
+
+    /**
+     * @brief 析构函数,释放仍在时间轮中的定时器
+     */
+    ~TimeWheel();
 
     /**
      * @brief 添加定时器
-     * @param[in] timer 定时器
-     * @return 是否添加成功
+     * @param[in] timer 定时器,执行时间不晚于已处理到的tick的在下一次取到期定时器时返回
+     * @return 是否成为最早执行的定时器
+     * @details 时间轮持有定时器的引用,直到到期取出或被移除
      */
     bool addTimer(std::shared_ptr<Timer> timer);
 
+    /**
+     * @brief 从所在的槽中摘除定时器,常数时间
+     * @return 返回时间轮持有的引用,定时器不在时间轮中返回nullptr
+     */
+    std::shared_ptr<Timer> removeTimer(Timer* timer);
+
     /**
      * @brief 获取下一个定时器执行时间
-     * @return 返回距离下一个定时器执行的时间(毫秒)
+     * @param[in] now_ms 当前单调时钟时间(毫秒)
+     * @return 返回距离下一个定时器执行的时间(毫秒),没有定时器返回~0ull
      */
-    uint64_t getNextTimer();
+    uint64_t getNextTimer(uint64_t now_ms) const;
+
+    /**
+     * @brief 获取最早的执行时间(单调时钟毫秒)
+     * @return 有已到期的定时器返回0,没有定时器返回~0ull
+     */
+    uint64_t getNextExpire() const;
 
     /**
-     * @brief 获取到期的定时器
+     * @brief 时间推进到now_ms,取出到期的定时器
+     * @param[in] now_ms 当前单调时钟时间(毫秒)
      * @param[out] expired 到期的定时器列表
      */
-    void getExpiredTimers(std::vector<std::shared_ptr<Timer>>& expired);
+    void getExpiredTimers(uint64_t now_ms, std::vector<std::shared_ptr<Timer>>& expired);
 
     /**
      * @brief 清空时间轮
      */
     void clear();
 
+    /**
+     * @brief 定时器数量
+     */
+    size_t size() const { return m_size;}
+
 private:
-    /// 时间轮槽数量
-    size_t m_slotSize;
-    /// 每个槽的时间间隔(毫秒)
-    uint64_t m_tickMs;
-    /// 当前槽位置
-    size_t m_currentSlot;
-    /// 时间轮槽数组
-    std::vector<TimerSlot> m_slots;
-    /// 读写锁
-    RWMutex m_mutex;
+    /**
+     * @brief 按执行时间把定时器放到对应层的槽中
+     * @param[out] expired 执行时间不晚于当前tick时放入,为nullptr时放入m_overdue
+     */
+    void place(Timer* timer, std::vector<std::shared_ptr<Timer>>* expired);
+
+    /**
+     * @brief 定时器到期,把时间轮持有的引用交给expired
+     */
+    void expire(Timer* timer, std::vector<std::shared_ptr<Timer>>& expired);
+
+    /**
+     * @brief 下一个需要处理(到期或下放)的tick,没有定时器返回~0ull
+     */
+    uint64_t nextTick() const;
+
+    /**
+     * @brief 处理tick:先从高到低下放各层到达起点的槽,再取出第0层的槽
+     */
+    void processTick(uint64_t tick, std::vector<std::shared_ptr<Timer>>& expired);
+
+    /**
+     * @brief 取走槽中的所有定时器并清除非空标记
+     * @return 链表头
+     */
+    Timer* takeSlot(int level, size_t slot);
+
+    /**
+     * @brief 从pos开始(环形)查找第一个非空槽
+     * @return 相对pos的偏移,整层为空返回-1
+     */
+    int findSlot(int level, size_t pos) const;
+
+private:
+    /// 各层的槽
+    std::vector<TimerSlot> m_slots[LEVELS];
+    /// 执行时间不晚于已处理到的tick的定时器(层号记为LEVELS)
+    TimerSlot m_overdue;
+    /// 各层的非空槽位图
+    uint64_t m_bits[LEVELS][4];
+    /// 已处理到的tick(单调时钟毫秒)
+    uint64_t m_current;
+    /// 定时器数量
+    size_t m_size = 0;
+    /// 加入顺序,用于同一tick内排序
+    uint64_t m_seq = 0;
 };
 
 /**
@@ -94,6 +191,7 @@ private:
 class Timer : public std::enable_shared_from_this<Timer> {
 friend class TimerManager;
 friend class TimeWheel;
+friend struct TimerSlot;
 public:
     /// 定时器的智能指针类型
     typedef std::shared_ptr<Timer> ptr;
@@ -136,6 +234,18 @@ private:
      * @param[in] next 执行的时间戳(毫秒)
      */
     Timer(uint64_t next);
+
+    /**
+     * @brief 每线程时间轮中定时器的状态
+     */
+    enum State {
+        /// 等待执行
+        ARMED = 0,
+        /// 已取消
+        CANCELLED = 1,
+        /// 已执行(非循环定时器)
+        DONE = 2
+    };
 private:
     /// 是否循环定时器
     bool m_recurring = false;
@@ -143,6 +253,32 @@ private:
     uint64_t m_ms = 0;
     /// 精确的执行时间，使用单调时钟
     uint64_t m_next = 0;
+    /// 加入时间轮的顺序
+    uint64_t m_seq = 0;
+    /// 所在时间轮的层,不在时间轮中为-1
+    int m_level = -1;
+    /// 所在的槽
+    size_t m_slot = 0;
+    /// 槽链表中的前一个定时器
+    Timer* m_prevTimer = nullptr;
+    /// 槽链表中的后一个定时器
+    Timer* m_nextTimer = nullptr;
+    /// 在时间轮中时持有自身的引用,保证未被外部保存的定时器也能到期执行
+    std::shared_ptr<Timer> m_self;
+    /// 所属的每线程时间轮,-1表示使用共享时间轮
+    int m_wheel = -1;
+    /// 每线程时间轮中的状态,其他线程通过它取消定时器
+    std::atomic<int> m_state = {ARMED};
+    /// 其他线程投递、尚未被所属线程处理的操作(TimerManager::TimerOp按位或)
+    std::atomic<uint32_t> m_pendingOps = {0};
+    /// 是否在所属时间轮的收件箱中,每个定时器最多入队一次,投递操作不分配内存
+    std::atomic<bool> m_queued = {false};
+    /// 收件箱中的下一个定时器
+    Timer* m_nextQueued = nullptr;
+    /// 在收件箱中时持有自身的引用
+    std::shared_ptr<Timer> m_queuedSelf;
+    /// 最近一次投递的RESET参数:执行间隔(毫秒)左移一位,最低位表示是否从当前时间开始计算
+    std::atomic<uint64_t> m_resetArg = {0};
     /// 回调函数
     std::function<void()> m_cb;
     /// 定时器管理器
@@ -214,7 +350,116 @@ protected:
      * @brief 将定时器添加到管理器中
      */
     void addTimer(Timer::ptr val, RWMutexType::WriteLock& lock);
+
+    /**
+     * @brief 启用每线程时间轮,需在其他线程使用定时器之前调用
+     * @details 每个线程只操作自己的时间轮,不加锁;其他线程加入、取消、刷新或重置
+     *          定时器时把操作投递到所属时间轮的无锁收件箱(多生产者单消费者),
+     *          由所属线程在下次取最近执行时间或到期定时器时处理
+     * @param[in] count 时间轮数量,下标由getTimerWheelIndex()返回
+     * @param[in] targets 不属于任何时间轮的线程(如会退出的弹性线程)加入定时器时轮流投递的时间轮
+     */
+    void initTimerWheels(size_t count, const std::vector<size_t>& targets);
+
+    /**
+     * @brief 当前线程所属的时间轮下标
+     * @return 不属于任何时间轮返回-1
+     */
+    virtual int getTimerWheelIndex() { return -1;}
+
+    /**
+     * @brief 其他线程向时间轮的收件箱投递了可能提前最近执行时间的操作,需唤醒所属线程
+     * @param[in] index 时间轮下标
+     */
+    virtual void onTimerInboxPushed(size_t /*index*/) {}
+
+    /**
+     * @brief 当前线程的时间轮中是否有到期的定时器或待处理的收件箱操作
+     * @details 只读取本线程发布的最早执行时间和收件箱头,供线程忙碌时在任务之间快速检查
+     */
+    bool hasExpiredThreadTimer();
+
+    /**
+     * @brief 是否启用了每线程时间轮
+     */
+    bool isThreadTimerWheels() const { return !m_wheels.empty();}
+
+    /**
+     * @brief 投递到收件箱的操作次数
+     */
+    uint64_t getTimerInboxOps() const { return m_timerInboxOps;}
 private:
+    /**
+     * @brief 投递给其他线程时间轮的操作
+     * @details 按位记录在定时器的m_pendingOps中,同一个定时器的多个操作合并处理:
+     *          取消优先;重置在刷新之前处理,多次重置以最后一次的参数为准
+     */
+    enum TimerOp {
+        TIMER_ADD = 1,
+        TIMER_CANCEL = 2,
+        TIMER_REFRESH = 4,
+        TIMER_RESET = 8
+    };
+
+    /**
+     * @brief 每线程时间轮
+     */
+    struct ThreadTimerWheel {
+        ThreadTimerWheel(uint64_t now_ms)
+            : wheel(now_ms) {}
+        /// 时间轮,只由所属线程访问
+        TimeWheel wheel;
+        /// 收件箱(有待处理操作的定时器组成的后进先出无锁栈,所属线程一次取走)
+        std::atomic<Timer*> inbox = {nullptr};
+        /// 未取消且未执行完的定时器数量(包括收件箱中尚未加入的)
+        std::atomic<size_t> live = {0};
+        /// 所属线程发布的最早执行时间,供其他线程查询
+        std::atomic<uint64_t> next = {~0ull};
+    };
+
+    /**
+     * @brief 当前线程所属的时间轮,不属于任何时间轮返回nullptr
+     */
+    ThreadTimerWheel* getLocalTimerWheel();
+
+    /**
+     * @brief 向定时器所属时间轮的收件箱投递操作
+     * @details 定时器已在收件箱中时只记录操作,不再入队
+     * @param[in] op 操作(TimerOp)
+     * @param[in] wake 是否唤醒所属线程
+     */
+    void pushTimerOp(Timer* timer, uint32_t op, bool wake);
+
+    /**
+     * @brief 所属线程处理收件箱中的操作
+     */
+    void drainTimerInbox(ThreadTimerWheel* w);
+
+    /**
+     * @brief 所属线程把定时器移到新的执行时间,不分配内存
+     */
+    void rearmTimer(ThreadTimerWheel* w, Timer* timer, uint64_t next);
+
+    /**
+     * @brief 发布时间轮的最早执行时间
+     */
+    void publishTimerWheel(ThreadTimerWheel* w);
+
+    /**
+     * @brief 取消每线程时间轮中的定时器
+     */
+    bool cancelTimer(Timer* timer);
+
+    /**
+     * @brief 刷新每线程时间轮中的定时器
+     */
+    bool refreshTimer(Timer* timer);
+
+    /**
+     * @brief 重置每线程时间轮中的定时器
+     */
+    bool resetTimer(Timer* timer, uint64_t ms, bool from_now);
+
     /**
      * @brief 检测时间异常
      * @return 是否检测到时间异常
@@ -223,8 +468,16 @@ private:
 private:
     /// Mutex
     RWMutexType m_mutex;
-    /// 时间轮
+    /// 共享时间轮(未启用每线程时间轮时使用)
     TimeWheel m_timeWheel;
+    /// 每线程时间轮
+    std::vector<ThreadTimerWheel*> m_wheels;
+    /// 不属于任何时间轮的线程加入定时器时投递的时间轮
+    std::vector<size_t> m_timerTargets;
+    /// 轮流投递的下一个位置
+    std::atomic<uint32_t> m_nextTimerTarget = {0};
+    /// 投递到收件箱的操作次数
+    std::atomic<uint64_t> m_timerInboxOps = {0};
     /// 是否触发onTimerInsertedAtFront
     bool m_tickled = false;
     /// 上次单调时钟时间
@@ -73,6 +73,23 @@ std::string BacktraceToString(int size, int skip, const std::string& prefix) {
     return ss.str();
 }
 
+std::string BacktraceToString(void* const* frames, int count, const std::string& prefix) {
+    if(count <= 0) {
+        return "";
+    }
+    char** strings = backtrace_symbols(frames, count);
+    if(strings == NULL) {
+        SYLAR_LOG_ERROR(g_logger) << "backtrace_synbols error";
+        return "";
+    }
+    std::stringstream ss;
+    for(int i = 0; i < count; ++i) {
+        ss << prefix << demangle(strings[i]) << std::endl;
+    }
+    free(strings);
+    return ss.str();
+}
+
 uint64_t GetCurrentMS() {
     struct timeval tv;
     gettimeofday(&tv, NULL);
@@ -57,6 +57,15 @@ void Backtrace(std::vector<std::string>& bt, int size = 64, int skip = 1);
  */
 std::string BacktraceToString(int size = 64, int skip = 2, const std::string& prefix = "");
 
+/**
+ * @brief 将已采集的调用栈地址转换为字符串
+ * @details 用于在其他线程中解析信号处理函数里用::backtrace采集的地址
+ * @param[in] frames 调用栈地址
+ * @param[in] count 地址个数
+ * @param[in] prefix 每层栈信息前输出的内容
+ */
+std::string BacktraceToString(void* const* frames, int count, const std::string& prefix = "");
+
 /**
  * @brief 获取当前时间的毫秒
  */
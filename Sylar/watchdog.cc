@@ -0,0 +1,63 @@
+#include "watchdog.h"
+#include "scheduler.h"
+#include "config.h"
+#include "util.h"
+#include <algorithm>
+#include <unistd.h>
+
+namespace Sylar {
+
+static ConfigVar<uint32_t>::ptr g_watchdog_budget =
+    Config::Lookup<uint32_t>("fiber.watchdog.budget_ms", 1000, "report fibers running longer than this without yielding, 0 to disable");
+
+Watchdog* Watchdog::GetInstance() {
+    static Watchdog* s_instance = new Watchdog;
+    return s_instance;
+}
+
+Watchdog::Watchdog() {
+}
+
+void Watchdog::add(Scheduler* scheduler) {
+    MutexType::Lock lock(m_mutex);
+    if(std::find(m_schedulers.begin(), m_schedulers.end(), scheduler) == m_schedulers.end()) {
+        m_schedulers.push_back(scheduler);
+    }
+    if(!m_thread) {
+        m_thread.reset(new Thread(std::bind(&Watchdog::run, this), "watchdog"));
+    }
+}
+
+void Watchdog::del(Scheduler* scheduler) {
+    MutexType::Lock lock(m_mutex);
+    auto it = std::find(m_schedulers.begin(), m_schedulers.end(), scheduler);
+    if(it != m_schedulers.end()) {
+        m_schedulers.erase(it);
+    }
+}
+
+size_t Watchdog::check() {
+    uint64_t budget_us = g_watchdog_budget->getValue() * 1000ull;
+    if(!budget_us) {
+        return 0;
+    }
+    size_t reported = 0;
+    MutexType::Lock lock(m_mutex);
+    uint64_t now_us = GetCurrentUS();
+    for(auto i : m_schedulers) {
+        reported += i->checkLongRunning(now_us, budget_us);
+    }
+    return reported;
+}
+
+void Watchdog::run() {
+    while(true) {
+        //预算为0时仍定期醒来,以便配置重新打开后生效
+        uint32_t budget_ms = g_watchdog_budget->getValue();
+        uint32_t interval_ms = budget_ms ? std::max(budget_ms / 4, (uint32_t)1) : 100;
+        usleep(interval_ms * 1000);
+        check();
+    }
+}
+
+}
@@ -0,0 +1,68 @@
+/**
+ * @file watchdog.h
+ * @brief 检测长时间占用工作线程的协程
+ * @author Zhujiayong
+ * @email zhujiayong_hhh@163.com
+ * @date 2025-04-11
+ * @copyright Copyright (c) 2025年 Zhujiayong All rights reserved
+ */
+#ifndef __SYLAR_WATCHDOG_H__
+#define __SYLAR_WATCHDOG_H__
+
+#include <vector>
+#include "thread.h"
+#include "mutex.h"
+#include "noncopyable.h"
+
+namespace Sylar {
+
+class Scheduler;
+
+/**
+ * @brief 协程看门狗
+ * @details 后台线程每隔预算的1/4检查一次所有已启动的调度器,
+ *          单次运行超过fiber.watchdog.budget_ms的任务输出协程id、运行时长和调用栈。
+ *          预算为0时关闭检查。调度器在start时自动注册,析构时注销
+ */
+class Watchdog : Noncopyable {
+public:
+    typedef Mutex MutexType;
+
+    /**
+     * @brief 返回全局实例(进程退出时不析构,避免后台线程访问已析构的对象)
+     */
+    static Watchdog* GetInstance();
+
+    /**
+     * @brief 注册调度器,首次注册时启动后台线程
+     */
+    void add(Scheduler* scheduler);
+
+    /**
+     * @brief 注销调度器,返回后不会再访问该调度器
+     */
+    void del(Scheduler* scheduler);
+
+    /**
+     * @brief 立即检查一次所有调度器
+     * @return 本次报告的任务数
+     */
+    size_t check();
+private:
+    Watchdog();
+
+    /**
+     * @brief 后台线程主函数
+     */
+    void run();
+private:
+    MutexType m_mutex;
+    /// 已注册的调度器
+    std::vector<Scheduler*> m_schedulers;
+    /// 后台线程
+    Thread::ptr m_thread;
+};
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "worker.h"
 #include "config.h"
 #include "util.h"
+#include <algorithm>
 
 namespace Sylar {
 
@@ -53,19 +54,41 @@ void WorkerManager::add(Scheduler::ptr s) {
     m_datas[s->getName()].push_back(s);
 }
 
-Scheduler::ptr WorkerManager::get(const std::string& name) {
+Scheduler::ptr WorkerManager::get(const std::string& name, int numa_node) {
     auto it = m_datas.find(name);
     if(it == m_datas.end()) {
         return nullptr;
     }
-    if(it->second.size() == 1) {
-        return it->second[0];
+    if(numa_node < 0) {
+        if(it->second.size() == 1) {
+            return it->second[0];
+        }
+        return it->second[rand() % it->second.size()];
+    }
+    //init为同一配置的多个实例分别注册为name、name-1、name-2...,按节点选择时在这一组中查找
+    std::vector<Scheduler::ptr> all = it->second;
+    std::string prefix = name + "-";
+    for(auto sit = m_datas.lower_bound(prefix); sit != m_datas.end()
+            && sit->first.compare(0, prefix.size(), prefix) == 0; ++sit) {
+        std::string suffix = sit->first.substr(prefix.size());
+        if(!suffix.empty() && suffix.find_first_not_of("0123456789") == std::string::npos) {
+            all.insert(all.end(), sit->second.begin(), sit->second.end());
+        }
+    }
+    std::vector<Scheduler::ptr> local;
+    for(auto& i : all) {
+        if(i->getCpuAffinity().numaNode == numa_node) {
+            local.push_back(i);
+        }
+    }
+    if(!local.empty()) {
+        return local[rand() % local.size()];
     }
     return it->second[rand() % it->second.size()];
 }
 
-IOManager::ptr WorkerManager::getAsIOManager(const std::string& name) {
-    return std::dynamic_pointer_cast<IOManager>(get(name));
+IOManager::ptr WorkerManager::getAsIOManager(const std::string& name, int numa_node) {
+    return std::dynamic_pointer_cast<IOManager>(get(name, numa_node));
 }
 
 bool WorkerManager::init(const std::map<std::string, std::map<std::string, std::string> >& v) {
@@ -77,16 +100,41 @@ bool WorkerManager::init(const std::map<std::string, std::map<std::string, std::
         int32_t thread_num = Sylar::GetParamValue(i.second, "thread_num", 1);
         // 从配置项中获取调度器实例数量，若未指定则默认为 1
         int32_t worker_num = Sylar::GetParamValue(i.second, "worker_num", 1);
+        // 是否开启工作窃取模式，未指定则使用 scheduler.work_stealing 的全局配置
+        int32_t work_stealing = Sylar::GetParamValue(i.second, "work_stealing", -1);
+        // 回调任务是否运行在共享栈协程上，适合承载大量长期挂起连接的调度器
+        int32_t shared_stack = Sylar::GetParamValue(i.second, "shared_stack", 0);
+        // 线程可运行的 CPU 列表，格式如 "0-7,16-23"
+        std::vector<int> cpus = CpuAffinity::ParseCpuList(Sylar::GetParamValue<std::string>(i.second, "cpus", ""));
+        // 绑定的 NUMA 节点列表，多个实例依次轮流绑定，如 "0,1"
+        std::vector<int> numa_nodes = CpuAffinity::ParseCpuList(Sylar::GetParamValue<std::string>(i.second, "numa_node", ""));
+        // thread: 每个线程独占一个 CPU；set(默认): 线程可在整个 CPU 集合上运行
+        bool per_thread = Sylar::GetParamValue<std::string>(i.second, "cpu_bind", "set") == "thread";
+        // 弹性线程数：排队等待超过 spawn_wait_ms 时增加线程直到 max_thread_num，增加的线程空闲 thread_idle_ms 后退出
+        ElasticConfig elastic;
+        elastic.maxThreads = std::max(Sylar::GetParamValue(i.second, "max_thread_num", thread_num), thread_num);
+        elastic.spawnWaitMs = Sylar::GetParamValue(i.second, "spawn_wait_ms", elastic.spawnWaitMs);
+        elastic.idleMs = Sylar::GetParamValue(i.second, "thread_idle_ms", elastic.idleMs);
 
         // 根据配置的实例数量创建调度器实例
         for(int32_t x = 0; x < worker_num; ++x) {
+            CpuAffinity affinity;
+            affinity.cpus = cpus;
+            affinity.perThread = per_thread;
+            if(!numa_nodes.empty()) {
+                affinity.numaNode = numa_nodes[x % numa_nodes.size()];
+            }
             Scheduler::ptr s;
             // 第一个调度器使用原始名称，后续调度器添加编号后缀
             if(!x) {
-                s = std::make_shared<IOManager>(thread_num, false, name);
+                s = std::make_shared<IOManager>(thread_num, false, name, affinity, elastic);
             } else {
-                s = std::make_shared<IOManager>(thread_num, false, name + "-" + std::to_string(x));
+                s = std::make_shared<IOManager>(thread_num, false, name + "-" + std::to_string(x), affinity, elastic);
+            }
+            if(work_stealing != -1) {
+                s->setWorkStealing(work_stealing);
             }
+            s->setSharedStack(shared_stack);
             // 将创建好的调度器实例添加到管理器中
             add(s);
         }
@@ -91,16 +91,19 @@ public:
     /**
      * @brief 根据名称获取对应的调度器实例。
      * @param name 调度器的名称。
+     * @param numa_node 优先返回绑定在该 NUMA 节点上的实例，-1 表示不限制；按节点选择时同时查找
+     *                  同一配置创建的 name-1、name-2 等实例，没有匹配的实例时在该名称的实例中选择。
      * @return 返回指向调度器的智能指针，如果未找到则返回空指针。
      */
-    Scheduler::ptr get(const std::string& name);
+    Scheduler::ptr get(const std::string& name, int numa_node = -1);
 
     /**
      * @brief 根据名称获取对应的 IO 调度器实例。
      * @param name 调度器的名称。
+     * @param numa_node 优先返回绑定在该 NUMA 节点上的实例，-1 表示不限制。
      * @return 返回指向 IO 调度器的智能指针，如果未找到则返回空指针。
      */
-    IOManager::ptr getAsIOManager(const std::string& name);
+    IOManager::ptr getAsIOManager(const std::string& name, int numa_node = -1);
 
     /**
      * @brief 向指定名称的调度器中调度一个任务。
@@ -0,0 +1,78 @@
+#include "Sylar/sylar.h"
+#include "Sylar/histogram.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_rounds = 5000;
+
+/**
+ * @brief 普通线程作为客户端,每次往返之间稍作停顿,让服务端线程回到空闲等待,统计往返延迟
+ */
+void test_ping(uint32_t busy_poll_us) {
+    Sylar::Config::Lookup<uint32_t>("iomanager.busy_poll_us")->setValue(busy_poll_us);
+    Sylar::Histogram rtt;
+    std::string dump;
+    {
+        Sylar::IOManager iom(1, false, "busy_poll");
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        bind(sock, (sockaddr*)&addr, len);
+        listen(sock, 16);
+        getsockname(sock, (sockaddr*)&addr, &len);
+
+        iom.schedule([sock](){
+            int client = accept(sock, nullptr, nullptr);
+            char buf[64];
+            while(true) {
+                int n = read(client, buf, sizeof(buf));
+                if(n <= 0 || write(client, buf, n) != n) {
+                    break;
+                }
+            }
+            close(client);
+            close(sock);
+        });
+
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(connect(fd, (const sockaddr*)&addr, sizeof(addr)) == 0) {
+            char buf[16] = {0};
+            for(int i = 0; i < s_rounds; ++i) {
+                uint64_t begin = Sylar::GetCurrentUS();
+                if(send(fd, buf, sizeof(buf), 0) != sizeof(buf)
+                        || recv(fd, buf, sizeof(buf), MSG_WAITALL) != sizeof(buf)) {
+                    break;
+                }
+                rtt.add(Sylar::GetCurrentUS() - begin);
+                usleep(20);
+            }
+        }
+        std::stringstream ss;
+        iom.dump(ss);
+        dump = ss.str();
+        close(fd);
+    }
+    std::stringstream ss;
+    rtt.dump(ss);
+    SYLAR_LOG_INFO(g_logger) << "busy_poll_us=" << busy_poll_us
+        << " rtt_us: " << ss.str();
+    size_t pos = dump.find("wakeups=");
+    if(pos != std::string::npos) {
+        SYLAR_LOG_INFO(g_logger) << dump.substr(pos, dump.find('\n', pos) - pos);
+    }
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    test_ping(0);
+    test_ping(50);
+    test_ping(200);
+    return 0;
+}
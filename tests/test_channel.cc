@@ -0,0 +1,101 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_producers = 4;
+static const int s_count = 100000;
+
+/**
+ * @brief 多个生产者/消费者通过小容量通道传递数据,校验总和
+ */
+void test_mpmc(bool batch) {
+    Sylar::Channel<int>::ptr chan(new Sylar::Channel<int>(64));
+    Sylar::WaitGroup producers;
+    std::atomic<uint64_t> sum {0};
+    std::atomic<int> received {0};
+    uint64_t begin = Sylar::GetCurrentUS();
+    {
+        Sylar::IOManager iom(4, false, "chan");
+        for(int p = 0; p < s_producers; ++p) {
+            producers.add();
+            iom.schedule([chan, &producers, p, batch](){
+                std::vector<int> buf;
+                for(int i = 1; i <= s_count; ++i) {
+                    if(!batch) {
+                        chan->send(i);
+                        continue;
+                    }
+                    buf.push_back(i);
+                    if(buf.size() == 32 || i == s_count) {
+                        chan->sendBatch(buf.begin(), buf.end());
+                        buf.clear();
+                    }
+                }
+                producers.done();
+            });
+        }
+        for(int c = 0; c < 2; ++c) {
+            iom.schedule([chan, &sum, &received, batch](){
+                std::vector<int> buf;
+                int v = 0;
+                while(true) {
+                    if(batch) {
+                        buf.clear();
+                        if(!chan->recvBatch(buf, 32)) {
+                            break;
+                        }
+                        for(auto i : buf) {
+                            sum += i;
+                        }
+                        received += buf.size();
+                    } else {
+                        if(!chan->recv(v)) {
+                            break;
+                        }
+                        sum += v;
+                        ++received;
+                    }
+                }
+            });
+        }
+        iom.schedule([chan, &producers](){
+            producers.wait();
+            chan->close();
+        });
+    }
+    uint64_t expect = (uint64_t)s_producers * s_count * (s_count + 1) / 2;
+    uint64_t used = Sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "batch=" << batch
+        << " received=" << received
+        << " sum_ok=" << (sum == expect)
+        << " used=" << used / 1000 << "ms"
+        << " msgs/s=" << (used ? (uint64_t)received * 1000000 / used : 0);
+}
+
+void test_try_send() {
+    Sylar::Channel<std::string> chan(2);
+    std::string a = "a";
+    bool r1 = chan.trySend(a);
+    bool r2 = chan.trySend(std::string("b"));
+    std::string c = "c";
+    bool r3 = chan.trySend(c);
+    chan.close();
+    std::string v;
+    int left = 0;
+    while(chan.recv(v)) {
+        ++left;
+    }
+    SYLAR_LOG_INFO(g_logger) << "try_send " << r1 << r2 << r3
+        << " kept=" << c << " drained=" << left
+        << " send_after_close=" << chan.send("d");
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    test_try_send();
+    test_mpmc(false);
+    test_mpmc(true);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "Sylar/sylar.h"
+#include "Sylar/coroutine.h"
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+#ifdef SYLAR_HAS_COROUTINE
+
+Sylar::Task<void> echo(Sylar::Socket::ptr client) {
+    char buf[1024];
+    while(true) {
+        ssize_t n = co_await Sylar::AsyncRecv(client, buf, sizeof(buf));
+        if(n <= 0) {
+            break;
+        }
+        ssize_t offset = 0;
+        while(offset < n) {
+            ssize_t rt = co_await Sylar::AsyncSend(client, buf + offset, n - offset);
+            if(rt <= 0) {
+                co_return;
+            }
+            offset += rt;
+        }
+    }
+}
+
+Sylar::Task<void> server(Sylar::Socket::ptr sock) {
+    while(true) {
+        Sylar::Socket::ptr client = co_await Sylar::AsyncAccept(sock);
+        if(!client) {
+            break;
+        }
+        Sylar::Spawn(echo(client));
+    }
+}
+
+Sylar::Task<int> client(Sylar::Address::ptr addr, int rounds) {
+    Sylar::Socket::ptr sock = Sylar::Socket::CreateTCP(addr);
+    if(!co_await Sylar::AsyncConnect(sock, addr, 1000)) {
+        SYLAR_LOG_ERROR(g_logger) << "connect " << *addr << " failed";
+        co_return -1;
+    }
+    int ok = 0;
+    char buf[64];
+    for(int i = 0; i < rounds; ++i) {
+        std::string msg = "hello " + std::to_string(i);
+        co_await Sylar::AsyncSend(sock, msg.c_str(), msg.size());
+        ssize_t n = co_await Sylar::AsyncRecv(sock, buf, sizeof(buf));
+        if(n == (ssize_t)msg.size() && std::string(buf, n) == msg) {
+            ++ok;
+        }
+    }
+    co_return ok;
+}
+
+Sylar::Task<void> sleeper() {
+    uint64_t begin = Sylar::GetCurrentMS();
+    co_await Sylar::SleepFor(std::chrono::milliseconds(100));
+    SYLAR_LOG_INFO(g_logger) << "sleep 100ms used=" << (Sylar::GetCurrentMS() - begin) << "ms";
+}
+
+void run() {
+    Sylar::Address::ptr addr = Sylar::Address::LookupAnyIPAddress("127.0.0.1:8033");
+    Sylar::Socket::ptr sock = Sylar::Socket::CreateTCP(addr);
+    if(!sock->bind(addr) || !sock->listen()) {
+        SYLAR_LOG_ERROR(g_logger) << "bind/listen " << *addr << " failed";
+        return;
+    }
+    Sylar::Spawn(server(sock));
+    Sylar::Spawn(sleeper());
+
+    //在Fiber中等待协程结果
+    int ok = Sylar::SyncWait(client(addr, 1000));
+    SYLAR_LOG_INFO(g_logger) << "echo rounds ok=" << ok;
+    sock->close();
+}
+
+int main(int argc, char** argv) {
+    Sylar::IOManager iom(2);
+    iom.schedule(run);
+    return 0;
+}
+
+#else
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_INFO(g_logger) << "C++20 coroutines not enabled";
+    return 0;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 不让出的计算任务
+ */
+void busy_loop(uint64_t ms) {
+    uint64_t end = Sylar::GetCurrentMS() + ms;
+    while(Sylar::GetCurrentMS() < end) {
+    }
+}
+
+/**
+ * @brief 积压时增加线程,空闲后退回最少线程数
+ */
+void test_elastic() {
+    Sylar::ElasticConfig elastic;
+    elastic.maxThreads = 4;
+    elastic.spawnWaitMs = 10;
+    elastic.idleMs = 200;
+    Sylar::IOManager iom(1, false, "elastic", Sylar::CpuAffinity(), elastic);
+    std::atomic<int> count {0};
+    for(int i = 0; i < 40; ++i) {
+        iom.schedule([&count](){
+            busy_loop(10);
+            ++count;
+        });
+    }
+    while(count < 40) {
+        usleep(10 * 1000);
+    }
+    SYLAR_LOG_INFO(g_logger) << "busy: count=" << count << " threads=" << iom.getThreadCount();
+    //空闲线程最长3秒醒来一次检查是否退出
+    for(int i = 0; i < 50 && iom.getThreadCount() > 1; ++i) {
+        usleep(100 * 1000);
+    }
+    std::stringstream ss;
+    iom.dump(ss);
+    SYLAR_LOG_INFO(g_logger) << "idle: threads=" << iom.getThreadCount() << std::endl << ss.str();
+
+    //退出后的槽位可以再次增加线程
+    count = 0;
+    for(int i = 0; i < 20; ++i) {
+        iom.schedule([&count](){
+            busy_loop(10);
+            ++count;
+        });
+    }
+    while(count < 20) {
+        usleep(10 * 1000);
+    }
+    SYLAR_LOG_INFO(g_logger) << "busy again: threads=" << iom.getThreadCount();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::INFO);
+    test_elastic();
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "Sylar/sylar.h"
+#include "Sylar/radix_table.h"
+#include <atomic>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 多个线程同时访问同一批分段,每个下标只对应一个元素且地址不变
+ */
+void test_radix_table() {
+    Sylar::RadixTable<std::atomic<int> > table;
+    std::atomic<int*> first[4096];
+    for(auto& i : first) {
+        i = nullptr;
+    }
+    std::atomic<int> moved {0};
+    std::vector<Sylar::Thread::ptr> thrs;
+    for(int t = 0; t < 4; ++t) {
+        thrs.push_back(Sylar::Thread::ptr(new Sylar::Thread([&](){
+            for(int i = 0; i < 4096; ++i) {
+                //跨越多个叶子,间隔访问使叶子创建交错发生
+                size_t index = (size_t)i * 977;
+                std::atomic<int>* p = table.get(index);
+                ++*p;
+                int* expect = nullptr;
+                if(!first[i].compare_exchange_strong(expect, (int*)p) && expect != (int*)p) {
+                    ++moved;
+                }
+            }
+        }, "radix_" + std::to_string(t))));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    int sum = 0;
+    table.foreach([&sum](std::atomic<int>& v, size_t){
+        sum += v;
+    });
+    SYLAR_LOG_INFO(g_logger) << "radix_table sum=" << sum << " moved=" << moved
+        << " out_of_range=" << (table.get(decltype(table)::CAPACITY) == nullptr);
+}
+
+/**
+ * @brief 多线程并发查找FdManager
+ */
+void test_fd_manager() {
+    static const int s_fds = 2000;
+    for(int i = 0; i < s_fds; ++i) {
+        Sylar::FdMgr::GetInstance()->get(10000 + i, true);
+    }
+    std::atomic<int> miss {0};
+    uint64_t begin = Sylar::GetCurrentUS();
+    std::vector<Sylar::Thread::ptr> thrs;
+    for(int t = 0; t < 4; ++t) {
+        thrs.push_back(Sylar::Thread::ptr(new Sylar::Thread([&miss](){
+            for(int r = 0; r < 500; ++r) {
+                for(int i = 0; i < s_fds; ++i) {
+                    if(!Sylar::FdMgr::GetInstance()->get(10000 + i)) {
+                        ++miss;
+                    }
+                }
+            }
+        }, "fdmgr_" + std::to_string(t))));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = Sylar::GetCurrentUS() - begin;
+    for(int i = 0; i < s_fds; ++i) {
+        Sylar::FdMgr::GetInstance()->del(10000 + i);
+    }
+    SYLAR_LOG_INFO(g_logger) << "fd_manager get miss=" << miss
+        << " after_del=" << (Sylar::FdMgr::GetInstance()->get(10000) == nullptr)
+        << " used=" << used / 1000 << "ms"
+        << " ns/get=" << used * 1000 / (4 * 500 * s_fds);
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    test_radix_table();
+    test_fd_manager();
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 持锁期间执行hook的sleep,其他协程挂起等待而不阻塞线程
+ */
+void test_mutex() {
+    Sylar::FiberMutex mutex;
+    Sylar::WaitGroup wg;
+    int count = 0;
+    std::atomic<int> other {0};
+    uint64_t begin = Sylar::GetCurrentMS();
+    {
+        Sylar::IOManager iom(2, false, "mutex");
+        for(int i = 0; i < 20; ++i) {
+            wg.add();
+            iom.schedule([&](){
+                Sylar::FiberMutex::Lock lock(mutex);
+                int v = count;
+                usleep(5 * 1000);
+                count = v + 1;
+                wg.done();
+            });
+        }
+        //锁被长时间持有期间,其他协程仍能在同一批线程上运行
+        for(int i = 0; i < 1000; ++i) {
+            iom.schedule([&other](){ ++other;});
+        }
+        iom.schedule([&wg](){ wg.wait();});
+    }
+    SYLAR_LOG_INFO(g_logger) << "mutex count=" << count << " other=" << other
+        << " used=" << (Sylar::GetCurrentMS() - begin) << "ms";
+}
+
+void test_condition() {
+    Sylar::FiberMutex mutex;
+    Sylar::FiberCondition cond;
+    std::list<int> queue;
+    bool stop = false;
+    int sum = 0;
+    {
+        Sylar::IOManager iom(2, false, "cond");
+        iom.schedule([&](){
+            while(true) {
+                Sylar::FiberMutex::Lock lock(mutex);
+                cond.wait(lock, [&](){ return stop || !queue.empty();});
+                if(queue.empty()) {
+                    break;
+                }
+                sum += queue.front();
+                queue.pop_front();
+            }
+        });
+        iom.schedule([&](){
+            for(int i = 1; i <= 1000; ++i) {
+                Sylar::FiberMutex::Lock lock(mutex);
+                queue.push_back(i);
+                cond.notifyOne();
+            }
+            Sylar::FiberMutex::Lock lock(mutex);
+            stop = true;
+            cond.notifyAll();
+        });
+    }
+    SYLAR_LOG_INFO(g_logger) << "condition sum=" << sum;
+}
+
+void test_rwmutex() {
+    Sylar::FiberRWMutex mutex;
+    std::atomic<int> readers {0};
+    std::atomic<int> max_readers {0};
+    std::atomic<bool> bad {false};
+    int value = 0;
+    {
+        Sylar::IOManager iom(2, false, "rw");
+        for(int i = 0; i < 50; ++i) {
+            iom.schedule([&, i](){
+                if(i % 10 == 0) {
+                    Sylar::FiberRWMutex::WriteLock lock(mutex);
+                    if(readers) {
+                        bad = true;
+                    }
+                    ++value;
+                    usleep(1000);
+                } else {
+                    Sylar::FiberRWMutex::ReadLock lock(mutex);
+                    int r = ++readers;
+                    if(r > max_readers) {
+                        max_readers = r;
+                    }
+                    usleep(1000);
+                    --readers;
+                }
+            });
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "rwmutex value=" << value
+        << " max_readers=" << max_readers << " bad=" << bad;
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    test_mutex();
+    test_condition();
+    test_rwmutex();
+    return 0;
+}
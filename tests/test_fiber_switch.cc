@@ -0,0 +1,35 @@
+#include "Sylar/sylar.h"
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static Sylar::Fiber* s_fiber = nullptr;
+static bool s_stop = false;
+
+void ping_pong() {
+    while(!s_stop) {
+        s_fiber->back();
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t count = argc > 1 ? atoll(argv[1]) : 10000000;
+    Sylar::Fiber::GetThis();
+    Sylar::Fiber::ptr fiber(new Sylar::Fiber(&ping_pong, 0, true));
+    s_fiber = fiber.get();
+
+    uint64_t begin = Sylar::GetCurrentUS();
+    for(uint64_t i = 0; i < count; ++i) {
+        fiber->call();
+    }
+    uint64_t used = Sylar::GetCurrentUS() - begin;
+    s_stop = true;
+    fiber->call();
+
+    //每次call/back往返包含两次切换
+    SYLAR_LOG_INFO(g_logger) << "context=" << Sylar::GetFiberContextName()
+        << " switches=" << count * 2
+        << " used=" << used << "us"
+        << " switches/s=" << (used ? count * 2 * 1000000 / used : 0)
+        << " ns/switch=" << (count ? used * 1000.0 / (count * 2) : 0);
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 并发发起多个"RPC",等待全部完成后汇总结果
+ */
+void test_when_all() {
+    std::vector<Sylar::Future<int> > futures;
+    for(int i = 0; i < 10; ++i) {
+        futures.push_back(Sylar::Async([i](){
+            usleep(10 * 1000 * (10 - i));
+            return i * i;
+        }));
+    }
+    uint64_t begin = Sylar::GetCurrentMS();
+    Sylar::WhenAll(futures).wait();
+    int sum = 0;
+    for(auto& i : futures) {
+        sum += i.get();
+    }
+    SYLAR_LOG_INFO(g_logger) << "when_all sum=" << sum
+        << " used=" << (Sylar::GetCurrentMS() - begin) << "ms";
+
+    Sylar::Future<std::string> name = Sylar::Async([](){
+        usleep(20 * 1000);
+        return std::string("sylar");
+    });
+    Sylar::Future<void> fail = Sylar::Async([](){
+        throw std::runtime_error("db error");
+    });
+    size_t first = Sylar::WhenAny(name, fail).get();
+    Sylar::WhenAll(name, fail).wait();
+    try {
+        fail.get();
+    } catch (std::exception& ex) {
+        SYLAR_LOG_INFO(g_logger) << "when_any first=" << first
+            << " name=" << name.get() << " fail=" << ex.what();
+    }
+}
+
+/**
+ * @brief WaitGroup 等待一组协程,Fiber::join 等待单个协程
+ */
+void test_wait_group() {
+    Sylar::WaitGroup wg;
+    std::atomic<int> count {0};
+    for(int i = 0; i < 100; ++i) {
+        wg.add();
+        Sylar::Scheduler::GetThis()->schedule([&wg, &count](){
+            usleep(1000);
+            ++count;
+            wg.done();
+        });
+    }
+    wg.wait();
+    SYLAR_LOG_INFO(g_logger) << "wait_group count=" << count;
+
+    Sylar::Fiber::ptr fiber(new Sylar::Fiber([](){
+        usleep(10 * 1000);
+    }));
+    Sylar::Scheduler::GetThis()->schedule(fiber);
+    fiber->join();
+    SYLAR_LOG_INFO(g_logger) << "join state=" << fiber->getState();
+
+    //回调任务只能通过Fiber::GetThis()取得协程,不让出直接结束后仍可join。
+    //放在单独的调度器上,结束后该线程不再执行其他回调
+    Sylar::IOManager other(1, false, "join");
+    std::shared_ptr<Sylar::Fiber::ptr> self(new Sylar::Fiber::ptr);
+    Sylar::WaitGroup started;
+    started.add();
+    other.schedule([self, &started](){
+        *self = Sylar::Fiber::GetThis();
+        started.done();
+    });
+    started.wait();
+    //等调度线程处理完结束的回调协程,它不能被当作空闲协程重置后复用
+    usleep(10 * 1000);
+    (*self)->join();
+    SYLAR_LOG_INFO(g_logger) << "callback join state=" << (*self)->getState();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    Sylar::IOManager iom(2, false, "future");
+    iom.schedule(test_when_all);
+    iom.schedule(test_wait_group);
+
+    //在非协程线程中等待
+    Sylar::Future<int> f = Sylar::Async([](){ return 42;}, &iom);
+    SYLAR_LOG_INFO(g_logger) << "thread wait value=" << f.get();
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_clients = 16;
+static const int s_rounds = 2000;
+
+/**
+ * @brief 监听127.0.0.1的随机端口
+ */
+int listen_local(sockaddr_in& addr) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    int val = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if(bind(sock, (sockaddr*)&addr, len) || listen(sock, 128)) {
+        SYLAR_LOG_ERROR(g_logger) << "listen errno=" << errno;
+        return -1;
+    }
+    getsockname(sock, (sockaddr*)&addr, &len);
+    return sock;
+}
+
+/**
+ * @brief 多个客户端与回显服务端往返小包,统计吞吐
+ */
+void test_echo(const std::string& backend, uint32_t fixed_files, uint32_t buffers) {
+    Sylar::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+    Sylar::Config::Lookup<uint32_t>("iomanager.io_uring.fixed_files")->setValue(fixed_files);
+    Sylar::Config::Lookup<uint32_t>("iomanager.io_uring.buffer_count")->setValue(buffers);
+    std::atomic<int> ok {0};
+    bool uring = false;
+    uint64_t begin = Sylar::GetCurrentUS();
+    {
+        Sylar::IOManager iom(2, false, "echo");
+        uring = iom.isIoUring();
+        iom.schedule([&iom, &ok](){
+            sockaddr_in addr;
+            int sock = listen_local(addr);
+            for(int i = 0; i < s_clients; ++i) {
+                iom.schedule([addr, &ok](){
+                    int fd = socket(AF_INET, SOCK_STREAM, 0);
+                    if(connect(fd, (const sockaddr*)&addr, sizeof(addr))) {
+                        SYLAR_LOG_ERROR(g_logger) << "connect errno=" << errno;
+                        close(fd);
+                        return;
+                    }
+                    char buf[64];
+                    for(int r = 0; r < s_rounds; ++r) {
+                        memset(buf, r & 0xff, sizeof(buf));
+                        if(send(fd, buf, sizeof(buf), 0) != sizeof(buf)) {
+                            break;
+                        }
+                        size_t got = 0;
+                        while(got < sizeof(buf)) {
+                            int n = recv(fd, buf + got, sizeof(buf) - got, 0);
+                            if(n <= 0) {
+                                break;
+                            }
+                            got += n;
+                        }
+                        if(got != sizeof(buf) || (uint8_t)buf[63] != (r & 0xff)) {
+                            break;
+                        }
+                        ++ok;
+                    }
+                    close(fd);
+                });
+            }
+            for(int i = 0; i < s_clients; ++i) {
+                int client = accept(sock, nullptr, nullptr);
+                if(client < 0) {
+                    break;
+                }
+                Sylar::IOManager::GetThis()->schedule([client](){
+                    char buf[256];
+                    while(true) {
+                        int n = read(client, buf, sizeof(buf));
+                        if(n <= 0 || write(client, buf, n) != n) {
+                            break;
+                        }
+                    }
+                    close(client);
+                });
+            }
+            close(sock);
+        });
+    }
+    uint64_t used = Sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "backend=" << backend << " io_uring=" << uring
+        << " fixed_files=" << fixed_files << " buffers=" << buffers
+        << " round_trips=" << ok << "/" << s_clients * s_rounds
+        << " used=" << used / 1000 << "ms"
+        << " rtt/s=" << (used ? (uint64_t)ok * 1000000 / used : 0);
+}
+
+/**
+ * @brief 接收超时,以及等待中的句柄被其他协程关闭
+ */
+void test_timeout_and_close(const std::string& backend) {
+    Sylar::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+    int timeout_errno = 0;
+    uint64_t timeout_used = 0;
+    int close_errno = 0;
+    {
+        Sylar::IOManager iom(1, false, "timeout");
+        iom.schedule([&](){
+            sockaddr_in addr;
+            int sock = listen_local(addr);
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            connect(fd, (const sockaddr*)&addr, sizeof(addr));
+            int peer = accept(sock, nullptr, nullptr);
+
+            timeval tv = {0, 50 * 1000};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            char buf[16];
+            uint64_t begin = Sylar::GetCurrentMS();
+            if(recv(fd, buf, sizeof(buf), 0) < 0) {
+                timeout_errno = errno;
+            }
+            timeout_used = Sylar::GetCurrentMS() - begin;
+
+            Sylar::IOManager::GetThis()->addTimer(20, Sylar::InlineTask([peer](){
+                close(peer);
+            }));
+            if(read(peer, buf, sizeof(buf)) < 0) {
+                close_errno = errno;
+            }
+            close(fd);
+            close(sock);
+        });
+    }
+    SYLAR_LOG_INFO(g_logger) << "backend=" << backend
+        << " timeout errno=" << timeout_errno << " (" << strerror(timeout_errno) << ")"
+        << " used=" << timeout_used << "ms"
+        << " close errno=" << close_errno << " (" << strerror(close_errno) << ")";
+}
+
+/**
+ * @brief UDP往返,服务端用recvfrom取得的对端地址sendto回复
+ */
+void test_udp(const std::string& backend) {
+    Sylar::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+    std::atomic<int> ok {0};
+    {
+        Sylar::IOManager iom(2, false, "udp");
+        iom.schedule([&iom, &ok](){
+            int server = socket(AF_INET, SOCK_DGRAM, 0);
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t len = sizeof(addr);
+            if(bind(server, (sockaddr*)&addr, len)) {
+                SYLAR_LOG_ERROR(g_logger) << "bind errno=" << errno;
+                close(server);
+                return;
+            }
+            getsockname(server, (sockaddr*)&addr, &len);
+            //丢包时不至于一直等待
+            timeval tv = {1, 0};
+            setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+            iom.schedule([addr, &ok](){
+                int fd = socket(AF_INET, SOCK_DGRAM, 0);
+                timeval tv = {1, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                char buf[64];
+                for(int r = 0; r < s_rounds; ++r) {
+                    memset(buf, r & 0xff, sizeof(buf));
+                    if(sendto(fd, buf, sizeof(buf), 0, (const sockaddr*)&addr, sizeof(addr)) != sizeof(buf)) {
+                        break;
+                    }
+                    sockaddr_in from;
+                    socklen_t from_len = sizeof(from);
+                    int n = recvfrom(fd, buf, sizeof(buf), 0, (sockaddr*)&from, &from_len);
+                    if(n != sizeof(buf) || (uint8_t)buf[63] != (r & 0xff)
+                            || from_len != sizeof(from) || from.sin_port != addr.sin_port) {
+                        break;
+                    }
+                    ++ok;
+                }
+                close(fd);
+            });
+
+            char buf[256];
+            for(int r = 0; r < s_rounds; ++r) {
+                sockaddr_in from;
+                socklen_t from_len = sizeof(from);
+                int n = recvfrom(server, buf, sizeof(buf), 0, (sockaddr*)&from, &from_len);
+                if(n <= 0 || sendto(server, buf, n, 0, (const sockaddr*)&from, from_len) != n) {
+                    break;
+                }
+            }
+            close(server);
+        });
+    }
+    SYLAR_LOG_INFO(g_logger) << "backend=" << backend
+        << " udp round_trips=" << ok << "/" << s_rounds;
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    test_echo("epoll", 0, 0);
+    test_echo("io_uring", 0, 0);
+    test_echo("io_uring", 1024, 64);
+    test_timeout_and_close("epoll");
+    test_timeout_and_close("io_uring");
+    test_udp("epoll");
+    test_udp("io_uring");
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_clients = 16;
+static const int s_rounds = 2000;
+
+/**
+ * @brief 回显服务端的连接处理协程在多reactor模式下应始终在同一线程上恢复,统计线程切换次数
+ */
+void test_echo(bool multi, const std::string& assign) {
+    Sylar::Config::Lookup<bool>("iomanager.multi_reactor")->setValue(multi);
+    Sylar::Config::Lookup<std::string>("iomanager.reactor_assign")->setValue(assign);
+    std::atomic<int> ok {0};
+    std::atomic<int> migrations {0};
+    std::string dump;
+    uint64_t begin = Sylar::GetCurrentUS();
+    {
+        Sylar::IOManager iom(4, false, "reactor");
+        iom.schedule([&](){
+            int sock = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t len = sizeof(addr);
+            bind(sock, (sockaddr*)&addr, len);
+            listen(sock, 128);
+            getsockname(sock, (sockaddr*)&addr, &len);
+            for(int i = 0; i < s_clients; ++i) {
+                iom.schedule([addr, &ok](){
+                    int fd = socket(AF_INET, SOCK_STREAM, 0);
+                    if(connect(fd, (const sockaddr*)&addr, sizeof(addr))) {
+                        close(fd);
+                        return;
+                    }
+                    char buf[64] = {0};
+                    for(int r = 0; r < s_rounds; ++r) {
+                        if(send(fd, buf, sizeof(buf), 0) != sizeof(buf)
+                                || recv(fd, buf, sizeof(buf), MSG_WAITALL) != sizeof(buf)) {
+                            break;
+                        }
+                        ++ok;
+                    }
+                    close(fd);
+                });
+            }
+            for(int i = 0; i < s_clients; ++i) {
+                int client = accept(sock, nullptr, nullptr);
+                if(client < 0) {
+                    break;
+                }
+                int thread = iom.assignFd(client);
+                iom.schedule([client, &migrations](){
+                    char buf[256];
+                    int last = Sylar::GetThreadId();
+                    while(true) {
+                        int n = read(client, buf, sizeof(buf));
+                        if(n <= 0 || write(client, buf, n) != n) {
+                            break;
+                        }
+                        if(Sylar::GetThreadId() != last) {
+                            ++migrations;
+                            last = Sylar::GetThreadId();
+                        }
+                    }
+                    close(client);
+                }, thread);
+            }
+            close(sock);
+            std::stringstream ss;
+            iom.dump(ss);
+            dump = ss.str();
+        });
+    }
+    uint64_t used = Sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "multi_reactor=" << multi << " assign=" << assign
+        << " round_trips=" << ok << "/" << s_clients * s_rounds
+        << " server_migrations=" << migrations
+        << " used=" << used / 1000 << "ms";
+    size_t pos = dump.find("    io:");
+    if(pos != std::string::npos) {
+        SYLAR_LOG_INFO(g_logger) << dump.substr(pos + 4);
+    }
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    test_echo(false, "round_robin");
+    test_echo(true, "round_robin");
+    test_echo(true, "least_loaded");
+    return 0;
+}
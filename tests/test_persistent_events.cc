@@ -0,0 +1,192 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_clients = 16;
+static const int s_rounds = 2000;
+
+/**
+ * @brief 监听127.0.0.1的随机端口
+ */
+int listen_local(sockaddr_in& addr) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if(bind(sock, (sockaddr*)&addr, len) || listen(sock, 128)) {
+        SYLAR_LOG_ERROR(g_logger) << "listen errno=" << errno;
+        return -1;
+    }
+    getsockname(sock, (sockaddr*)&addr, &len);
+    return sock;
+}
+
+/**
+ * @brief 回显往返,比较两种注册方式的epoll_ctl调用次数
+ */
+void test_echo(bool persistent, bool multi) {
+    Sylar::Config::Lookup<bool>("iomanager.persistent_events")->setValue(persistent);
+    Sylar::Config::Lookup<bool>("iomanager.multi_reactor")->setValue(multi);
+    std::atomic<int> ok {0};
+    std::atomic<int> done {0};
+    std::string dump;
+    uint64_t begin = Sylar::GetCurrentUS();
+    {
+        Sylar::IOManager iom(2, false, "persistent");
+        iom.schedule([&](){
+            sockaddr_in addr;
+            int sock = listen_local(addr);
+            for(int i = 0; i < s_clients; ++i) {
+                iom.schedule([&iom, addr, &ok, &done, &dump](){
+                    int fd = socket(AF_INET, SOCK_STREAM, 0);
+                    if(connect(fd, (const sockaddr*)&addr, sizeof(addr))) {
+                        close(fd);
+                        return;
+                    }
+                    char buf[64];
+                    for(int r = 0; r < s_rounds; ++r) {
+                        memset(buf, r & 0xff, sizeof(buf));
+                        if(send(fd, buf, sizeof(buf), 0) != sizeof(buf)
+                                || recv(fd, buf, sizeof(buf), MSG_WAITALL) != sizeof(buf)
+                                || (uint8_t)buf[63] != (r & 0xff)) {
+                            break;
+                        }
+                        ++ok;
+                    }
+                    close(fd);
+                    //最后一个结束的客户端记录统计
+                    if(++done == s_clients) {
+                        std::stringstream ss;
+                        iom.dump(ss);
+                        dump = ss.str();
+                    }
+                });
+            }
+            for(int i = 0; i < s_clients; ++i) {
+                int client = accept(sock, nullptr, nullptr);
+                if(client < 0) {
+                    break;
+                }
+                iom.schedule([client](){
+                    char buf[256];
+                    while(true) {
+                        int n = read(client, buf, sizeof(buf));
+                        if(n <= 0 || write(client, buf, n) != n) {
+                            break;
+                        }
+                    }
+                    close(client);
+                }, iom.assignFd(client));
+            }
+            close(sock);
+        });
+    }
+    uint64_t used = Sylar::GetCurrentUS() - begin;
+    size_t pos = dump.find("epoll_ctl=");
+    SYLAR_LOG_INFO(g_logger) << "persistent=" << persistent << " multi_reactor=" << multi
+        << " round_trips=" << ok << "/" << s_clients * s_rounds
+        << " used=" << used / 1000 << "ms"
+        << " " << (pos == std::string::npos ? "" : dump.substr(pos));
+}
+
+/**
+ * @brief 持久注册下的接收超时、对端关闭以及关闭后编号复用
+ */
+void test_timeout_and_reuse() {
+    Sylar::Config::Lookup<bool>("iomanager.persistent_events")->setValue(true);
+    Sylar::Config::Lookup<bool>("iomanager.multi_reactor")->setValue(false);
+    int timeout_errno = 0;
+    uint64_t timeout_used = 0;
+    int eof = -1;
+    int reused = 0;
+    {
+        Sylar::IOManager iom(1, false, "persistent");
+        iom.schedule([&](){
+            sockaddr_in addr;
+            int sock = listen_local(addr);
+            for(int round = 0; round < 3; ++round) {
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                connect(fd, (const sockaddr*)&addr, sizeof(addr));
+                int peer = accept(sock, nullptr, nullptr);
+
+                timeval tv = {0, 50 * 1000};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                char buf[16];
+                uint64_t begin = Sylar::GetCurrentMS();
+                if(recv(fd, buf, sizeof(buf), 0) < 0) {
+                    timeout_errno = errno;
+                }
+                timeout_used = Sylar::GetCurrentMS() - begin;
+
+                //对端稍后写入再关闭,数据和EOF都要能等到
+                Sylar::IOManager::GetThis()->addTimer(10, [peer](){
+                    write(peer, "x", 1);
+                    close(peer);
+                });
+                if(recv(fd, buf, sizeof(buf), 0) == 1) {
+                    eof = recv(fd, buf, sizeof(buf), 0);
+                    ++reused;
+                }
+                //关闭后下一轮的句柄通常会复用同一编号
+                close(fd);
+            }
+            close(sock);
+        });
+    }
+    SYLAR_LOG_INFO(g_logger) << "persistent timeout errno=" << timeout_errno
+        << " (" << strerror(timeout_errno) << ") used=" << timeout_used << "ms"
+        << " eof=" << eof << " rounds=" << reused << "/3";
+}
+
+/**
+ * @brief 句柄在未开启hook的普通线程中关闭,编号复用后的新句柄仍要重新注册并收到事件
+ */
+void test_close_elsewhere() {
+    Sylar::Config::Lookup<bool>("iomanager.persistent_events")->setValue(true);
+    int reused = 0;
+    {
+        Sylar::IOManager iom(1, false, "persistent");
+        iom.schedule([&](){
+            sockaddr_in addr;
+            int sock = listen_local(addr);
+            for(int round = 0; round < 3; ++round) {
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                connect(fd, (const sockaddr*)&addr, sizeof(addr));
+                int peer = accept(sock, nullptr, nullptr);
+
+                timeval tv = {0, 500 * 1000};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                Sylar::IOManager::GetThis()->addTimer(10, [peer](){
+                    write(peer, "x", 1);
+                    close(peer);
+                });
+                char buf[16];
+                if(recv(fd, buf, sizeof(buf), 0) == 1) {
+                    ++reused;
+                }
+                std::thread([fd](){
+                    close(fd);
+                }).join();
+            }
+            close(sock);
+        });
+    }
+    SYLAR_LOG_INFO(g_logger) << "persistent close elsewhere rounds=" << reused << "/3";
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    test_echo(false, false);
+    test_echo(true, false);
+    test_echo(true, true);
+    test_timeout_and_reuse();
+    test_close_elsewhere();
+    return 0;
+}
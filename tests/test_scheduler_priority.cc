@@ -0,0 +1,82 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static void busy(uint64_t us) {
+    uint64_t end = Sylar::GetCurrentUS() + us;
+    while(Sylar::GetCurrentUS() < end);
+}
+
+static std::atomic<uint64_t> s_wait_us[Sylar::Scheduler::PRIORITY_COUNT + 1];
+static std::atomic<uint64_t> s_count[Sylar::Scheduler::PRIORITY_COUNT + 1];
+
+void task(int index, uint64_t scheduled_us, uint64_t work_us) {
+    s_wait_us[index] += Sylar::GetCurrentUS() - scheduled_us;
+    ++s_count[index];
+    busy(work_us);
+}
+
+/**
+ * @brief 先压入一批低优先级任务,再压入少量高优先级和截止时间任务,
+ *        后者应几乎不需要等待
+ */
+void test_priority() {
+    Sylar::Scheduler sc(1, false, "prio");
+    for(int i = 0; i < 200; ++i) {
+        sc.schedule(std::bind(&task, (int)Sylar::Scheduler::PRIORITY_LOW, Sylar::GetCurrentUS(), 200)
+                    , -1, Sylar::Scheduler::PRIORITY_LOW);
+    }
+    for(int i = 0; i < 20; ++i) {
+        sc.schedule(std::bind(&task, (int)Sylar::Scheduler::PRIORITY_HIGH, Sylar::GetCurrentUS(), 50)
+                    , -1, Sylar::Scheduler::PRIORITY_HIGH);
+        sc.scheduleDeadline(std::bind(&task, (int)Sylar::Scheduler::PRIORITY_COUNT, Sylar::GetCurrentUS(), 50)
+                    , Sylar::GetCurrentMS() + 5);
+    }
+    sc.start();
+    sc.stop();
+
+    static const char* s_names[] = {"high", "normal", "low", "deadline"};
+    for(int i = 0; i <= Sylar::Scheduler::PRIORITY_COUNT; ++i) {
+        if(s_count[i]) {
+            SYLAR_LOG_INFO(g_logger) << s_names[i] << " count=" << s_count[i]
+                << " avg_wait=" << s_wait_us[i] / s_count[i] << "us";
+        }
+    }
+    std::stringstream ss;
+    sc.dump(ss);
+    SYLAR_LOG_INFO(g_logger) << ss.str();
+}
+
+static std::atomic<bool> s_low_done {false};
+
+void high_loop(uint64_t end_ms) {
+    busy(1000);
+    if(!s_low_done && Sylar::GetCurrentMS() < end_ms) {
+        Sylar::Scheduler::GetThis()->schedule(std::bind(&high_loop, end_ms)
+                    , -1, Sylar::Scheduler::PRIORITY_HIGH);
+    }
+}
+
+/**
+ * @brief 高优先级任务源源不断时,低优先级任务在老化时间后仍能执行
+ */
+void test_aging() {
+    Sylar::Scheduler sc(1, false, "aging");
+    uint64_t begin = Sylar::GetCurrentMS();
+    sc.schedule(std::bind(&high_loop, begin + 1000), -1, Sylar::Scheduler::PRIORITY_HIGH);
+    sc.schedule([begin](){
+        s_low_done = true;
+        SYLAR_LOG_INFO(g_logger) << "low task waited " << (Sylar::GetCurrentMS() - begin) << "ms";
+    }, -1, Sylar::Scheduler::PRIORITY_LOW);
+    sc.start();
+    sc.stop();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    test_priority();
+    test_aging();
+    return 0;
+}
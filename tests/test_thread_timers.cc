@@ -0,0 +1,188 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_threads = 4;
+
+/**
+ * @brief 非工作线程加入、取消定时器,经收件箱交给工作线程;
+ *        工作线程加入的定时器由其他工作线程取消,停止时不等待已取消的定时器
+ */
+void test_cross_thread(bool thread_timers) {
+    Sylar::Config::Lookup<bool>("iomanager.thread_timers")->setValue(thread_timers);
+    static const int s_count = 1000;
+    std::atomic<int> fired {0};
+    std::atomic<int> bad {0};
+    std::atomic<uint64_t> max_late {0};
+    std::string dump;
+    uint64_t stop_ms = 0;
+    {
+        Sylar::IOManager iom(s_threads, false, "timers");
+        std::vector<Sylar::Timer::ptr> timers;
+        for(int i = 0; i < s_count; ++i) {
+            uint64_t ms = 10 + i % 90;
+            uint64_t deadline = Sylar::GetMonotonicMS() + ms;
+            bool cancel = i % 2;
+            timers.push_back(iom.addTimer(ms, [&, deadline, cancel](){
+                uint64_t late = Sylar::GetMonotonicMS() - deadline;
+                uint64_t old = max_late;
+                while(late > old && !max_late.compare_exchange_weak(old, late));
+                ++(cancel ? bad : fired);
+            }));
+        }
+        for(int i = 1; i < s_count; i += 2) {
+            timers[i]->cancel();
+        }
+
+        //每个工作线程加入的长定时器交给下一个协程取消,协程可能在任意线程上运行
+        std::vector<Sylar::Timer::ptr> longs(s_threads * 100);
+        std::atomic<int> armed {0};
+        for(size_t i = 0; i < longs.size(); ++i) {
+            iom.schedule([&, i](){
+                longs[i] = Sylar::IOManager::GetThis()->addTimer(5000, [&bad](){ ++bad;});
+                ++armed;
+            });
+        }
+        while(armed != (int)longs.size()) {
+            usleep(1000);
+        }
+        for(size_t i = 0; i < longs.size(); ++i) {
+            iom.schedule([&longs, i](){
+                longs[i]->cancel();
+            });
+        }
+        usleep(200 * 1000);
+        std::stringstream ss;
+        iom.dump(ss);
+        dump = ss.str();
+        stop_ms = Sylar::GetMonotonicMS();
+    }
+    stop_ms = Sylar::GetMonotonicMS() - stop_ms;
+    size_t pos = dump.find("thread_timers=");
+    SYLAR_LOG_INFO(g_logger) << "cross_thread fired=" << fired << "/" << s_count / 2
+        << " cancelled_fired=" << bad << " max_late=" << max_late << "ms"
+        << " stop=" << stop_ms << "ms "
+        << (pos == std::string::npos ? "" : dump.substr(pos, dump.find('\n', pos) - pos));
+}
+
+/**
+ * @brief 所有工作线程同时加入、取消定时器(相当于带超时的hook IO),比较共享时间轮和每线程时间轮
+ */
+void test_arm_cancel(bool thread_timers) {
+    Sylar::Config::Lookup<bool>("iomanager.thread_timers")->setValue(thread_timers);
+    static const int s_rounds = 200000;
+    std::atomic<uint64_t> used {0};
+    {
+        Sylar::IOManager iom(s_threads, false, "timers");
+        for(int t = 0; t < s_threads; ++t) {
+            iom.schedule([&used](){
+                Sylar::IOManager* iom = Sylar::IOManager::GetThis();
+                uint64_t begin = Sylar::GetCurrentUS();
+                for(int i = 0; i < s_rounds; ++i) {
+                    iom->addTimer(1000 + i % 1000, [](){})->cancel();
+                }
+                used += Sylar::GetCurrentUS() - begin;
+            });
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "thread_timers=" << thread_timers
+        << " arm_cancel ns/op=" << used * 1000 / (s_threads * s_rounds);
+}
+
+/**
+ * @brief 各线程上的hook sleep,等待时间由本线程最近的定时器决定
+ */
+void test_sleep() {
+    Sylar::Config::Lookup<bool>("iomanager.thread_timers")->setValue(true);
+    std::atomic<uint64_t> max_used {0};
+    uint64_t begin = Sylar::GetMonotonicMS();
+    {
+        Sylar::IOManager iom(s_threads, false, "timers");
+        for(int i = 0; i < 100; ++i) {
+            iom.schedule([&max_used, i](){
+                uint64_t start = Sylar::GetMonotonicMS();
+                usleep((10 + i % 5 * 10) * 1000);
+                uint64_t used = Sylar::GetMonotonicMS() - start;
+                uint64_t old = max_used;
+                while(used > old && !max_used.compare_exchange_weak(old, used));
+            });
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "sleep 10~50ms max_used=" << max_used << "ms"
+        << " total=" << Sylar::GetMonotonicMS() - begin << "ms";
+}
+
+/**
+ * @brief 单个工作线程一直有任务可执行、不进入idle时,本线程时间轮中的定时器仍按时执行
+ */
+void test_busy_thread() {
+    Sylar::Config::Lookup<bool>("iomanager.thread_timers")->setValue(true);
+    std::atomic<uint64_t> late {~0ull};
+    {
+        Sylar::IOManager iom(1, false, "timers");
+        iom.schedule([&late](){
+            Sylar::IOManager* iom = Sylar::IOManager::GetThis();
+            uint64_t begin = Sylar::GetMonotonicMS();
+            iom->addTimer(10, [&late, begin](){
+                late = Sylar::GetMonotonicMS() - begin - 10;
+            });
+            //200个1ms的任务首尾相接,线程200ms内一直忙碌
+            std::shared_ptr<std::function<void(int)> > step(new std::function<void(int)>);
+            *step = [step](int left){
+                uint64_t end = Sylar::GetCurrentUS() + 1000;
+                while(Sylar::GetCurrentUS() < end);
+                if(left > 0) {
+                    Sylar::IOManager::GetThis()->schedule(std::bind(*step, left - 1));
+                } else {
+                    *step = nullptr;
+                }
+            };
+            iom->schedule(std::bind(*step, 200));
+        });
+    }
+    SYLAR_LOG_INFO(g_logger) << "busy thread timer late=" << late << "ms";
+}
+
+/**
+ * @brief 循环定时器到期、回调已交给调度器但尚未执行时被取消,回调不再执行
+ */
+void test_recurring_cancel() {
+    Sylar::Config::Lookup<bool>("iomanager.thread_timers")->setValue(true);
+    bool cancelled = false;
+    std::atomic<int> fired_after {0};
+    {
+        Sylar::IOManager iom(1, false, "timers");
+        iom.schedule([&cancelled, &fired_after](){
+            Sylar::IOManager* iom = Sylar::IOManager::GetThis();
+            std::shared_ptr<std::atomic<bool> > stopped(new std::atomic<bool>(false));
+            Sylar::Timer::ptr timer = iom->addTimer(1, [&fired_after, stopped](){
+                if(*stopped) {
+                    ++fired_after;
+                }
+            }, true);
+            //线程忙碌期间定时器到期,回到调度循环时回调排在下面的取消任务之后
+            uint64_t end = Sylar::GetCurrentUS() + 5000;
+            while(Sylar::GetCurrentUS() < end);
+            iom->schedule([timer, stopped, &cancelled](){
+                cancelled = timer->cancel();
+                *stopped = cancelled;
+            });
+        });
+    }
+    SYLAR_LOG_INFO(g_logger) << "recurring cancelled=" << cancelled
+        << " fired_after_cancel=" << fired_after;
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    test_cross_thread(false);
+    test_cross_thread(true);
+    test_arm_cancel(false);
+    test_arm_cancel(true);
+    test_sleep();
+    test_busy_thread();
+    test_recurring_cancel();
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "Sylar/sylar.h"
+#include <stdlib.h>
+#include <set>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 不依赖调度器的定时器管理器,由测试直接驱动
+ */
+class ManualTimerManager : public Sylar::TimerManager {
+protected:
+    void onTimerInsertedAtFront() override {}
+};
+
+/**
+ * @brief 随机的毫秒级定时器按时、按序触发
+ */
+void test_order() {
+    static const int s_count = 2000;
+    std::vector<std::pair<uint64_t, int> > fired;
+    std::vector<uint64_t> deadline(s_count);
+    std::set<int> unknown;
+    uint64_t max_late = 0;
+    {
+        Sylar::IOManager iom(1, false, "timer");
+        iom.schedule([&](){
+            srand(1);
+            for(int i = 0; i < s_count; ++i) {
+                //每5个一组使用相同的时间,检查同一tick内按加入顺序执行
+                uint64_t ms = (i % 5) ? rand() % 300 : (i / 5) % 50;
+                uint64_t before = Sylar::GetMonotonicMS();
+                deadline[i] = before + ms;
+                iom.addTimer(ms, [&, i](){
+                    uint64_t now = Sylar::GetMonotonicMS();
+                    max_late = std::max(max_late, now - deadline[i]);
+                    fired.push_back(std::make_pair(deadline[i], i));
+                });
+                //加入期间跨过了毫秒边界,执行时间不确定,不参与顺序检查
+                if(Sylar::GetMonotonicMS() != before) {
+                    unknown.insert(i);
+                }
+            }
+        });
+    }
+    int disorder = 0;
+    std::pair<uint64_t, int> last(0, -1);
+    for(auto& i : fired) {
+        if(unknown.count(i.second)) {
+            continue;
+        }
+        if(i < last) {
+            ++disorder;
+        }
+        last = i;
+    }
+    SYLAR_LOG_INFO(g_logger) << "timers fired=" << fired.size() << "/" << s_count
+        << " disorder=" << disorder << " max_late=" << max_late << "ms";
+}
+
+/**
+ * @brief 超过旧时间轮60秒跨度的定时器,以及最近执行时间的查询
+ */
+void test_long_timeout() {
+    ManualTimerManager mgr;
+    mgr.addTimer(20ull * 3600 * 1000, [](){});
+    uint64_t hours = mgr.getNextTimer();
+    mgr.addTimer(70 * 1000, [](){});
+    uint64_t seconds = mgr.getNextTimer();
+    mgr.addTimer(3, [](){});
+    uint64_t ms = mgr.getNextTimer();
+    usleep(10 * 1000);
+    std::vector<std::function<void()> > cbs;
+    mgr.listExpiredCb(cbs);
+    SYLAR_LOG_INFO(g_logger) << "next 20h=" << hours << " next 70s=" << seconds
+        << " next 3ms=" << ms << " expired=" << cbs.size()
+        << " next after expire=" << mgr.getNextTimer();
+}
+
+/**
+ * @brief 大量定时器的插入、查询最近执行时间和到期处理的耗时
+ */
+void test_bench() {
+    static const int s_count = 1000000;
+    ManualTimerManager mgr;
+    srand(2);
+    uint64_t begin = Sylar::GetCurrentUS();
+    for(int i = 0; i < s_count; ++i) {
+        mgr.addTimer(rand() % 200, [](){});
+    }
+    uint64_t add_us = Sylar::GetCurrentUS() - begin;
+    begin = Sylar::GetCurrentUS();
+    uint64_t sum = 0;
+    for(int i = 0; i < s_count; ++i) {
+        sum += mgr.getNextTimer();
+    }
+    uint64_t next_us = Sylar::GetCurrentUS() - begin;
+    size_t expired = 0;
+    begin = Sylar::GetCurrentUS();
+    while(mgr.hasTimer()) {
+        std::vector<std::function<void()> > cbs;
+        mgr.listExpiredCb(cbs);
+        expired += cbs.size();
+        usleep(1000);
+    }
+    uint64_t expire_us = Sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "bench timers=" << s_count
+        << " add_ns=" << add_us * 1000 / s_count
+        << " next_ns=" << next_us * 1000 / s_count
+        << " expired=" << expired << " expire_ms=" << expire_us / 1000
+        << " (" << sum % 2 << ")";
+}
+
+/**
+ * @brief 取消、刷新直接从槽中摘除:取消的不再占用时间轮,刷新不会重复触发
+ */
+void test_cancel_refresh() {
+    static const int s_count = 1000000;
+    ManualTimerManager mgr;
+    std::vector<Sylar::Timer::ptr> timers;
+    timers.reserve(s_count);
+    int fired = 0;
+    for(int i = 0; i < s_count; ++i) {
+        timers.push_back(mgr.addTimer(i % 5000, [&fired](){ ++fired; }));
+    }
+    uint64_t begin = Sylar::GetCurrentUS();
+    for(auto& i : timers) {
+        i->refresh();
+    }
+    uint64_t refresh_us = Sylar::GetCurrentUS() - begin;
+    begin = Sylar::GetCurrentUS();
+    for(auto& i : timers) {
+        i->cancel();
+    }
+    uint64_t cancel_us = Sylar::GetCurrentUS() - begin;
+    bool empty = !mgr.hasTimer();
+
+    //未保存返回值的定时器由时间轮持有,刷新多次也只触发一次
+    timers.clear();
+    Sylar::Timer::ptr keep = mgr.addTimer(2, [&fired](){ ++fired; });
+    mgr.addTimer(2, [&fired](){ ++fired; });
+    for(int i = 0; i < 100; ++i) {
+        keep->refresh();
+    }
+    usleep(10 * 1000);
+    std::vector<std::function<void()> > cbs;
+    mgr.listExpiredCb(cbs);
+    for(auto& cb : cbs) {
+        cb();
+    }
+    SYLAR_LOG_INFO(g_logger) << "cancel_refresh timers=" << s_count
+        << " refresh_ns=" << refresh_us * 1000 / s_count
+        << " cancel_ns=" << cancel_us * 1000 / s_count
+        << " empty_after_cancel=" << empty << " fired=" << fired
+        << " has_timer=" << mgr.hasTimer();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    test_order();
+    test_long_timeout();
+    test_bench();
+    test_cancel_refresh();
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 不让出的忙循环
+ */
+void busy_loop(uint64_t ms) {
+    uint64_t end = Sylar::GetCurrentMS() + ms;
+    while(Sylar::GetCurrentMS() < end) {
+    }
+}
+
+/**
+ * @brief 单线程上一个协程长时间不让出,watchdog应输出它的id和调用栈
+ */
+void test_watchdog() {
+    Sylar::IOManager iom(1, false, "watchdog");
+    iom.schedule([](){
+        SYLAR_LOG_INFO(g_logger) << "busy fiber id=" << Sylar::Fiber::GetFiberId();
+        busy_loop(300);
+    });
+}
+
+/**
+ * @brief 长循环中调用MaybeYield,同一线程上的其他协程仍能及时执行
+ */
+void test_maybe_yield(bool yield) {
+    std::atomic<uint64_t> delay {0};
+    uint64_t yields = 0;
+    {
+        Sylar::IOManager iom(1, false, "yield");
+        iom.schedule([yield, &yields](){
+            uint64_t end = Sylar::GetCurrentMS() + 200;
+            while(Sylar::GetCurrentMS() < end) {
+                if(yield && Sylar::Fiber::MaybeYield()) {
+                    ++yields;
+                }
+            }
+        });
+        uint64_t begin = Sylar::GetCurrentMS();
+        iom.schedule([&delay, begin](){
+            delay = Sylar::GetCurrentMS() - begin;
+        });
+    }
+    SYLAR_LOG_INFO(g_logger) << "maybe_yield=" << yield
+        << " yields=" << yields
+        << " other task delay=" << delay << "ms";
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    Sylar::Config::Lookup<uint32_t>("fiber.watchdog.budget_ms")->setValue(100);
+    test_watchdog();
+    test_maybe_yield(false);
+    test_maybe_yield(true);
+    return 0;
+}
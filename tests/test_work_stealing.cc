@@ -0,0 +1,44 @@
+#include "Sylar/sylar.h"
+#include <atomic>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<uint64_t> s_done {0};
+static const int s_fan_out = 16;
+static const int s_depth = 4;
+
+void spawn(int depth) {
+    ++s_done;
+    if(depth <= 0) {
+        return;
+    }
+    for(int i = 0; i < s_fan_out; ++i) {
+        Sylar::Scheduler::GetThis()->schedule(std::bind(&spawn, depth - 1));
+    }
+}
+
+void run(int threads, bool work_stealing) {
+    s_done = 0;
+    Sylar::Scheduler sc(threads, false, "ws");
+    sc.setWorkStealing(work_stealing);
+    sc.start();
+    uint64_t begin = Sylar::GetCurrentMS();
+    sc.schedule(std::bind(&spawn, s_depth));
+    sc.stop();
+    uint64_t used = Sylar::GetCurrentMS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "threads=" << threads
+        << " work_stealing=" << work_stealing
+        << " tasks=" << s_done
+        << " used=" << used << "ms"
+        << " tasks/s=" << (used ? s_done * 1000 / used : 0);
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::WARN);
+    for(int threads : {1, 4, 8, 16}) {
+        run(threads, false);
+        run(threads, true);
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include "Sylar/sylar.h"
+#include <set>
+
+static Sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 同一配置的多个实例轮流绑定NUMA节点,按节点获取时只返回该节点上的实例
+ */
+void test_get_by_node() {
+    std::map<std::string, std::map<std::string, std::string> > conf;
+    conf["io"]["thread_num"] = "1";
+    conf["io"]["worker_num"] = "4";
+    conf["io"]["numa_node"] = "0,1";
+    Sylar::WorkerManager mgr;
+    mgr.init(conf);
+
+    int wrong = 0;
+    std::set<std::string> names[2];
+    for(int i = 0; i < 200; ++i) {
+        for(int node = 0; node < 2; ++node) {
+            Sylar::Scheduler::ptr s = mgr.get("io", node);
+            if(!s || s->getCpuAffinity().numaNode != node) {
+                ++wrong;
+                continue;
+            }
+            names[node].insert(s->getName());
+        }
+    }
+    Sylar::Scheduler::ptr any = mgr.get("io");
+    Sylar::Scheduler::ptr missing = mgr.get("io", 7);
+    SYLAR_LOG_INFO(g_logger) << "instances=" << mgr.getCount() << " wrong=" << wrong
+        << " node0=" << names[0].size() << " node1=" << names[1].size()
+        << " any=" << (any ? any->getName() : "null")
+        << " no_match=" << (missing ? missing->getName() : "null");
+    mgr.stop();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(Sylar::LogLevel::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(Sylar::LogLevel::FATAL);
+    test_get_by_node();
+    return 0;
+}